@@ -0,0 +1,21 @@
+/* alloc.h -- allocate memory, counted for eot_time_phases() (internal
+ * to libeot)
+ *
+ * Every allocation in libeot goes through these, so that a thread
+ * that times its calls also gets the number of allocations they made,
+ * without replacing the C library's malloc for the whole program.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <stddef.h>
+
+extern void *counted_malloc(size_t n);
+extern void *counted_calloc(size_t n, size_t size);
+extern void *counted_realloc(void *p, size_t n);
+
+#endif /* ALLOC_H */
@@ -0,0 +1,363 @@
+/* bench -- microbenchmarks of the hot paths of libeot, mkeot and eotinfo
+ *
+ * Each benchmark repeats one operation on each of the given fonts
+ * (normally made by genfont) until a round takes long enough to time,
+ * runs several rounds and keeps the fastest, which is the least
+ * disturbed by the rest of the machine. The results go to stdout, one
+ * line per benchmark and font, always in the same order:
+ *
+ *   benchmark font bytes ns/op MB/s
+ *
+ * where bytes is what one operation processes. Lines that start with
+ * "#" are comments. With --baseline, the results are compared with an
+ * earlier output of bench and the operations that became slower by
+ * more than the threshold are reported on stderr; the exit status is
+ * then 1.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+#include <stdbool.h>
+#include <sysexits.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include "eot.h"
+#include "sfnt.h"
+#include "mapfile.h"
+
+#define NURLS 8			/* Rootstrings in the header benchmarks */
+
+typedef struct {		/* A font and what the benchmarks need of it */
+  const char *name;		/* The file name without its directory */
+  mapped_file file;
+  sfnt_offset_table sfnt;
+  EOT_header header;		/* With NURLS rootstrings */
+  unsigned char *eot;		/* The EOT file: header and font data */
+  size_t hdrlen, eotlen;
+  int out;			/* A temporary file to copy the font to */
+} fixture;
+
+typedef struct {		/* A benchmark */
+  const char *name;
+  size_t (*bytes)(const fixture *f);	/* Bytes per operation */
+  bool (*op)(fixture *f);		/* One operation */
+} benchmark;
+
+typedef struct {		/* A result from a baseline file */
+  char bench[64], font[256];
+  double ns;
+} result;
+
+static const char *const urls[NURLS] = {
+  "http://www.example.org/", "https://www.example.org/",
+  "http://example.org/fonts/", "https://cdn.example.net/static/fonts/",
+  "http://www.example.com/", "https://www.example.com/css/",
+  "http://localhost/", "https://test.example.org/a/b/c/"
+};
+
+
+/* now -- nanoseconds since some fixed time, by the monotonic clock */
+static unsigned long long now(void)
+{
+  struct timespec t;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+/* directory_bytes -- the size of the table directory */
+static size_t directory_bytes(const fixture *f)
+{
+  return 12 + 16 * f->sfnt.numTables;
+}
+
+
+/* directory -- read the table directory and look up every table in it */
+static bool directory(fixture *f)
+{
+  sfnt_offset_table sfnt;
+  bool ok;
+  int i;
+
+  if (read_sfnt_header(f->file.data, f->file.size, &sfnt) != EOT_OK)
+    return false;
+  for (i = 0, ok = true; i < sfnt.numTables && ok; i++)
+    ok = lookup_table(sfnt, f->sfnt.tables[i].tag) != NULL;
+  free_sfnt_header(&sfnt);
+  return ok;
+}
+
+
+/* names_bytes -- the size of the name table */
+static size_t names_bytes(const fixture *f)
+{
+  return lookup_table(f->sfnt, pack_tag("name"))->length;
+}
+
+
+/* names -- get the four names that an EOT header holds */
+static bool names(fixture *f)
+{
+  font_name names[] = {{.nameID = 1}, {.nameID = 2}, {.nameID = 5},
+		       {.nameID = 4}};
+  int i;
+
+  if (read_names(f->sfnt, 4, names) != EOT_OK) return false;
+  for (i = 0; i < 4; i++) free(names[i].name);
+  return true;
+}
+
+
+/* header_bytes -- the size of the serialized EOT header */
+static size_t header_bytes(const fixture *f)
+{
+  return f->hdrlen;
+}
+
+
+/* header -- serialize the EOT header */
+static bool header(fixture *f)
+{
+  size_t len;
+
+  return eot_write_header(&f->header, f->eot, f->hdrlen, &len) == EOT_OK;
+}
+
+
+/* rootstring_bytes -- the length of the URLs */
+static size_t rootstring_bytes(const fixture *f)
+{
+  size_t n = 0;
+  int i;
+
+  (void) f;
+  for (i = 0; i < NURLS; i++) n += strlen(urls[i]);
+  return n;
+}
+
+
+/* rootstring -- build the rootstring of NURLS URLs */
+static bool rootstring(fixture *f)
+{
+  EOT_header h;
+  bool ok;
+
+  (void) f;
+  eot_init_header(&h);
+  ok = eot_add_rootstrings(&h, urls, NURLS) == EOT_OK;
+  eot_free_header(&h);
+  return ok;
+}
+
+
+/* copy_bytes -- the size of the font */
+static size_t copy_bytes(const fixture *f)
+{
+  return f->file.size;
+}
+
+
+/* copy -- copy the font data to a file, the way mkeot does */
+static bool copy(fixture *f)
+{
+  return lseek(f->out, 0, SEEK_SET) == 0 &&
+    copy_range(f->file, 0, f->file.size, f->out);
+}
+
+
+/* parse -- parse the EOT header, the way eotinfo does */
+static bool parse(fixture *f)
+{
+  EOT_header h;
+  size_t len;
+  eot_status e;
+
+  eot_init_header(&h);
+  e = eot_read_header(&h, f->eot, f->eotlen, &len);
+  eot_free_header(&h);
+  return e == EOT_OK;
+}
+
+
+static const benchmark benchmarks[] = {
+  {"directory", directory_bytes, directory},
+  {"names", names_bytes, names},
+  {"header", header_bytes, header},
+  {"rootstring", rootstring_bytes, rootstring},
+  {"copy", copy_bytes, copy},
+  {"parse", header_bytes, parse}
+};
+
+
+/* setup -- map a font and prepare what the benchmarks need */
+static void setup(const char *path, fixture *f)
+{
+  char tmp[] = "/tmp/benchXXXXXX";
+  eot_status e;
+
+  f->name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  if (!map_file(path, &f->file)) err(EX_NOINPUT, "%s", path);
+  eot_init_header(&f->header);
+  if ((e = read_sfnt_header(f->file.data, f->file.size, &f->sfnt))
+      != EOT_OK ||
+      (e = eot_read_font(&f->header, f->file.data, f->file.size)) != EOT_OK ||
+      (e = eot_add_rootstrings(&f->header, urls, NURLS)) != EOT_OK)
+    errx(EX_DATAERR, "%s: %s", path, eot_strerror(e));
+  f->hdrlen = eot_header_size(&f->header);
+  f->eotlen = f->hdrlen + f->file.size;
+  if (!(f->eot = malloc(f->eotlen))) err(EX_OSERR, NULL);
+  if ((e = eot_write_header(&f->header, f->eot, f->hdrlen, &f->hdrlen))
+      != EOT_OK) errx(EX_SOFTWARE, "%s: %s", path, eot_strerror(e));
+  memcpy(f->eot + f->hdrlen, f->file.data, f->file.size);
+  if ((f->out = mkstemp(tmp)) == -1) err(EX_CANTCREAT, "%s", tmp);
+  (void) unlink(tmp);
+}
+
+
+/* teardown -- free what setup allocated */
+static void teardown(fixture *f)
+{
+  (void) close(f->out);
+  free(f->eot);
+  eot_free_header(&f->header);
+  free_sfnt_header(&f->sfnt);
+  (void) unmap_file(&f->file);
+}
+
+
+/* run -- time an operation, return the fastest round in ns/op
+ *
+ * The number of operations per round is doubled until a round takes
+ * at least min_ns.
+ */
+static double run(const benchmark *b, fixture *f, int rounds,
+		  unsigned long long min_ns)
+{
+  unsigned long long n = 1, i, t;
+  double best = 0;
+  int r;
+
+  for (;;) {
+    t = now();
+    for (i = 0; i < n; i++)
+      if (!b->op(f)) errx(EX_SOFTWARE, "%s failed on %s", b->name, f->name);
+    if (now() - t >= min_ns) break;
+    n *= 2;
+  }
+  for (r = 0; r < rounds; r++) {
+    t = now();
+    for (i = 0; i < n; i++) (void) b->op(f);
+    t = now() - t;
+    if (r == 0 || (double)t / n < best) best = (double)t / n;
+  }
+  return best;
+}
+
+
+/* read_baseline -- read the results in an earlier output of bench */
+static result *read_baseline(const char *path, int *n)
+{
+  result *r = NULL, *p;
+  char line[512];
+  FILE *f;
+
+  *n = 0;
+  if (!(f = fopen(path, "r"))) return NULL;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#') continue;
+    if (!(p = realloc(r, (*n + 1) * sizeof(*r)))) err(EX_OSERR, NULL);
+    r = p;
+    if (sscanf(line, "%63s %255s %*u %lf", r[*n].bench, r[*n].font,
+	       &r[*n].ns) == 3) (*n)++;
+  }
+  fclose(f);
+  return r;
+}
+
+
+/* compare -- check a result against the baseline, false if it regressed */
+static bool compare(const result *base, int nbase, const char *bench,
+		    const char *font, double ns, double threshold)
+{
+  int i;
+
+  for (i = 0; i < nbase; i++)
+    if (strcmp(base[i].bench, bench) == 0 && strcmp(base[i].font, font) == 0)
+      break;
+  if (i == nbase || ns <= base[i].ns * (1 + threshold / 100)) return true;
+  fprintf(stderr, "bench: %s on %s: %.1f ns/op, was %.1f (+%.0f%%)\n",
+	  bench, font, ns, base[i].ns, 100 * (ns / base[i].ns - 1));
+  return false;
+}
+
+
+/* usage -- print usage message and exit */
+static void usage(char *progname)
+{
+  fprintf(stderr, "%s [--rounds N] [--time ms] [--baseline file] "
+	  "[--threshold percent] font...\n", progname);
+  exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+  static const struct option longopts[] = {
+    {"baseline", required_argument, NULL, 'b'},
+    {"rounds", required_argument, NULL, 'r'},
+    {"threshold", required_argument, NULL, 't'},
+    {"time", required_argument, NULL, 'm'},
+    {NULL, 0, NULL, 0}
+  };
+  int rounds = 5, nfonts, nbase = 0, c, i, j;
+  double threshold = 25, ns, ms = 20;
+  const char *baseline = NULL;
+  result *base = NULL;
+  bool ok = true;
+  fixture *fonts;
+  size_t bytes;
+
+  while ((c = getopt_long(argc, argv, "b:m:r:t:", longopts, NULL)) != -1)
+    switch (c) {
+    case 'b': baseline = optarg; break;
+    case 'm': ms = atof(optarg); break;
+    case 'r': rounds = atoi(optarg); break;
+    case 't': threshold = atof(optarg); break;
+    default: usage(argv[0]);
+    }
+  if (optind == argc || rounds < 1 || ms <= 0) usage(argv[0]);
+
+  if (baseline && !(base = read_baseline(baseline, &nbase)))
+    warnx("No baseline in %s, nothing to compare", baseline);
+
+  nfonts = argc - optind;
+  if (!(fonts = calloc(nfonts, sizeof(*fonts)))) err(EX_OSERR, NULL);
+  for (j = 0; j < nfonts; j++) setup(argv[optind + j], &fonts[j]);
+
+  printf("# benchmark font bytes ns/op MB/s\n");
+  for (i = 0; i < (int)(sizeof(benchmarks)/sizeof(benchmarks[0])); i++)
+    for (j = 0; j < nfonts; j++) {
+      ns = run(&benchmarks[i], &fonts[j], rounds, ms * 1000000);
+      bytes = benchmarks[i].bytes(&fonts[j]);
+      printf("%-12s %-16s %10zu %14.1f %10.1f\n", benchmarks[i].name,
+	     fonts[j].name, bytes, ns, bytes / ns * 1000);
+      fflush(stdout);
+      if (!compare(base, nbase, benchmarks[i].name, fonts[j].name, ns,
+		   threshold)) ok = false;
+    }
+
+  for (j = 0; j < nfonts; j++) teardown(&fonts[j]);
+  free(fonts);
+  free(base);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/* genfont -- write a synthetic OpenType font for the benchmarks
+ *
+ * The font has the tables that mkeot needs (OS/2, head and name) and
+ * as many filler tables as needed to reach the requested number of
+ * tables, filled with pseudo-random bytes to reach the requested size.
+ * The name table has the requested number of records: Unicode-platform
+ * names first and the English Windows names last, so that finding the
+ * names means scanning all records. The output depends only on the
+ * options, so the same options always give the same font.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+#include <stdbool.h>
+#include <sysexits.h>
+#include <string.h>
+#include <getopt.h>
+#include "eot.h"
+#include "sfnt.h"
+
+#define NREQUIRED 3		/* OS/2, head and name */
+#define NENGLISH 6		/* Name IDs 0 to 5, in English */
+
+static const char *const english[NENGLISH] = {
+  "Synthetic font for benchmarks", "Bench Sans", "Regular",
+  "Bench Sans Regular 1.0", "Bench Sans Regular", "Version 1.0"
+};
+
+
+/* make_OS2 -- make a version 1 OS/2 table */
+static void make_OS2(buffer *b)
+{
+  int i;
+
+  buf_put_2be(b, 1);		/* version */
+  buf_put_2be(b, 500);		/* xAvgCharWidth */
+  buf_put_2be(b, 400);		/* usWeightClass */
+  buf_put_2be(b, 5);		/* usWidthClass */
+  buf_put_2be(b, 0);		/* fsType: installable */
+  for (i = 0; i < 11; i++) buf_put_2be(b, 0); /* ySubscriptXSize... */
+  for (i = 0; i < 10; i++) buf_put_1(b, i == 0 ? 2 : 0); /* panose */
+  buf_put_4be(b, 1);		/* ulUnicodeRange1: Basic Latin */
+  for (i = 0; i < 3; i++) buf_put_4be(b, 0);
+  buf_put_bytes(b, "BNCH", 4);	/* achVendID */
+  buf_put_2be(b, 0x40);		/* fsSelection: regular */
+  buf_put_2be(b, 0x20);		/* usFirstCharIndex */
+  buf_put_2be(b, 0x7E);		/* usLastCharIndex */
+  buf_put_2be(b, 800);		/* sTypoAscender */
+  buf_put_2be(b, -200);		/* sTypoDescender */
+  buf_put_2be(b, 0);		/* sTypoLineGap */
+  buf_put_2be(b, 1000);		/* usWinAscent */
+  buf_put_2be(b, 200);		/* usWinDescent */
+  buf_put_4be(b, 1);		/* ulCodePageRange1: Latin 1 */
+  buf_put_4be(b, 0);		/* ulCodePageRange2 */
+}
+
+
+/* make_head -- make a head table, checkSumAdjustment is set later */
+static void make_head(buffer *b)
+{
+  buf_put_4be(b, 0x00010000);	/* Table_version_number */
+  buf_put_4be(b, 0x00010000);	/* fontRevision */
+  buf_put_4be(b, 0);		/* checkSumAdjustment */
+  buf_put_4be(b, 0x5F0F3CF5);	/* magicNumber */
+  buf_put_2be(b, 0x000B);	/* flags */
+  buf_put_2be(b, 1000);		/* unitsPerEm */
+  buf_put_4be(b, 0); buf_put_4be(b, 0); /* created */
+  buf_put_4be(b, 0); buf_put_4be(b, 0); /* modified */
+  buf_put_2be(b, 0); buf_put_2be(b, -200); /* xMin, yMin */
+  buf_put_2be(b, 1000); buf_put_2be(b, 800); /* xMax, yMax */
+  buf_put_2be(b, 0);		/* macStyle */
+  buf_put_2be(b, 8);		/* lowestRecPPEM */
+  buf_put_2be(b, 2);		/* fontDirectionHint */
+  buf_put_2be(b, 0);		/* indexToLocFormat */
+  buf_put_2be(b, 0);		/* glyphDataFormat */
+}
+
+
+/* make_name -- make a name table with n records, n >= NENGLISH
+ *
+ * Every record has its own string, in UTF-16BE. The strings of the
+ * Unicode names are "Name 256", "Name 257", etc.
+ */
+static void make_name(buffer *b, int n)
+{
+  unsigned short offset = 0;
+  char s[32];
+  const char *p;
+  buffer strings;
+  int i;
+
+  buf_init(&strings);
+  buf_put_2be(b, 0);		/* format */
+  buf_put_2be(b, n);		/* count */
+  buf_put_2be(b, 6 + 12 * n);	/* stringOffset */
+  for (i = 0; i < n; i++) {
+    if (i < n - NENGLISH) {
+      snprintf(s, sizeof(s), "Name %d", 256 + i);
+      p = s;
+      buf_put_2be(b, 0);	/* platformID: Unicode */
+      buf_put_2be(b, 3);	/* encodingID: BMP */
+      buf_put_2be(b, 0);	/* languageID */
+      buf_put_2be(b, 256 + i);	/* nameID: font-specific */
+    } else {
+      p = english[i - (n - NENGLISH)];
+      buf_put_2be(b, 3);	/* platformID: Windows */
+      buf_put_2be(b, 1);	/* encodingID: Unicode BMP */
+      buf_put_2be(b, 0x0409);	/* languageID: English (US) */
+      buf_put_2be(b, i - (n - NENGLISH));
+    }
+    buf_put_2be(b, 2 * strlen(p));
+    buf_put_2be(b, offset);
+    for (; *p; p++) buf_put_2be(&strings, (unsigned char)*p);
+    offset = strings.length;
+  }
+  buf_put_bytes(b, strings.data, strings.length);
+  if (strings.failed) b->failed = true;
+  free(strings.data);
+}
+
+
+/* make_filler -- make a table of n pseudo-random bytes */
+static void make_filler(buffer *b, size_t n, unsigned long *seed)
+{
+  if (!buf_reserve(b, n)) return;
+  for (; n > 0; n--) {
+    *seed = *seed * 1103515245 + 12345;
+    b->data[b->length++] = (*seed >> 16) & 0xFF;
+  }
+}
+
+
+/* usage -- print usage message and exit */
+static void usage(char *progname)
+{
+  fprintf(stderr, "%s [--size bytes] [--tables N] [--names N] [-o file]\n",
+	  progname);
+  exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+  static const struct option longopts[] = {
+    {"names", required_argument, NULL, 'n'},
+    {"output", required_argument, NULL, 'o'},
+    {"size", required_argument, NULL, 's'},
+    {"tables", required_argument, NULL, 't'},
+    {NULL, 0, NULL, 0}
+  };
+  unsigned long size = 65536, seed = 1;
+  int ntables = 16, nnames = 32, c, i;
+  const char *output = NULL;
+  sfnt_table *tables;
+  buffer *data, font;
+  size_t used, each;
+  FILE *out = stdout;
+  char tag[5];
+  eot_status e;
+
+  while ((c = getopt_long(argc, argv, "n:o:s:t:", longopts, NULL)) != -1)
+    switch (c) {
+    case 'n': nnames = atoi(optarg); break;
+    case 'o': output = optarg; break;
+    case 's': size = strtoul(optarg, NULL, 10); break;
+    case 't': ntables = atoi(optarg); break;
+    default: usage(argv[0]);
+    }
+  if (optind != argc) usage(argv[0]);
+  if (ntables < NREQUIRED || ntables > 4096) errx(EX_USAGE,
+    "The number of tables must be between %d and 4096", NREQUIRED);
+  if (nnames < NENGLISH || nnames > 2048) errx(EX_USAGE,
+    "The number of names must be between %d and 2048", NENGLISH);
+
+  if (!(tables = calloc(ntables, sizeof(*tables))) ||
+      !(data = calloc(ntables, sizeof(*data)))) err(EX_OSERR, NULL);
+  for (i = 0; i < ntables; i++) buf_init(&data[i]);
+  memcpy(tables[0].tag, "OS/2", 4); make_OS2(&data[0]);
+  memcpy(tables[1].tag, "head", 4); make_head(&data[1]);
+  memcpy(tables[2].tag, "name", 4); make_name(&data[2], nnames);
+
+  /* Share what is left of the size out over the filler tables */
+  used = 12 + 16 * ntables;
+  for (i = 0; i < NREQUIRED; i++) used += (data[i].length + 3) & ~3UL;
+  each = ntables == NREQUIRED || size <= used ? 0 :
+    ((size - used) / (ntables - NREQUIRED)) & ~3UL;
+  for (i = NREQUIRED; i < ntables; i++) {
+    snprintf(tag, sizeof(tag), "F%03X", i - NREQUIRED);
+    memcpy(tables[i].tag, tag, 4);
+    make_filler(&data[i], each, &seed);
+  }
+
+  buf_init(&font);
+  for (i = 0; i < ntables; i++) {
+    if (data[i].failed) errx(EX_OSERR, "%s", eot_strerror(EOT_ERR_NOMEM));
+    tables[i].data = data[i].data;
+    tables[i].length = data[i].length;
+  }
+  if ((e = build_sfnt(SFNT_VERSION_1_0, ntables, tables, &font)) != EOT_OK)
+    errx(EX_SOFTWARE, "%s", eot_strerror(e));
+
+  if (output && !(out = fopen(output, "wb"))) err(EX_CANTCREAT, "%s", output);
+  if (fwrite(font.data, 1, font.length, out) != font.length ||
+      fclose(out) != 0) err(EX_IOERR, "%s", output ? output : "stdout");
+
+  for (i = 0; i < ntables; i++) free(data[i].data);
+  free(font.data);
+  free(data);
+  free(tables);
+  return 0;
+}
@@ -0,0 +1,341 @@
+/* cache -- a directory of EOT files, named by a hash of their inputs
+ *
+ * mkeot keeps the EOT files it makes in a directory, under a name
+ * that is a 128-bit hash of the font and of everything else that
+ * determines the EOT file (URLs, options, version of mkeot). If the
+ * same EOT file is asked for again, it is copied from there, without
+ * parsing the font. On filesystems that support it (Btrfs, XFS), the
+ * copy is a reflink, i.e., it shares the data blocks.
+ *
+ * The total size is bounded: when it is exceeded, the entries that
+ * were used longest ago are removed, until the cache is at 90% of its
+ * limit. An entry's modification time is its time of last use.
+ *
+ * The hash runs two XXH64 hashes with different seeds over the data
+ * at once, to get 128 bits in one pass.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_LINUX_FS_H
+# include <linux/fs.h>
+#endif
+#include "mapfile.h"
+#include "cache.h"
+
+#define P1 0x9E3779B185EBCA87ULL	/* The primes of XXH64 */
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+typedef struct {		/* A file in the cache */
+  char name[CACHE_KEYLEN + 5];
+  struct timespec used;
+  off_t size;
+} entry;
+
+
+/* rotl -- rotate a 64-bit word left */
+static inline uint64_t rotl(uint64_t x, int n)
+{
+  return (x << n) | (x >> (64 - n));
+}
+
+
+/* read64 -- get 8 bytes, in the byte order of the machine
+ *
+ * Keys are thus only valid on machines of the same byte order.
+ */
+static inline uint64_t read64(const unsigned char *p)
+{
+  uint64_t x;
+
+  memcpy(&x, p, 8);
+  return x;
+}
+
+
+/* mix -- add a word to an accumulator of XXH64 */
+static inline uint64_t mix(uint64_t acc, uint64_t x)
+{
+  return rotl(acc + x * P2, 31) * P1;
+}
+
+
+/* finish -- XXH64 after the 32-byte stripes: merge, add tail, avalanche */
+static uint64_t finish(const uint64_t v[4], uint64_t seed,
+		       const unsigned char *p, size_t n, size_t total)
+{
+  uint64_t h;
+  int i;
+
+  if (total >= 32) {
+    h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+    for (i = 0; i < 4; i++) h = (h ^ mix(0, v[i])) * P1 + P4;
+  } else {
+    h = seed + P5;
+  }
+  h += total;
+  for (; n >= 8; p += 8, n -= 8) h = rotl(h ^ mix(0, read64(p)), 27) * P1 + P4;
+  if (n >= 4) {
+    h ^= (uint64_t)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24) * P1;
+    h = rotl(h, 23) * P2 + P3;
+    p += 4;
+    n -= 4;
+  }
+  for (; n > 0; p++, n--) h = rotl(h ^ *p * P5, 11) * P1;
+  h = (h ^ (h >> 33)) * P2;
+  h = (h ^ (h >> 29)) * P3;
+  return h ^ (h >> 32);
+}
+
+
+/* hash128 -- two XXH64 hashes of the same data, in one pass */
+static void hash128(const unsigned char *p, size_t len, const uint64_t seed[2],
+		    uint64_t h[2])
+{
+  uint64_t v[2][4], x;
+  size_t i = 0;
+  int j, k;
+
+  for (k = 0; k < 2; k++) {
+    v[k][0] = seed[k] + P1 + P2;
+    v[k][1] = seed[k] + P2;
+    v[k][2] = seed[k];
+    v[k][3] = seed[k] - P1;
+  }
+  for (; i + 32 <= len; i += 32)
+    for (j = 0; j < 4; j++) {
+      x = read64(p + i + 8 * j);
+      v[0][j] = mix(v[0][j], x);
+      v[1][j] = mix(v[1][j], x);
+    }
+  for (k = 0; k < 2; k++) h[k] = finish(v[k], seed[k], p + i, len - i, len);
+}
+
+
+/* cache_key -- make a key from a font and a description of the options */
+void cache_key(const unsigned char *font, size_t size, const void *params,
+	       size_t len, char key[CACHE_KEYLEN + 1])
+{
+  static const uint64_t seed[2] = {0, P5};
+  uint64_t f[2], h[2];
+
+  hash128(font, size, seed, f);
+  hash128(params, len, f, h);	/* The font's hash seeds the second */
+  (void) snprintf(key, CACHE_KEYLEN + 1, "%016llx%016llx",
+		  (unsigned long long)h[0], (unsigned long long)h[1]);
+}
+
+
+/* cache_open -- use (and create, if needed) the cache directory dir */
+bool cache_open(cache *c, const char *dir, unsigned long long limit)
+{
+  struct stat st;
+
+  if (mkdir(dir, 0777) == -1 && errno != EEXIST) return false;
+  if (stat(dir, &st) == -1) return false;
+  if (!S_ISDIR(st.st_mode)) {errno = ENOTDIR; return false;}
+  if (!(c->dir = strdup(dir))) return false;
+  c->limit = limit;
+  c->size = 0;
+  c->scanned = false;
+  c->hits = c->misses = c->evictions = 0;
+  pthread_mutex_init(&c->lock, NULL);
+  return true;
+}
+
+
+/* cache_close -- free the memory of a cache */
+void cache_close(cache *c)
+{
+  pthread_mutex_destroy(&c->lock);
+  free(c->dir);
+  c->dir = NULL;
+}
+
+
+/* send_entry -- copy a file in the cache to out, close fd
+ *
+ * If out is a new, empty file, it is made a reflink of the entry, if
+ * the filesystem can do that. Otherwise the data is copied, in the
+ * kernel if possible.
+ */
+static bool send_entry(int fd, int out)
+{
+  mapped_file m;
+  struct stat st;
+  bool ok;
+
+#ifdef FICLONE
+  io_count.syscalls += 3;
+  if (fstat(out, &st) == 0 && S_ISREG(st.st_mode) && st.st_size == 0 &&
+      lseek(out, 0, SEEK_CUR) == 0 && ioctl(out, FICLONE, fd) == 0) {
+    (void) lseek(out, 0, SEEK_END);
+    io_count.syscalls += 2;
+    return close(fd) == 0;
+  }
+#else
+  (void) st;
+#endif
+  io_count.syscalls++;
+  if (lseek(fd, 0, SEEK_SET) == -1 || !map_fd(fd, &m)) {
+    (void) close(fd);
+    return false;
+  }
+  ok = copy_range(m, 0, m.size, out);
+  return unmap_file(&m) && ok;
+}
+
+
+/* cache_get -- copy the entry for key to out, if there is one */
+bool cache_get(cache *c, const char *key, int out, bool *hit)
+{
+  char *path;
+  int fd;
+
+  if (asprintf(&path, "%s/%s.eot", c->dir, key) == -1) return false;
+  fd = open(path, O_RDONLY);
+  io_count.syscalls++;
+  free(path);
+  *hit = fd != -1;
+  if (fd == -1 && errno != ENOENT) return false;
+  __atomic_add_fetch(*hit ? &c->hits : &c->misses, 1, __ATOMIC_RELAXED);
+  if (fd == -1) return true;
+  (void) futimens(fd, NULL);	/* Mark it as recently used */
+  io_count.syscalls++;
+  return send_entry(fd, out);
+}
+
+
+/* cache_create -- make a temporary file in the cache, return its fd */
+int cache_create(cache *c, char **tmp)
+{
+  int fd;
+
+  if (asprintf(tmp, "%s/tmp.XXXXXX", c->dir) == -1) return -1;
+  if ((fd = mkstemp(*tmp)) == -1) {free(*tmp); return -1;}
+  (void) fchmod(fd, 0444);	/* Entries are never modified */
+  io_count.syscalls += 2;
+  return fd;
+}
+
+
+/* cmp_used -- compare entries by time of last use, for qsort */
+static int cmp_used(const void *a, const void *b)
+{
+  const struct timespec *s = &((const entry*)a)->used;
+  const struct timespec *t = &((const entry*)b)->used;
+
+  if (s->tv_sec != t->tv_sec) return s->tv_sec < t->tv_sec ? -1 : 1;
+  return (s->tv_nsec > t->tv_nsec) - (s->tv_nsec < t->tv_nsec);
+}
+
+
+/* list_entries -- get the entries of the cache and their total size */
+static size_t list_entries(cache *c, entry **entries,
+			   unsigned long long *total)
+{
+  size_t n = 0, alloc = 0, len;
+  struct dirent *d;
+  struct stat st;
+  entry *p;
+  DIR *dir;
+
+  *entries = NULL;
+  *total = 0;
+  if (!(dir = opendir(c->dir))) return 0;
+  while ((d = readdir(dir))) {
+    len = strlen(d->d_name);
+    if (len != CACHE_KEYLEN + 4 || strcmp(d->d_name + CACHE_KEYLEN, ".eot"))
+      continue;
+    if (fstatat(dirfd(dir), d->d_name, &st, 0) == -1) continue;
+    if (n == alloc) {
+      alloc = alloc ? 2 * alloc : 256;
+      if (!(p = realloc(*entries, alloc * sizeof(*p)))) break;
+      *entries = p;
+    }
+    memcpy((*entries)[n].name, d->d_name, len + 1);
+    (*entries)[n].used = st.st_mtim;
+    (*entries)[n++].size = st.st_size;
+    *total += st.st_size;
+  }
+  (void) closedir(dir);
+  return n;
+}
+
+
+/* evict -- remove the least recently used entries until under 90% */
+static void evict(cache *c)
+{
+  entry *entries;
+  size_t n, i;
+  int fd;
+
+  n = list_entries(c, &entries, &c->size);
+  qsort(entries, n, sizeof(*entries), cmp_used);
+  if ((fd = open(c->dir, O_RDONLY | O_DIRECTORY)) != -1) {
+    for (i = 0; i < n && c->size > c->limit / 10 * 9; i++)
+      if (unlinkat(fd, entries[i].name, 0) == 0) {
+	c->size -= entries[i].size;
+	__atomic_add_fetch(&c->evictions, 1, __ATOMIC_RELAXED);
+      }
+    (void) close(fd);
+  }
+  free(entries);
+}
+
+
+/* cache_insert -- copy a complete temporary file to out and add it */
+bool cache_insert(cache *c, const char *key, int fd, char *tmp, int out)
+{
+  entry *entries;
+  struct stat st;
+  char *path = NULL;
+  bool ok;
+  int e;
+
+  ok = fstat(fd, &st) == 0;
+  if (!send_entry(fd, out)) ok = false;
+  if (ok && asprintf(&path, "%s/%s.eot", c->dir, key) == -1) path = NULL;
+  ok = ok && path && rename(tmp, path) == 0;
+  io_count.syscalls += 2;
+  if (!ok) {			/* Not added, so the size is unchanged */
+    e = errno;
+    (void) unlink(tmp);
+    errno = e;
+  }
+  free(path);
+  free(tmp);
+  if (!ok) return false;
+
+  pthread_mutex_lock(&c->lock);
+  if (!c->scanned) {		/* The first time, measure the cache */
+    (void) list_entries(c, &entries, &c->size);
+    free(entries);
+    c->scanned = true;
+  } else {
+    c->size += st.st_size;
+  }
+  if (c->size > c->limit) evict(c);
+  pthread_mutex_unlock(&c->lock);
+  return true;
+}
@@ -0,0 +1,58 @@
+/* cache.h -- a directory of EOT files, named by a hash of their inputs
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+#define CACHE_KEYLEN 32		/* Hexadecimal digits in a key */
+
+typedef struct {
+  char *dir;
+  unsigned long long limit;	/* Maximum total size of the entries */
+  unsigned long long size;	/* Current total, once scanned */
+  bool scanned;			/* size has been measured */
+  pthread_mutex_t lock;		/* Protects size, scanned and eviction */
+  unsigned long hits, misses, evictions; /* Updated atomically */
+} cache;
+
+/* cache_open -- use (and create, if needed) the cache directory dir */
+extern bool cache_open(cache *c, const char *dir, unsigned long long limit);
+
+/* cache_close -- free the memory of a cache */
+extern void cache_close(cache *c);
+
+/* cache_key -- make a key from a font and a description of the options */
+extern void cache_key(const unsigned char *font, size_t size,
+		      const void *params, size_t len,
+		      char key[CACHE_KEYLEN + 1]);
+
+/* cache_get -- copy the entry for key to out, if there is one
+ *
+ * Sets *hit to whether there was an entry. Returns false on I/O errors.
+ */
+extern bool cache_get(cache *c, const char *key, int out, bool *hit);
+
+/* cache_create -- make a temporary file in the cache, return its fd
+ *
+ * *tmp is set to its allocated name, or the function returns -1.
+ */
+extern int cache_create(cache *c, char **tmp);
+
+/* cache_insert -- copy a complete temporary file to out and add it
+ *
+ * Takes over fd and tmp, whether it succeeds or not. Entries that
+ * were not used for the longest time are removed as long as the
+ * cache is larger than its limit. Returns false, with errno set, if
+ * out could not be written or the file could not be added.
+ */
+extern bool cache_insert(cache *c, const char *key, int fd, char *tmp,
+			 int out);
+
+#endif /* CACHE_H */
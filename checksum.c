@@ -0,0 +1,223 @@
+/* checksum -- the sum of a table of an OpenType font, and of bytes
+ *
+ * A table's checksum is the sum, modulo 2^32, of its contents read as
+ * big endian unsigned longs, with the last one padded with zeros. It
+ * is computed in vectors of 32-bit lanes, whose overflow is exactly
+ * the modulo that is wanted: with AVX2 if the processor has it, else
+ * with SSE2 on x86, NEON on ARM, or else a word at a time. Either way
+ * it runs at about the speed the memory can deliver the font.
+ *
+ * The RootStringCheckSum of an EOT header is a plain sum of bytes,
+ * which the same instruction sets compute with a sum of absolute
+ * differences against zero (x86) or pairwise widening adds (ARM).
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "sfnt.h"
+
+#if defined(HAVE_IMMINTRIN_H) && defined(__GNUC__) && \
+  (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define CHECKSUM_X86 1
+#elif defined(__ARM_NEON)
+# include <arm_neon.h>
+# define CHECKSUM_NEON 1
+#endif
+
+
+#ifdef CHECKSUM_X86
+/* sum_avx2 -- add 32 bytes at a time to *sum, return the number done */
+__attribute__((target("avx2")))
+static size_t sum_avx2(const unsigned char *data, size_t len, uint32_t *sum)
+{
+  const __m256i swap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+					11, 10, 9, 8, 15, 14, 13, 12,
+					3, 2, 1, 0, 7, 6, 5, 4,
+					11, 10, 9, 8, 15, 14, 13, 12);
+  __m256i a = _mm256_setzero_si256(), b = _mm256_setzero_si256();
+  __m128i s;
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {	/* Two sums, to hide the latency */
+    a = _mm256_add_epi32(a, _mm256_shuffle_epi8(
+      _mm256_loadu_si256((const __m256i*)(data + i)), swap));
+    b = _mm256_add_epi32(b, _mm256_shuffle_epi8(
+      _mm256_loadu_si256((const __m256i*)(data + i + 32)), swap));
+  }
+  for (; i + 32 <= len; i += 32)
+    a = _mm256_add_epi32(a, _mm256_shuffle_epi8(
+      _mm256_loadu_si256((const __m256i*)(data + i)), swap));
+  a = _mm256_add_epi32(a, b);
+  s = _mm_add_epi32(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+  *sum += (uint32_t)_mm_cvtsi128_si32(s);
+  return i;
+}
+
+
+/* bswap_sse2 -- reverse the bytes in each 32-bit lane, without SSSE3 */
+__attribute__((target("sse2")))
+static inline __m128i bswap_sse2(__m128i x)
+{
+  x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, 0xB1), 0xB1);
+}
+
+
+/* sum_sse2 -- add 16 bytes at a time to *sum, return the number done */
+__attribute__((target("sse2")))
+static size_t sum_sse2(const unsigned char *data, size_t len, uint32_t *sum)
+{
+  __m128i a = _mm_setzero_si128(), b = _mm_setzero_si128();
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    a = _mm_add_epi32(a, bswap_sse2(
+      _mm_loadu_si128((const __m128i*)(data + i))));
+    b = _mm_add_epi32(b, bswap_sse2(
+      _mm_loadu_si128((const __m128i*)(data + i + 16))));
+  }
+  for (; i + 16 <= len; i += 16)
+    a = _mm_add_epi32(a, bswap_sse2(
+      _mm_loadu_si128((const __m128i*)(data + i))));
+  a = _mm_add_epi32(a, b);
+  a = _mm_add_epi32(a, _mm_shuffle_epi32(a, 0x4E));
+  a = _mm_add_epi32(a, _mm_shuffle_epi32(a, 0xB1));
+  *sum += (uint32_t)_mm_cvtsi128_si32(a);
+  return i;
+}
+
+
+/* bytes_avx2 -- add 32 bytes at a time to *sum, return the number done */
+__attribute__((target("avx2")))
+static size_t bytes_avx2(const unsigned char *data, size_t len, uint64_t *sum)
+{
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i a = zero;
+  __m128i s;
+  uint64_t total;
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32)
+    a = _mm256_add_epi64(a, _mm256_sad_epu8(
+      _mm256_loadu_si256((const __m256i*)(data + i)), zero));
+  s = _mm_add_epi64(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+  s = _mm_add_epi64(s, _mm_unpackhi_epi64(s, s));
+  _mm_storel_epi64((__m128i*)&total, s);	/* Also on i386 */
+  *sum += total;
+  return i;
+}
+
+
+/* bytes_sse2 -- add 16 bytes at a time to *sum, return the number done */
+__attribute__((target("sse2")))
+static size_t bytes_sse2(const unsigned char *data, size_t len, uint64_t *sum)
+{
+  const __m128i zero = _mm_setzero_si128();
+  __m128i a = zero;
+  uint64_t total;
+  size_t i = 0;
+
+  for (; i + 16 <= len; i += 16)
+    a = _mm_add_epi64(a, _mm_sad_epu8(
+      _mm_loadu_si128((const __m128i*)(data + i)), zero));
+  a = _mm_add_epi64(a, _mm_unpackhi_epi64(a, a));
+  _mm_storel_epi64((__m128i*)&total, a);
+  *sum += total;
+  return i;
+}
+#endif /* CHECKSUM_X86 */
+
+
+#ifdef CHECKSUM_NEON
+/* sum_neon -- add 16 bytes at a time to *sum, return the number done */
+static size_t sum_neon(const unsigned char *data, size_t len, uint32_t *sum)
+{
+  uint32x4_t a = vdupq_n_u32(0), b = vdupq_n_u32(0);
+  uint32x2_t s;
+  size_t i = 0;
+
+  for (; i + 32 <= len; i += 32) {
+    a = vaddq_u32(a, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i))));
+    b = vaddq_u32(b, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data+i+16))));
+  }
+  for (; i + 16 <= len; i += 16)
+    a = vaddq_u32(a, vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + i))));
+  a = vaddq_u32(a, b);
+  s = vadd_u32(vget_low_u32(a), vget_high_u32(a));
+  *sum += vget_lane_u32(vpadd_u32(s, s), 0);
+  return i;
+}
+
+
+/* bytes_neon -- add 16 bytes at a time to *sum, return the number done */
+static size_t bytes_neon(const unsigned char *data, size_t len, uint64_t *sum)
+{
+  uint32x4_t a = vdupq_n_u32(0);
+  uint32x2_t s;
+  size_t i = 0;
+
+  /* A 32-bit lane gets 4 bytes per round, it cannot overflow in 2^24 */
+  for (; i + 16 <= len && i < (1UL << 24); i += 16)
+    a = vpadalq_u16(a, vpaddlq_u8(vld1q_u8(data + i)));
+  s = vadd_u32(vget_low_u32(a), vget_high_u32(a));
+  *sum += vget_lane_u32(vpadd_u32(s, s), 0);
+  return i;
+}
+#endif /* CHECKSUM_NEON */
+
+
+/* table_checksum -- the sum of a table as big endian unsigned longs */
+unsigned long table_checksum(const unsigned char *data, size_t len)
+{
+  uint32_t sum = 0;
+  size_t i;
+
+#if defined(CHECKSUM_X86)
+  if (__builtin_cpu_supports("avx2")) i = sum_avx2(data, len, &sum);
+  else if (__builtin_cpu_supports("sse2")) i = sum_sse2(data, len, &sum);
+  else i = 0;
+#elif defined(CHECKSUM_NEON)
+  i = sum_neon(data, len, &sum);
+#else
+  i = 0;
+#endif
+  for (; i + 4 <= len; i += 4)
+    sum += ((uint32_t)data[i] << 24) | ((uint32_t)data[i+1] << 16) |
+      ((uint32_t)data[i+2] << 8) | data[i+3];
+  switch (len - i) {		/* The table is implicitly padded with 0 */
+  case 3: sum += (uint32_t)data[i+2] << 8;		/* Fall through */
+  case 2: sum += (uint32_t)data[i+1] << 16;		/* Fall through */
+  case 1: sum += (uint32_t)data[i] << 24;
+  }
+  return sum;
+}
+
+
+/* byte_sum -- the sum of len bytes */
+unsigned long byte_sum(const unsigned char *data, size_t len)
+{
+  uint64_t sum = 0;
+  size_t i;
+
+#if defined(CHECKSUM_X86)
+  if (__builtin_cpu_supports("avx2")) i = bytes_avx2(data, len, &sum);
+  else if (__builtin_cpu_supports("sse2")) i = bytes_sse2(data, len, &sum);
+  else i = 0;
+#elif defined(CHECKSUM_NEON)
+  i = bytes_neon(data, len, &sum);
+#else
+  i = 0;
+#endif
+  for (; i < len; i++) sum += data[i];
+  return sum;
+}
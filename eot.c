@@ -0,0 +1,983 @@
+/* eot -- create and parse EOT headers in memory
+ *
+ * Author: Bert Bos <bert@w3.org>
+ * Created: 24 January 2010
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <string.h>
+#include <time.h>
+#include "eot.h"
+#include "sfnt.h"
+#include "mtx.h"
+#include "subset.h"
+#include "utf8.h"
+#include "woff.h"
+#include "probes.h"
+#include "alloc.h"
+
+static __thread eot_timings *timings;	/* Set by eot_time_phases() */
+static __thread bool in_phase;		/* A timed phase is running */
+
+
+/* eot_strerror -- return a message describing a status */
+const char *eot_strerror(eot_status status)
+{
+  switch (status) {
+  case EOT_OK: return "Success";
+  case EOT_ERR_NOMEM: return "Out of memory";
+  case EOT_ERR_SFNT: return "Not an OpenType or TrueType font";
+  case EOT_ERR_TRUNCATED: return "Font file is truncated or corrupt";
+  case EOT_ERR_MISSING_TABLE: return "Font lacks an OS/2, name or head table";
+  case EOT_ERR_OS2_VERSION: return "Unsupported OS/2 table version";
+  case EOT_ERR_NAME_FORMAT: return "Unsupported Name Table format";
+  case EOT_ERR_NAME_ENCODING: return "Unsupported encoding in Name Table";
+  case EOT_ERR_PLATFORM: return "Invalid PlatformID in Name Table";
+  case EOT_ERR_RESTRICTED: return "Font does not allow embedding";
+  case EOT_ERR_BITMAP: return "Unsupported (font requires bitmap embedding)";
+  case EOT_ERR_BUFFER: return "Buffer too small";
+  case EOT_ERR_HEADER: return "Unrecognized EOT header";
+  case EOT_ERR_VERSION: return "Unsupported EOT version";
+  case EOT_ERR_MTX: return "Corrupt or unsupported MicroType Express data";
+  case EOT_ERR_NOSUBSETTING: return "Font does not allow subsetting";
+  case EOT_ERR_OUTLINES: return "Can only subset TrueType outlines";
+  case EOT_ERR_CMAP: return "Font lacks a usable cmap table";
+  case EOT_ERR_TABLE_CHECKSUM: return "Font has a table with a wrong checksum";
+  case EOT_ERR_FONT_CHECKSUM: return "Font has a wrong checkSumAdjustment";
+  case EOT_ERR_EOT_SIZE: return "EOTSize does not match the file size";
+  case EOT_ERR_FONT_DATA_SIZE:
+    return "FontDataSize does not match the data after the header";
+  case EOT_ERR_ROOTSTRING_CHECKSUM: return "Wrong RootStringCheckSum";
+  case EOT_ERR_ADJUSTMENT:
+    return "CheckSumAdjustment differs from the font's";
+  case EOT_ERR_UTF8: return "URL is not valid UTF-8";
+  case EOT_ERR_ROOTSTRING_SIZE: return "URLs exceed the 65535 bytes allowed";
+  case EOT_ERR_TEMPLATE: return "Not a valid EOT template";
+  case EOT_ERR_FACE: return "No font with that index in the collection";
+  case EOT_ERR_WOFF: return "Corrupt or unsupported WOFF data";
+  case EOT_ERR_WOFF_SUPPORT:
+    return "Cannot decompress WOFF data (built without zlib or Brotli)";
+  case EOT_ERR_MTX_TABLE:
+    return "Cannot decompress the hdmx or VDMX table of a compressed font";
+  }
+  return "Unknown error";
+}
+
+
+/* eot_time_phases -- time the phases of libeot's calls in this thread */
+void eot_time_phases(eot_timings *t)
+{
+  timings = t;
+  in_phase = false;
+}
+
+
+/* counted_malloc -- malloc, counted if the thread times its phases */
+void *counted_malloc(size_t n)
+{
+  if (timings) timings->allocs++;
+  return malloc(n);
+}
+
+
+/* counted_calloc -- calloc, counted if the thread times its phases */
+void *counted_calloc(size_t n, size_t size)
+{
+  if (timings) timings->allocs++;
+  return calloc(n, size);
+}
+
+
+/* counted_realloc -- realloc, counted if the thread times its phases */
+void *counted_realloc(void *p, size_t n)
+{
+  if (timings) timings->allocs++;
+  return realloc(p, n);
+}
+
+
+/* eot_phase_name -- a short name for a phase */
+const char *eot_phase_name(eot_phase p)
+{
+  static const char *const names[EOT_NPHASES] = {
+    "woff", "face", "directory", "tables", "names", "rootstring",
+    "checksums", "subset", "decompress", "header", "parse",
+    "verify"};
+
+  return p < EOT_NPHASES ? names[p] : "unknown";
+}
+
+
+/* now -- nanoseconds since some fixed time, by the monotonic clock */
+static unsigned long long now(void)
+{
+  struct timespec t;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+/* phase_start -- the time at which a phase starts, 0 if it isn't timed
+ *
+ * Phases are not timed unless eot_time_phases() was called, and not
+ * inside another phase, which then includes them.
+ */
+static unsigned long long phase_start(void)
+{
+  if (!timings || in_phase) return 0;
+  in_phase = true;
+  return now();
+}
+
+
+/* phase_next -- add the time since start to phase p, start the next */
+static unsigned long long phase_next(eot_phase p, unsigned long long start)
+{
+  unsigned long long t;
+
+  if (start == 0) return 0;
+  t = now();
+  timings->ns[p] += t - start;
+  timings->calls[p]++;
+  return t;
+}
+
+
+/* phase_end -- add the time since start to phase p, which is finished */
+static void phase_end(eot_phase p, unsigned long long start)
+{
+  if (start == 0) return;
+  (void) phase_next(p, start);
+  in_phase = false;
+}
+
+
+/* put_4le -- store a little endian unsigned long at *p and advance p */
+static void put_4le(unsigned char **p, unsigned long x)
+{
+  (*p)[0] = x & 0x000000ff;
+  (*p)[1] = (x & 0x0000ff00) >> 8;
+  (*p)[2] = (x & 0x00ff0000) >> 16;
+  (*p)[3] = (x >> 24) & 0xff;
+  *p += 4;
+}
+
+
+/* put_2le -- store a little endian unsigned short at *p and advance p */
+static void put_2le(unsigned char **p, unsigned short x)
+{
+  (*p)[0] = x & 0x00ff;
+  (*p)[1] = x >> 8;
+  *p += 2;
+}
+
+
+/* put_bytes -- copy n bytes to *p and advance p */
+static void put_bytes(unsigned char **p, const unsigned char *s, size_t n)
+{
+  if (n) memcpy(*p, s, n);
+  *p += n;
+}
+
+
+/* eot_init_header -- fill an EOT struct with consistent values */
+void eot_init_header(EOT_header *h)
+{
+  h->EOTSize = 120;
+  h->FontDataSize = 0;
+  h->Version = EOT_VERSION_2_2;
+  h->Flags = 0;
+  memset(h->FontPANOSE, 0, 10);
+  h->Charset = 0;
+  h->Italic = 0;
+  h->Weight = 400;		/* "normal" */
+  h->fsType = 0x0;		/* "installable" */
+  h->MagicNumber = EOT_MAGIC;
+  h->UnicodeRange1 = 0;
+  h->UnicodeRange2 = 0;
+  h->UnicodeRange3 = 0;
+  h->UnicodeRange4 = 0;
+  h->CodePageRange1 = 0;
+  h->CodePageRange2 = 0;
+  h->CheckSumAdjustment = 0;
+  h->Reserved1 = 0;
+  h->Reserved2 = 0;
+  h->Reserved3 = 0;
+  h->Reserved4 = 0;
+  h->Padding1 = 0;
+  h->FamilyNameSize = 0;
+  h->FamilyName = NULL;
+  h->Padding2 = 0;
+  h->StyleNameSize = 0;
+  h->StyleName = NULL;
+  h->Padding3 = 0;
+  h->VersionNameSize = 0;
+  h->VersionName = NULL;
+  h->Padding4 = 0;
+  h->FullNameSize = 0;
+  h->FullName = NULL;
+  h->Padding5 = 0;
+  h->RootStringSize = 0;
+  h->RootString = NULL;
+  h->RootStringCheckSum = 0x50475342; /* The checksum of no rootstrings */
+  h->EUDCCodePage = 0;
+  h->Padding6 = 0;
+  h->SignatureSize = 0;
+  h->Signature = NULL;
+  h->EUDCFlags = 0;
+  h->EUDCFontSize = 0;
+  h->EUDCFontData = NULL;
+  h->FontData = NULL;
+}
+
+
+/* eot_free_header -- free the names, rootstrings, etc. of an EOT header */
+void eot_free_header(EOT_header *h)
+{
+  free(h->FamilyName);
+  free(h->StyleName);
+  free(h->VersionName);
+  free(h->FullName);
+  free(h->RootString);
+  free(h->Signature);
+  free(h->EUDCFontData);
+  h->FamilyName = h->StyleName = h->VersionName = h->FullName = NULL;
+  h->RootString = h->Signature = h->EUDCFontData = NULL;
+}
+
+
+/* eot_read_font -- get data from a font that is needed for EOT */
+eot_status eot_read_font(EOT_header *h, const unsigned char *font,
+			 size_t size)
+{
+  sfnt_offset_table sfnt = {.tables = NULL};
+  font_name names[] = {{.nameID = 1}, {.nameID = 2}, {.nameID = 5},
+		       {.nameID = 4}}; /* Family, style, version, full */
+  unsigned long long t;
+  OS2_table os2;
+  Head_table head;
+  eot_status e;
+
+  t = phase_start();
+  e = read_sfnt_header(font, size, &sfnt);
+  t = phase_next(EOT_PHASE_DIRECTORY, t);
+  if (e == EOT_OK && (e = read_OS2_table(sfnt, &os2)) == EOT_OK)
+    e = read_head_table(sfnt, &head);
+  t = phase_next(EOT_PHASE_TABLES, t);
+  if (e == EOT_OK) e = read_names(sfnt, 4, names);
+  phase_end(EOT_PHASE_NAMES, t);
+  if (e == EOT_OK) {
+    memcpy(h->FontPANOSE, os2.panose, 10);
+    h->Italic = os2.fsSelection & 0x01;
+    h->Weight = os2.usWeightClass;
+    h->fsType = os2.fsType;
+    h->UnicodeRange1 = os2.ulUnicodeRange1;
+    h->UnicodeRange2 = os2.ulUnicodeRange2;
+    h->UnicodeRange3 = os2.ulUnicodeRange3;
+    h->UnicodeRange4 = os2.ulUnicodeRange4;
+    h->CodePageRange1 = os2.ulCodePageRange1;
+    h->CodePageRange2 = os2.ulCodePageRange2;
+    h->CheckSumAdjustment = head.checkSumAdjustment;
+    h->FamilyNameSize = names[0].size;
+    h->FamilyName = names[0].name;
+    h->StyleNameSize = names[1].size;
+    h->StyleName = names[1].name;
+    h->VersionNameSize = names[2].size;
+    h->VersionName = names[2].name;
+    h->FullNameSize = names[3].size;
+    h->FullName = names[3].name;
+    h->EOTSize += h->FamilyNameSize + h->StyleNameSize +
+      h->VersionNameSize + h->FullNameSize;
+    h->FontData = font;
+    h->FontDataSize = size;
+    h->EOTSize += h->FontDataSize;
+  }
+
+  free_sfnt_header(&sfnt);
+  return e;
+}
+
+
+/* eot_decode_woff -- make an OpenType font of a WOFF or WOFF 2.0 file */
+eot_status eot_decode_woff(const unsigned char *font, size_t size,
+			   unsigned char **sfnt, size_t *len)
+{
+  unsigned long long t;
+  eot_status e;
+  buffer b;
+
+  *sfnt = NULL;
+  buf_init(&b);
+  t = phase_start();
+  e = woff_decode(font, size, &b);
+  phase_end(EOT_PHASE_WOFF, t);
+  if (e != EOT_OK) {
+    free(b.data);
+    return e;
+  }
+  *sfnt = b.data;
+  *len = b.length;
+  return EOT_OK;
+}
+
+
+/* eot_count_faces -- the number of fonts in a TrueType Collection */
+eot_status eot_count_faces(const unsigned char *font, size_t size,
+			   unsigned long *n)
+{
+  view offsets;
+
+  return read_ttc_header(font, size, n, &offsets);
+}
+
+
+/* eot_extract_face -- copy a font of a collection into a new font */
+eot_status eot_extract_face(const unsigned char *font, size_t size,
+			    unsigned long index, unsigned char **face,
+			    size_t *len)
+{
+  unsigned long n, offset;
+  unsigned long long t;
+  eot_status e;
+  buffer b;
+  view v;
+
+  *face = NULL;
+  if ((e = read_ttc_header(font, size, &n, &v)) != EOT_OK) return e;
+  if (index >= n) return EOT_ERR_FACE;
+  v.pos = 4 * index;
+  (void) get_4be(&v, &offset);
+  buf_init(&b);
+  t = phase_start();
+  e = extract_face(font, size, offset, &b);
+  phase_end(EOT_PHASE_FACE, t);
+  if (e != EOT_OK) {
+    free(b.data);
+    return e;
+  }
+  *face = b.data;
+  *len = b.length;
+  return EOT_OK;
+}
+
+
+/* eot_check_embedding -- check that the font's fsType allows an EOT */
+eot_status eot_check_embedding(const EOT_header *h)
+{
+  if (!(h->fsType & FSTYPE_EDITABLE) &&
+      !(h->fsType & FSTYPE_PREVIEW) &&
+      h->fsType & FSTYPE_RESTRICTED)
+    return EOT_ERR_RESTRICTED;
+  if (h->fsType & FSTYPE_BITMAP)
+    return EOT_ERR_BITMAP;
+  return EOT_OK;
+}
+
+
+/* get_byte_checksum -- calculate checksum over rootstrings */
+static unsigned long get_byte_checksum(const unsigned char* s,
+				       unsigned short len)
+{
+  return (byte_sum(s, len) ^ 0x50475342) & 0xFFFFFFFF;
+}
+
+
+/* eot_add_rootstring -- add a URL to the EOT header */
+eot_status eot_add_rootstring(EOT_header *h, const char *url)
+{
+  return eot_add_rootstrings(h, &url, 1);
+}
+
+
+/* add_rootstrings -- add URLs to the EOT header, growing it once
+ *
+ * The URLs are measured first, so that the RootString is reallocated
+ * only once and too many URLs are caught before anything changes.
+ * The checksum is the sum of the bytes XOR'ed with a constant, so
+ * the new bytes are added to the sum that the old checksum holds.
+ */
+static eot_status add_rootstrings(EOT_header *h, const char *const urls[],
+				  int n)
+{
+  unsigned long sum;
+  size_t total = 0, len;
+  unsigned char *p, *q;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    assert(urls[i]);
+    if (!utf16_length((const unsigned char*)urls[i], strlen(urls[i]), &len))
+      return EOT_ERR_UTF8;
+    total += len + 2;		/* Each URL ends with a UTF-16 NUL */
+    if (h->RootStringSize + total > 0xFFFF) return EOT_ERR_ROOTSTRING_SIZE;
+  }
+  if (total == 0) return EOT_OK;
+  if (!(p = counted_realloc(h->RootString, h->RootStringSize + total)))
+    return EOT_ERR_NOMEM;
+  h->RootString = p;
+
+  q = p + h->RootStringSize;
+  for (i = 0; i < n; i++) {
+    q = utf8_to_utf16le((const unsigned char*)urls[i], strlen(urls[i]), q);
+    *q++ = '\0';
+    *q++ = '\0';
+  }
+  sum = (h->RootStringCheckSum ^ 0x50475342) +
+    byte_sum(h->RootString + h->RootStringSize, total);
+  h->RootStringCheckSum = (sum & 0xFFFFFFFF) ^ 0x50475342;
+  h->RootStringSize += total;
+  h->EOTSize += total;
+  return EOT_OK;
+}
+
+
+/* eot_add_rootstrings -- add URLs to the EOT header */
+eot_status eot_add_rootstrings(EOT_header *h, const char *const urls[],
+			       int n)
+{
+  unsigned long long t = phase_start();
+  eot_status e = add_rootstrings(h, urls, n);
+
+  phase_end(EOT_PHASE_ROOTSTRING, t);
+  return e;
+}
+
+
+/* eot_subset_font_data -- keep only the glyphs for some characters */
+eot_status eot_subset_font_data(EOT_header *h,
+				const eot_unicode_range ranges[],
+				size_t nranges, unsigned char **data)
+{
+  sfnt_offset_table sfnt = {.tables = NULL};
+  unsigned long long t;
+  Head_table head;
+  buffer b;
+  eot_status e;
+
+  assert(!(h->Flags & TTEMBED_TTCOMPRESSED));
+  *data = NULL;
+  if (h->fsType & FSTYPE_NOSUBSETTING) return EOT_ERR_NOSUBSETTING;
+  buf_init(&b);
+  t = phase_start();
+  if ((e = subset_font(h->FontData, h->FontDataSize, ranges, nranges, &b))
+      == EOT_OK &&
+      (e = read_sfnt_header(b.data, b.length, &sfnt)) == EOT_OK)
+    e = read_head_table(sfnt, &head);
+  phase_end(EOT_PHASE_SUBSET, t);
+  free_sfnt_header(&sfnt);
+  if (e != EOT_OK) {
+    free(b.data);
+    return e;
+  }
+  h->EOTSize = h->EOTSize - h->FontDataSize + b.length;
+  h->FontDataSize = b.length;
+  h->FontData = *data = b.data;
+  h->Flags |= TTEMBED_SUBSET;
+  h->CheckSumAdjustment = head.checkSumAdjustment;
+  return EOT_OK;
+}
+
+
+/* eot_verify_font -- check the table checksums and checkSumAdjustment */
+eot_status eot_verify_font(const unsigned char *font, size_t size)
+{
+  unsigned long long t = phase_start();
+  sfnt_offset_table sfnt;
+  eot_status e;
+
+  if ((e = read_sfnt_header(font, size, &sfnt)) == EOT_OK)
+    e = verify_sfnt(sfnt);
+  free_sfnt_header(&sfnt);
+  phase_end(EOT_PHASE_CHECKSUMS, t);
+  return e;
+}
+
+
+/* eot_fix_checksums -- make a copy of FontData with correct checksums */
+eot_status eot_fix_checksums(EOT_header *h, unsigned char **data)
+{
+  sfnt_offset_table sfnt = {.tables = NULL};
+  unsigned long long t;
+  Head_table head;
+  unsigned char *copy;
+  eot_status e;
+
+  assert(!(h->Flags & TTEMBED_TTCOMPRESSED));
+  *data = NULL;
+  if (!(copy = counted_malloc(h->FontDataSize ? h->FontDataSize : 1)))
+    return EOT_ERR_NOMEM;
+  t = phase_start();
+  memcpy(copy, h->FontData, h->FontDataSize);
+  if ((e = fix_sfnt_checksums(copy, h->FontDataSize)) == EOT_OK &&
+      (e = read_sfnt_header(copy, h->FontDataSize, &sfnt)) == EOT_OK)
+    e = read_head_table(sfnt, &head);
+  phase_end(EOT_PHASE_CHECKSUMS, t);
+  free_sfnt_header(&sfnt);
+  if (e != EOT_OK) {
+    free(copy);
+    return e;
+  }
+  h->FontData = *data = copy;
+  h->CheckSumAdjustment = head.checkSumAdjustment;
+  return EOT_OK;
+}
+
+
+/* eot_decompress_font -- decompress MicroType Express font data */
+eot_status eot_decompress_font(const unsigned char *data, size_t size,
+			       unsigned char **font, size_t *len)
+{
+  unsigned long long t;
+  buffer b;
+  eot_status e;
+
+  buf_init(&b);
+  t = phase_start();
+  e = mtx_decompress(data, size, &b);
+  phase_end(EOT_PHASE_DECOMPRESS, t);
+  if (e != EOT_OK) {
+    free(b.data);
+    *font = NULL;
+    return e;
+  }
+  *font = b.data;
+  *len = b.length;
+  return EOT_OK;
+}
+
+
+/* eot_header_size -- the number of bytes eot_write_header will write */
+size_t eot_header_size(const EOT_header *h)
+{
+  size_t n;
+
+  n = 96 + h->FamilyNameSize + h->StyleNameSize + h->VersionNameSize +
+    h->FullNameSize;
+  switch (h->Version) {
+  case EOT_VERSION_1_0: return n;
+  case EOT_VERSION_2_1: return n + 4 + h->RootStringSize;
+  default: return n + 24 + h->RootStringSize + h->SignatureSize +
+      h->EUDCFontSize;
+  }
+}
+
+
+/* write_header -- write an EOT header to buf */
+static eot_status write_header(const EOT_header *h, unsigned char *buf,
+			       size_t size, size_t *len)
+{
+  unsigned char *p = buf;
+
+  switch (h->Version) {
+  case EOT_VERSION_1_0: case EOT_VERSION_2_1: case EOT_VERSION_2_2: break;
+  default: return EOT_ERR_VERSION;
+  }
+  *len = eot_header_size(h);
+  if (size < *len) return EOT_ERR_BUFFER;
+
+  put_4le(&p, h->EOTSize);
+  put_4le(&p, h->FontDataSize);
+  put_4le(&p, h->Version);
+  put_4le(&p, h->Flags);
+  put_bytes(&p, h->FontPANOSE, 10);
+  *p++ = h->Charset;
+  *p++ = h->Italic;
+  put_4le(&p, h->Weight);
+  put_2le(&p, h->fsType);
+  put_2le(&p, h->MagicNumber);
+  put_4le(&p, h->UnicodeRange1);
+  put_4le(&p, h->UnicodeRange2);
+  put_4le(&p, h->UnicodeRange3);
+  put_4le(&p, h->UnicodeRange4);
+  put_4le(&p, h->CodePageRange1);
+  put_4le(&p, h->CodePageRange2);
+  put_4le(&p, h->CheckSumAdjustment);
+  put_4le(&p, h->Reserved1);
+  put_4le(&p, h->Reserved2);
+  put_4le(&p, h->Reserved3);
+  put_4le(&p, h->Reserved4);
+  put_2le(&p, h->Padding1);
+  put_2le(&p, h->FamilyNameSize);
+  put_bytes(&p, h->FamilyName, h->FamilyNameSize);
+  put_2le(&p, h->Padding2);
+  put_2le(&p, h->StyleNameSize);
+  put_bytes(&p, h->StyleName, h->StyleNameSize);
+  put_2le(&p, h->Padding3);
+  put_2le(&p, h->VersionNameSize);
+  put_bytes(&p, h->VersionName, h->VersionNameSize);
+  put_2le(&p, h->Padding4);
+  put_2le(&p, h->FullNameSize);
+  put_bytes(&p, h->FullName, h->FullNameSize);
+
+  if (h->Version != EOT_VERSION_1_0) {
+    put_2le(&p, h->Padding5);
+    put_2le(&p, h->RootStringSize);
+    put_bytes(&p, h->RootString, h->RootStringSize);
+  }
+  if (h->Version == EOT_VERSION_2_2) {
+    put_4le(&p, h->RootStringCheckSum);
+    put_4le(&p, h->EUDCCodePage);
+    put_2le(&p, h->Padding6);
+    put_2le(&p, h->SignatureSize);
+    put_bytes(&p, h->Signature, h->SignatureSize);
+    put_4le(&p, h->EUDCFlags);
+    put_4le(&p, h->EUDCFontSize);
+    put_bytes(&p, h->EUDCFontData, h->EUDCFontSize);
+  }
+  assert((size_t)(p - buf) == *len);
+  return EOT_OK;
+}
+
+
+/* eot_write_header -- write an EOT header to buf, timed */
+eot_status eot_write_header(const EOT_header *h, unsigned char *buf,
+			    size_t size, size_t *len)
+{
+  unsigned long long t = phase_start();
+  eot_status e;
+
+  PROBE2(header__entry, h->EOTSize, size);
+  e = write_header(h, buf, size, len);
+  PROBE2(header__return, e, e == EOT_OK ? *len : 0);
+  phase_end(EOT_PHASE_HEADER, t);
+  return e;
+}
+
+
+/* eot_write_template -- write an EOT header without URLs, as a template */
+eot_status eot_write_template(const EOT_header *h, unsigned char *buf,
+			      size_t size, size_t *len)
+{
+  EOT_header t = *h;
+  unsigned char *p = buf;
+  size_t n;
+
+  if (h->Version == EOT_VERSION_1_0) return EOT_ERR_VERSION;
+  t.EOTSize -= t.RootStringSize;
+  t.RootStringSize = 0;
+  t.RootString = NULL;
+  t.RootStringCheckSum = 0x50475342; /* The checksum of no rootstrings */
+  n = eot_header_size(&t);
+  *len = EOT_TEMPLATE_PREFIX + n;
+  if (size < *len) return EOT_ERR_BUFFER;
+
+  /* RootStringSize follows the names and Padding5 */
+  put_bytes(&p, (const unsigned char*)EOT_TEMPLATE_MAGIC, 4);
+  put_4le(&p, 98 + t.FamilyNameSize + t.StyleNameSize + t.VersionNameSize +
+	  t.FullNameSize);
+  put_4le(&p, n);
+  return eot_write_header(&t, p, size - EOT_TEMPLATE_PREFIX, &n);
+}
+
+
+/* eot_read_template -- check a template and find its parts
+ *
+ * Only the fields that eot_template_header() relies on are checked:
+ * the offsets, the sizes and that the template has no RootString.
+ */
+eot_status eot_read_template(eot_template *t, const unsigned char *tpl,
+			     size_t size)
+{
+  unsigned long rootstring, fontdata, eotsize, datasize;
+  unsigned short n;
+  view v;
+
+  if (size < EOT_TEMPLATE_PREFIX ||
+      memcmp(tpl, EOT_TEMPLATE_MAGIC, 4) != 0) return EOT_ERR_TEMPLATE;
+  t->eot = tpl + EOT_TEMPLATE_PREFIX;
+  t->size = size - EOT_TEMPLATE_PREFIX;
+  (void) make_view(tpl, size, 4, 8, &v);
+  (void) get_4le(&v, &rootstring);
+  (void) get_4le(&v, &fontdata);
+  if (!make_view(t->eot, t->size, 0, 12, &v) ||
+      !get_4le(&v, &eotsize) || !get_4le(&v, &datasize) ||
+      !get_4le(&v, &t->Version)) return EOT_ERR_TEMPLATE;
+  if (t->Version != EOT_VERSION_2_1 && t->Version != EOT_VERSION_2_2)
+    return EOT_ERR_VERSION;
+  t->rootstring = rootstring;
+  t->fontdata = fontdata;
+  if (eotsize != t->size || fontdata > t->size ||
+      datasize != t->size - fontdata || rootstring < 98 ||
+      !make_view(t->eot, fontdata, rootstring,
+		 t->Version == EOT_VERSION_2_2 ? 6 : 2, &v) ||
+      !get_2le(&v, &n) || n != 0)
+    return EOT_ERR_TEMPLATE;
+  return EOT_OK;
+}
+
+
+/* template_header -- insert a RootString into a template's header */
+static eot_status template_header(const eot_template *t,
+				  const char *const urls[], int n,
+				  unsigned char **header, size_t *len)
+{
+  size_t tail = t->rootstring + 2;
+  unsigned char *p;
+  EOT_header h;
+  eot_status e;
+
+  *header = NULL;
+  eot_init_header(&h);
+  if ((e = eot_add_rootstrings(&h, urls, n)) != EOT_OK) return e;
+  *len = t->fontdata + h.RootStringSize;
+  if (!(*header = p = counted_malloc(*len))) {
+    eot_free_header(&h);
+    return EOT_ERR_NOMEM;
+  }
+  put_bytes(&p, t->eot, t->rootstring);
+  put_2le(&p, h.RootStringSize);
+  put_bytes(&p, h.RootString, h.RootStringSize);
+  if (t->Version == EOT_VERSION_2_2) {
+    put_4le(&p, h.RootStringCheckSum);
+    tail += 4;
+  }
+  put_bytes(&p, t->eot + tail, t->fontdata - tail);
+  assert((size_t)(p - *header) == *len);
+  p = *header;
+  put_4le(&p, t->size + h.RootStringSize); /* EOTSize */
+  eot_free_header(&h);
+  return EOT_OK;
+}
+
+
+/* eot_template_header -- insert a RootString into a template's header */
+eot_status eot_template_header(const eot_template *t,
+			       const char *const urls[], int n,
+			       unsigned char **header, size_t *len)
+{
+  unsigned long long start = phase_start();
+  eot_status e = template_header(t, urls, n, header, len);
+
+  phase_end(EOT_PHASE_HEADER, start);
+  return e;
+}
+
+
+/* get_string -- copy n bytes from a view into a newly allocated string */
+static eot_status get_string(view *v, size_t n, unsigned char **s)
+{
+  if (v->length - v->pos < n) return EOT_ERR_HEADER;
+  if (!(*s = counted_malloc(n ? n : 1))) return EOT_ERR_NOMEM;
+  (void) get_bytes(v, *s, n);
+  return EOT_OK;
+}
+
+
+/* read_fixed_part -- read the header fields up to and including Padding1 */
+static bool read_fixed_part(view *v, EOT_header *h)
+{
+  return get_4le(v, &h->EOTSize) &&
+    get_4le(v, &h->FontDataSize) &&
+    get_4le(v, &h->Version) &&
+    get_4le(v, &h->Flags) &&
+    get_bytes(v, h->FontPANOSE, 10) &&
+    get_1(v, &h->Charset) &&
+    get_1(v, &h->Italic) &&
+    get_4le(v, &h->Weight) &&
+    get_2le(v, &h->fsType) &&
+    get_2le(v, &h->MagicNumber) &&
+    h->MagicNumber == EOT_MAGIC &&
+    get_4le(v, &h->UnicodeRange1) &&
+    get_4le(v, &h->UnicodeRange2) &&
+    get_4le(v, &h->UnicodeRange3) &&
+    get_4le(v, &h->UnicodeRange4) &&
+    get_4le(v, &h->CodePageRange1) &&
+    get_4le(v, &h->CodePageRange2) &&
+    get_4le(v, &h->CheckSumAdjustment) &&
+    get_4le(v, &h->Reserved1) && h->Reserved1 == 0 &&
+    get_4le(v, &h->Reserved2) && h->Reserved2 == 0 &&
+    get_4le(v, &h->Reserved3) && h->Reserved3 == 0 &&
+    get_4le(v, &h->Reserved4) && h->Reserved4 == 0 &&
+    get_2le(v, &h->Padding1) && h->Padding1 == 0;
+}
+
+
+/* read_header -- read the header part of an EOT file */
+static eot_status read_header(EOT_header *h, const unsigned char *eot,
+			      size_t size, size_t *len)
+{
+  eot_status e;
+  view v;
+
+  eot_init_header(h);
+  (void) make_view(eot, size, 0, size, &v);
+  if (!read_fixed_part(&v, h)) return EOT_ERR_HEADER;
+
+  if (!get_2le(&v, &h->FamilyNameSize)) return EOT_ERR_HEADER;
+  if ((e = get_string(&v, h->FamilyNameSize, &h->FamilyName))) return e;
+  if (!get_2le(&v, &h->Padding2) || h->Padding2 != 0) return EOT_ERR_HEADER;
+  if (!get_2le(&v, &h->StyleNameSize)) return EOT_ERR_HEADER;
+  if ((e = get_string(&v, h->StyleNameSize, &h->StyleName))) return e;
+  if (!get_2le(&v, &h->Padding3) || h->Padding3 != 0) return EOT_ERR_HEADER;
+  if (!get_2le(&v, &h->VersionNameSize)) return EOT_ERR_HEADER;
+  if ((e = get_string(&v, h->VersionNameSize, &h->VersionName))) return e;
+  if (!get_2le(&v, &h->Padding4) || h->Padding4 != 0) return EOT_ERR_HEADER;
+  if (!get_2le(&v, &h->FullNameSize)) return EOT_ERR_HEADER;
+  if ((e = get_string(&v, h->FullNameSize, &h->FullName))) return e;
+
+  switch (h->Version) {
+  case EOT_VERSION_1_0:
+    break;
+  case EOT_VERSION_2_1:
+  case EOT_VERSION_2_2:
+    if (!get_2le(&v, &h->Padding5) || h->Padding5 != 0) return EOT_ERR_HEADER;
+    if (!get_2le(&v, &h->RootStringSize)) return EOT_ERR_HEADER;
+    if ((e = get_string(&v, h->RootStringSize, &h->RootString))) return e;
+    if (h->Version == EOT_VERSION_2_1) break;
+    if (!get_4le(&v, &h->RootStringCheckSum)) return EOT_ERR_HEADER;
+    if (!get_4le(&v, &h->EUDCCodePage)) return EOT_ERR_HEADER;
+    if (!get_2le(&v, &h->Padding6) || h->Padding6 != 0) return EOT_ERR_HEADER;
+    if (!get_2le(&v, &h->SignatureSize)) return EOT_ERR_HEADER;
+    if ((e = get_string(&v, h->SignatureSize, &h->Signature))) return e;
+    if (!get_4le(&v, &h->EUDCFlags)) return EOT_ERR_HEADER;
+    if (!get_4le(&v, &h->EUDCFontSize)) return EOT_ERR_HEADER;
+    if ((e = get_string(&v, h->EUDCFontSize, &h->EUDCFontData))) return e;
+    break;
+  default:
+    return EOT_ERR_VERSION;
+  }
+
+  /* The font data follows, if it is in the buffer */
+  *len = v.pos;
+  if (size - v.pos >= h->FontDataSize) h->FontData = eot + v.pos;
+  return EOT_OK;
+}
+
+
+/* eot_read_header -- read the header part of an EOT file, timed */
+eot_status eot_read_header(EOT_header *h, const unsigned char *eot,
+			   size_t size, size_t *len)
+{
+  unsigned long long t = phase_start();
+  eot_status e;
+
+  PROBE1(parse__entry, size);
+  e = read_header(h, eot, size, len);
+  PROBE2(parse__return, e, e == EOT_OK ? *len : 0);
+  phase_end(EOT_PHASE_PARSE, t);
+  return e;
+}
+
+
+/* verify_font_data -- check the font in an EOT file and its checksums
+ *
+ * The data is deobfuscated and decompressed first, if needed. A
+ * decompressed font is rebuilt, with its own checkSumAdjustment, so
+ * that is only compared to the header's if the font was not compressed.
+ */
+static eot_status verify_font_data(const EOT_header *h)
+{
+  unsigned char *plain = NULL, *font = NULL;
+  const unsigned char *data = h->FontData;
+  size_t size = h->FontDataSize;
+  sfnt_offset_table sfnt;
+  Head_table head;
+  eot_status e;
+
+  if (h->Flags & TTEMBED_XORENCRYPTDATA) {
+    if (!(plain = counted_malloc(size ? size : 1))) return EOT_ERR_NOMEM;
+    eot_xor(plain, data, size);
+    data = plain;
+  }
+  if (h->Flags & TTEMBED_TTCOMPRESSED) {
+    e = eot_decompress_font(data, size, &font, &size);
+    free(plain);
+    if (e != EOT_OK) return e;
+    data = font;
+  }
+  if ((e = read_sfnt_header(data, size, &sfnt)) == EOT_OK &&
+      (e = verify_sfnt(sfnt)) == EOT_OK &&
+      !font && (e = read_head_table(sfnt, &head)) == EOT_OK &&
+      head.checkSumAdjustment != h->CheckSumAdjustment)
+    e = EOT_ERR_ADJUSTMENT;
+  free_sfnt_header(&sfnt);
+  free(font ? font : plain);
+  return e;
+}
+
+
+/* eot_verify -- check the sizes and checksums of a whole EOT file */
+eot_status eot_verify(const unsigned char *eot, size_t size)
+{
+  unsigned long long t = phase_start();
+  EOT_header h;
+  eot_status e;
+  size_t len;
+
+  e = eot_read_header(&h, eot, size, &len);
+  if (e == EOT_OK && h.EOTSize != size) e = EOT_ERR_EOT_SIZE;
+  if (e == EOT_OK && h.FontDataSize != size - len) e = EOT_ERR_FONT_DATA_SIZE;
+  if (e == EOT_OK && h.Version == EOT_VERSION_2_2 &&
+      h.RootStringCheckSum != get_byte_checksum(h.RootString,
+						h.RootStringSize))
+    e = EOT_ERR_ROOTSTRING_CHECKSUM;
+  if (e == EOT_OK) e = verify_font_data(&h);
+  eot_free_header(&h);
+  phase_end(EOT_PHASE_VERIFY, t);
+  return e;
+}
+
+
+/* make_header -- fill an EOT header for the given font and URLs */
+static eot_status make_header(const unsigned char *font, size_t size,
+			      const char *const urls[], int nurls,
+			      EOT_header *h)
+{
+  eot_status e;
+
+  eot_init_header(h);
+  if ((e = eot_read_font(h, font, size)) != EOT_OK) return e;
+  if ((e = eot_check_embedding(h)) != EOT_OK) return e;
+  return eot_add_rootstrings(h, urls, nurls);
+}
+
+
+/* eot_encode_into -- make an EOT file from a font and URLs in buf */
+eot_status eot_encode_into(const unsigned char *font, size_t size,
+			   const char *const urls[], int nurls,
+			   unsigned char *buf, size_t bufsize, size_t *len)
+{
+  EOT_header h;
+  size_t n;
+  eot_status e;
+
+  if ((e = make_header(font, size, urls, nurls, &h)) == EOT_OK) {
+    *len = eot_header_size(&h) + size;
+    if (bufsize < *len) e = EOT_ERR_BUFFER;
+    else if ((e = eot_write_header(&h, buf, bufsize, &n)) == EOT_OK)
+      memcpy(buf + n, font, size);
+  }
+  eot_free_header(&h);
+  return e;
+}
+
+
+/* eot_encode -- make an EOT file from a font and URLs, allocate the result */
+eot_status eot_encode(const unsigned char *font, size_t size,
+		      const char *const urls[], int nurls,
+		      unsigned char **eot, size_t *len)
+{
+  EOT_header h;
+  size_t n;
+  eot_status e;
+
+  *eot = NULL;
+  if ((e = make_header(font, size, urls, nurls, &h)) == EOT_OK) {
+    *len = eot_header_size(&h) + size;
+    if (!(*eot = counted_malloc(*len))) e = EOT_ERR_NOMEM;
+    else if ((e = eot_write_header(&h, *eot, *len, &n)) == EOT_OK)
+      memcpy(*eot + n, font, size);
+    else {free(*eot); *eot = NULL;}
+  }
+  eot_free_header(&h);
+  return e;
+}
@@ -0,0 +1,379 @@
+/* eot.h -- create and read Embedded OpenType (EOT) files in memory
+ *
+ * The functions in libeot work on fonts and EOT files that are
+ * already in memory. They do not do any I/O, do not exit on errors,
+ * but return an eot_status instead, and keep no global state, so they
+ * can be called from several threads at once.
+ *
+ * To make an EOT file in one go, call eot_encode() (which allocates
+ * the result) or eot_encode_into() (which writes to a given buffer).
+ * To write the font data separately, e.g., with zero-copy I/O, use
+ * eot_init_header(), eot_read_font(), eot_add_rootstring() and
+ * eot_write_header() and append the font yourself. Call
+ * eot_subset_font_data() before eot_write_header() to subset it.
+ *
+ * To make many EOT files from the same font with different URLs, save
+ * a template with eot_write_template() (once) and make each EOT file
+ * with eot_read_template() and eot_template_header(), which only
+ * insert the RootString and do not look at the font at all.
+ *
+ * To find out where the time goes, a thread can pass eot_time_phases()
+ * a struct, to which libeot then adds the time spent in each phase of
+ * the calls made in that thread, and the number of allocations.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef EOT_H
+#define EOT_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TTEMBED_SUBSET				0x00000001
+#define TTEMBED_TTCOMPRESSED			0x00000004
+#define TTEMBED_FAILIFVARIATIONSIMULATED	0x00000010
+#define TTEMBED_EMBEDEUDC			0x00000020
+#define TTEMBED_VALIDATIONTESTS			0x00000040
+#define TTEMBED_WEBOBJECT			0x00000080
+#define TTEMBED_XORENCRYPTDATA			0x10000000
+
+#define EOT_XOR_KEY				0x50	/* For TTEMBED_XORENCRYPTDATA */
+
+#define FSTYPE_RESTRICTED			0x0002
+#define FSTYPE_PREVIEW				0x0004
+#define FSTYPE_EDITABLE				0x0008
+#define FSTYPE_NOSUBSETTING			0x0100
+#define FSTYPE_BITMAP				0x0200
+
+#define EOT_VERSION_1_0				0x00010000
+#define EOT_VERSION_2_1				0x00020001
+#define EOT_VERSION_2_2				0x00020002
+
+#define EOT_MAGIC				0x504C
+
+typedef enum {
+  EOT_OK = 0,
+  EOT_ERR_NOMEM,		/* Out of memory */
+  EOT_ERR_SFNT,			/* Not an OpenType or TrueType font */
+  EOT_ERR_TRUNCATED,		/* A table extends past the end of the font */
+  EOT_ERR_MISSING_TABLE,	/* No OS/2, name or head table */
+  EOT_ERR_OS2_VERSION,		/* Unknown version of the OS/2 table */
+  EOT_ERR_NAME_FORMAT,		/* Unsupported name table format */
+  EOT_ERR_NAME_ENCODING,	/* Unsupported encoding in the name table */
+  EOT_ERR_PLATFORM,		/* Invalid PlatformID in the name table */
+  EOT_ERR_RESTRICTED,		/* The font does not allow embedding */
+  EOT_ERR_BITMAP,		/* The font requires bitmap embedding */
+  EOT_ERR_BUFFER,		/* The output buffer is too small */
+  EOT_ERR_HEADER,		/* Not a valid EOT header */
+  EOT_ERR_VERSION,		/* Unknown EOT version */
+  EOT_ERR_MTX,			/* Corrupt MicroType Express data */
+  EOT_ERR_NOSUBSETTING,		/* The font does not allow subsetting */
+  EOT_ERR_OUTLINES,		/* Not TrueType outlines, cannot subset */
+  EOT_ERR_CMAP,			/* No usable cmap table */
+  EOT_ERR_TABLE_CHECKSUM,	/* A table's checkSum is wrong */
+  EOT_ERR_FONT_CHECKSUM,	/* head.checkSumAdjustment is wrong */
+  EOT_ERR_EOT_SIZE,		/* EOTSize is not the size of the file */
+  EOT_ERR_FONT_DATA_SIZE,	/* FontDataSize is not what follows the header */
+  EOT_ERR_ROOTSTRING_CHECKSUM,	/* RootStringCheckSum is wrong */
+  EOT_ERR_ADJUSTMENT,		/* CheckSumAdjustment differs from the font's */
+  EOT_ERR_UTF8,			/* A URL is not valid UTF-8 */
+  EOT_ERR_ROOTSTRING_SIZE,	/* The URLs do not fit in 64 KiB of UTF-16 */
+  EOT_ERR_TEMPLATE,		/* Not a valid EOT template */
+  EOT_ERR_FACE,			/* No font with that index in the collection */
+  EOT_ERR_WOFF,			/* Corrupt WOFF or WOFF 2.0 data */
+  EOT_ERR_WOFF_SUPPORT,		/* Built without the zlib or Brotli needed */
+  EOT_ERR_MTX_TABLE		/* Compressed hdmx or VDMX, not supported */
+} eot_status;
+
+typedef struct {		/* Code points first..last */
+  unsigned long first;
+  unsigned long last;
+} eot_unicode_range;
+
+/* A template is an EOT file without URLs, preceded by the 4 bytes
+ * "EOTT" and by the offsets (little endian unsigned longs) of the
+ * RootStringSize field and of the font data in the EOT file */
+#define EOT_TEMPLATE_MAGIC "EOTT"
+#define EOT_TEMPLATE_PREFIX 12		/* Bytes before the EOT file */
+
+typedef struct {		/* The parts of a template */
+  const unsigned char *eot;	/* The EOT file without URLs */
+  size_t size;			/* Its size, including the font data */
+  size_t rootstring;		/* Offset of RootStringSize in eot */
+  size_t fontdata;		/* Offset of the font data in eot */
+  unsigned long Version;
+} eot_template;
+
+typedef enum {			/* The phases that libeot times */
+  EOT_PHASE_WOFF,		/* Decoding WOFF or WOFF 2.0 */
+  EOT_PHASE_FACE,		/* Copying a font out of a collection */
+  EOT_PHASE_DIRECTORY,		/* Reading the table directory */
+  EOT_PHASE_TABLES,		/* Reading the OS/2 and head tables */
+  EOT_PHASE_NAMES,		/* Decoding the names */
+  EOT_PHASE_ROOTSTRING,		/* Converting URLs to the RootString */
+  EOT_PHASE_CHECKSUMS,		/* Verifying or fixing the font's checksums */
+  EOT_PHASE_SUBSET,
+  EOT_PHASE_DECOMPRESS,
+  EOT_PHASE_HEADER,		/* Serializing an EOT header or template */
+  EOT_PHASE_PARSE,		/* Parsing an EOT header or template */
+  EOT_PHASE_VERIFY,		/* Checking a whole EOT file */
+  EOT_NPHASES
+} eot_phase;
+
+typedef struct {		/* Time spent in each phase */
+  unsigned long long ns[EOT_NPHASES];
+  unsigned long calls[EOT_NPHASES];
+  unsigned long allocs;		/* Calls to malloc, calloc and realloc */
+} eot_timings;
+
+typedef struct {
+  unsigned long EOTSize;
+  unsigned long FontDataSize;
+  unsigned long Version;
+  unsigned long Flags;
+  unsigned char FontPANOSE[10];
+  unsigned char Charset;
+  unsigned char Italic;
+  unsigned long Weight;
+  unsigned short fsType;
+  unsigned short MagicNumber;	/* = 0x504C */
+  unsigned long UnicodeRange1;
+  unsigned long UnicodeRange2;
+  unsigned long UnicodeRange3;
+  unsigned long UnicodeRange4;
+  unsigned long CodePageRange1;
+  unsigned long CodePageRange2;
+  unsigned long CheckSumAdjustment;
+  unsigned long Reserved1;	/* = 0 */
+  unsigned long Reserved2;	/* = 0 */
+  unsigned long Reserved3;	/* = 0 */
+  unsigned long Reserved4;	/* = 0 */
+  unsigned short Padding1;	/* = 0 */
+  unsigned short FamilyNameSize;
+  unsigned char *FamilyName;	/* in UTF-16! */
+  unsigned short Padding2;	/* = 0 */
+  unsigned short StyleNameSize;
+  unsigned char *StyleName;	/* in UTF-16! */
+  unsigned short Padding3;	/* = 0 */
+  unsigned short VersionNameSize;
+  unsigned char *VersionName;	/* in UTF-16! */
+  unsigned short Padding4;	/* = 0 */
+  unsigned short FullNameSize;
+  unsigned char *FullName;	/* in UTF-16! */
+  unsigned short Padding5;	/* = 0 */
+  unsigned short RootStringSize;
+  unsigned char *RootString;	/* in UTF-16! */
+  unsigned long RootStringCheckSum;
+  unsigned long EUDCCodePage;
+  unsigned short Padding6;	/* = 0 */
+  unsigned short SignatureSize;
+  unsigned char *Signature;
+  unsigned long EUDCFlags;
+  unsigned long EUDCFontSize;
+  unsigned char *EUDCFontData;
+  const unsigned char *FontData; /* Not owned by the header */
+} EOT_header;
+
+/* eot_strerror -- return a message describing a status */
+extern const char *eot_strerror(eot_status status);
+
+/* eot_init_header -- fill an EOT header with consistent, empty values */
+extern void eot_init_header(EOT_header *h);
+
+/* eot_free_header -- free the strings allocated by the functions below */
+extern void eot_free_header(EOT_header *h);
+
+/* eot_read_font -- fill an EOT header with data from an OpenType font
+ *
+ * FontData is set to point to font, which must stay valid as long as
+ * the header is used.
+ */
+extern eot_status eot_read_font(EOT_header *h, const unsigned char *font,
+				size_t size);
+
+/* eot_decode_woff -- make an OpenType font of a WOFF or WOFF 2.0 file
+ *
+ * *sfnt is set to the allocated font, which the caller must free, and
+ * *len to its size. A WOFF 2.0 collection gives a TrueType Collection.
+ * Returns EOT_ERR_SFNT if font is neither WOFF nor WOFF 2.0.
+ */
+extern eot_status eot_decode_woff(const unsigned char *font, size_t size,
+				  unsigned char **sfnt, size_t *len);
+
+/* eot_count_faces -- the number of fonts in a TrueType Collection
+ *
+ * Returns EOT_ERR_SFNT if font is not a collection.
+ */
+extern eot_status eot_count_faces(const unsigned char *font, size_t size,
+				  unsigned long *n);
+
+/* eot_extract_face -- make a standalone font of a font in a collection
+ *
+ * *face is set to the allocated font, which the caller must free, and
+ * *len to its size. The font at index 0 is the first.
+ */
+extern eot_status eot_extract_face(const unsigned char *font, size_t size,
+				   unsigned long index, unsigned char **face,
+				   size_t *len);
+
+/* eot_check_embedding -- check that the font's fsType allows an EOT */
+extern eot_status eot_check_embedding(const EOT_header *h);
+
+/* eot_add_rootstring -- add a URL (in UTF-8) to the EOT header */
+extern eot_status eot_add_rootstring(EOT_header *h, const char *url);
+
+/* eot_add_rootstrings -- add n URLs (in UTF-8) to the EOT header
+ *
+ * Like calling eot_add_rootstring() for each URL, but the RootString
+ * grows only once. RootStringCheckSum is updated from its current
+ * value, rather than recomputed. If the URLs are not valid UTF-8 or
+ * would make the RootString larger than 65535 bytes, nothing is added.
+ */
+extern eot_status eot_add_rootstrings(EOT_header *h, const char *const urls[],
+				      int n);
+
+/* eot_subset_font_data -- reduce FontData to the glyphs for some characters
+ *
+ * Sets FontData to a copy of the font reduced to the glyphs needed
+ * for the characters in the ranges, adjusts FontDataSize and EOTSize
+ * and sets TTEMBED_SUBSET in Flags. *data is set to the allocated
+ * copy, which the caller must free after the header is no longer used.
+ */
+extern eot_status eot_subset_font_data(EOT_header *h,
+				       const eot_unicode_range ranges[],
+				       size_t nranges, unsigned char **data);
+
+/* eot_verify_font -- check the checksums of an OpenType font
+ *
+ * Checks that every table lies within the font and has the checksum
+ * that the table directory says, and that the font as a whole sums to
+ * 0xB1B0AFBA, as head.checkSumAdjustment intends.
+ */
+extern eot_status eot_verify_font(const unsigned char *font, size_t size);
+
+/* eot_fix_checksums -- recompute the checksums of FontData
+ *
+ * Like eot_subset_font_data(), but sets FontData to a copy of the
+ * font with correct table checksums and checkSumAdjustment, and
+ * updates CheckSumAdjustment in the header. The tables themselves are
+ * not moved.
+ */
+extern eot_status eot_fix_checksums(EOT_header *h, unsigned char **data);
+
+/* eot_decompress_font -- decompress MicroType Express font data
+ *
+ * On success, *font is set to the allocated font, which the caller
+ * must free, and *len to its size.
+ */
+extern eot_status eot_decompress_font(const unsigned char *data, size_t size,
+				      unsigned char **font, size_t *len);
+
+/* eot_xor -- obfuscate or deobfuscate font data with EOT_XOR_KEY
+ *
+ * dst may be the same as src. Callers that copy font data can apply
+ * it to one buffer-full at a time.
+ */
+extern void eot_xor(unsigned char *dst, const unsigned char *src, size_t len);
+
+/* eot_header_size -- the number of bytes eot_write_header will write */
+extern size_t eot_header_size(const EOT_header *h);
+
+/* eot_write_header -- serialize the header (without FontData) into buf
+ *
+ * On success, or if the buffer is too small (EOT_ERR_BUFFER), *len is
+ * set to the size of the header.
+ */
+extern eot_status eot_write_header(const EOT_header *h, unsigned char *buf,
+				   size_t size, size_t *len);
+
+/* eot_write_template -- serialize the header without URLs, as a template
+ *
+ * Like eot_write_header(), but the RootString is left out and the
+ * header is preceded by EOT_TEMPLATE_PREFIX bytes. The font data must
+ * be appended, as for an EOT file. Version 1.0 has no RootString and
+ * cannot be made into a template.
+ */
+extern eot_status eot_write_template(const EOT_header *h, unsigned char *buf,
+				     size_t size, size_t *len);
+
+/* eot_read_template -- check a template in memory and find its parts
+ *
+ * t->eot points into tpl, which must stay valid as long as t is used.
+ */
+extern eot_status eot_read_template(eot_template *t, const unsigned char *tpl,
+				    size_t size);
+
+/* eot_template_header -- make an EOT header from a template and URLs
+ *
+ * Inserts the RootString for the URLs into the template's header and
+ * updates RootStringCheckSum and EOTSize. *header is set to the
+ * allocated header, of *len bytes, which the caller must free. The
+ * EOT file is the header followed by the t->size - t->fontdata bytes
+ * at t->eot + t->fontdata.
+ */
+extern eot_status eot_template_header(const eot_template *t,
+				      const char *const urls[], int n,
+				      unsigned char **header, size_t *len);
+
+/* eot_read_header -- parse the header of an EOT file in memory
+ *
+ * *len is set to the size of the header. FontData points into eot,
+ * or is NULL if the buffer does not hold all of the font data. The
+ * strings are copied and must be freed with eot_free_header(), also
+ * if the function fails.
+ */
+extern eot_status eot_read_header(EOT_header *h, const unsigned char *eot,
+				  size_t size, size_t *len);
+
+/* eot_verify -- check a whole EOT file in memory
+ *
+ * Checks that the header is well-formed, that EOTSize is size, that
+ * FontDataSize is the number of bytes after the header and, for
+ * version 2.2, that RootStringCheckSum is right. Then the font data
+ * is deobfuscated and decompressed as needed and the font is checked
+ * with eot_verify_font(). Unless it was compressed, its
+ * checkSumAdjustment is also compared with the one in the header.
+ * Returns the first problem found.
+ */
+extern eot_status eot_verify(const unsigned char *eot, size_t size);
+
+/* eot_time_phases -- time the phases of libeot's calls in this thread
+ *
+ * From now on, the nanoseconds (by the monotonic clock) spent in each
+ * phase of the calls that the current thread makes are added to *t,
+ * which must stay valid until eot_time_phases(NULL) stops the timing.
+ * A call that another timed call makes, e.g., eot_read_header() from
+ * eot_verify(), counts towards the outer call's phase. The memory
+ * allocations that libeot makes in the thread are counted in t->allocs
+ * (but not those inside zlib or Brotli).
+ */
+extern void eot_time_phases(eot_timings *t);
+
+/* eot_phase_name -- a short name for a phase, such as "names" */
+extern const char *eot_phase_name(eot_phase p);
+
+/* eot_encode_into -- make an EOT file from a font and URLs in buf
+ *
+ * On success, or if the buffer is too small (EOT_ERR_BUFFER), *len is
+ * set to the size of the EOT file.
+ */
+extern eot_status eot_encode_into(const unsigned char *font, size_t size,
+				  const char *const urls[], int nurls,
+				  unsigned char *buf, size_t bufsize,
+				  size_t *len);
+
+/* eot_encode -- make an EOT file from a font and URLs, allocate the result */
+extern eot_status eot_encode(const unsigned char *font, size_t size,
+			     const char *const urls[], int nurls,
+			     unsigned char **eot, size_t *len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EOT_H */
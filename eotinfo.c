@@ -1,8 +1,13 @@
 /* eotinfo -- print some info from an EOT file
  *
- * Displays some of the information in an EOT file in a human-readable way.
+ * Displays some of the information in an EOT file in a human-readable way,
+ * or, with --extract, writes the embedded font to a file. With --scan,
+ * prints the headers of all EOT files in a directory tree as JSON or
+ * CSV, one record per file. With --verify, checks all sizes and
+ * checksums in EOT files, alone or together with --scan. With
+ * --stats=json, reports the time spent in each phase, the I/O and the
+ * allocations, for --scan and --verify as histograms over the files.
  *
- * TODO: add the missing code page names.
  * TODO: properly convert UTF-16LE to current locale instead of to UTF-8.
  *
  * Author: Bert Bos <bert@w3.org>
@@ -12,430 +17,903 @@
  * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
  */
 
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <err.h>
 #include <stdbool.h>
 #include <sysexits.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <errno.h>
+#include <strings.h>
+#include <ctype.h>
+#include <limits.h>
+#include <time.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "eot.h"
+#include "mapfile.h"
+#include "stats.h"
 
-#define TTEMBED_SUBSET				0x00000001
-#define TTEMBED_TTCOMPRESSED			0x00000004
-#define TTEMBED_FAILIFVARIATIONSIMULATED	0x00000010
-#define TTEMBED_EMBEDEUDC			0x00000020
-#define TTEMBED_VALIDATIONTESTS			0x00000040
-#define TTEMBED_WEBOBJECT			0x00000080
-#define TTEMBED_XORENCRYPTDATA			0x10000000
-
-#define FSTYPE_RESTRICTED	0x0002
-#define FSTYPE_PREVIEW		0x0004
-#define FSTYPE_EDITABLE		0x0008
-#define FSTYPE_NOSUBSETTING	0x0100
-#define FSTYPE_BITMAP		0x0200
-
-typedef struct _EOT_Header {
-  unsigned long EOTSize;
-  unsigned long FontDataSize;
-  unsigned long Version;
-  unsigned long Flags;
-  unsigned char FontPANOSE[10];
-  unsigned char Charset;
-  unsigned char Italic;
-  unsigned long Weight;
-  unsigned short fsType;
-  unsigned short MagicNumber;	/* = 0x504C */
-  unsigned long UnicodeRange1;
-  unsigned long UnicodeRange2;
-  unsigned long UnicodeRange3;
-  unsigned long UnicodeRange4;
-  unsigned long CodePageRange1;
-  unsigned long CodePageRange2;
-  unsigned long CheckSumAdjustment;
-  unsigned long Reserved1;	/* = 0 */
-  unsigned long Reserved2;	/* = 0 */
-  unsigned long Reserved3;	/* = 0 */
-  unsigned long Reserved4;	/* = 0 */
-  unsigned short Padding1;	/* = 0 */
-  unsigned short FamilyNameSize;
-  unsigned char *FamilyName;	/* in UTF-16! */
-  unsigned short Padding2;	/* = 0 */
-  unsigned short StyleNameSize;
-  unsigned char *StyleName;	/* in UTF-16! */
-  unsigned short Padding3;	/* = 0 */
-  unsigned short VersionNameSize;
-  unsigned char *VersionName;	/* in UTF-16! */
-  unsigned short Padding4;	/* = 0 */
-  unsigned short FullNameSize;
-  unsigned char *FullName;	/* in UTF-16! */
-  unsigned short Padding5;	/* = 0 */
-  unsigned short RootStringSize;
-  unsigned char *RootString;	/* in UTF-16! */
-  unsigned long RootStringCheckSum;
-  unsigned long EUDCCodePage;
-  unsigned short Padding6;	/* = 0 */
-  unsigned short SignatureSize;
-  unsigned char *Signature;
-  unsigned long EUDCFlags;
-  unsigned long EUDCFontSize;
-  unsigned char *EUDCFontData;
-  unsigned char *FontData;
-} EOT_Header;
-
-
-/* read_ulong -- read a little endian unsigned long */
-static bool read_ulong(FILE *f, unsigned long *x)
+#define SCAN_PREFIX 65536		/* Bytes to read first, for --scan */
+#define SCAN_FLUSH 65536		/* Size of the workers' output texts */
+
+typedef enum {FORMAT_TEXT, FORMAT_JSON, FORMAT_CSV} out_format;
+
+typedef struct {		/* Output being built */
+  char *data;
+  size_t len, alloc;
+} text;
+
+typedef struct out_block {	/* A text ready to be written */
+  struct out_block *next;
+  text t;
+} out_block;
+
+typedef struct path_item {	/* An EOT file found by the walk */
+  struct path_item *next;
+  char path[];
+} path_item;
+
+typedef struct {		/* State of a --scan */
+  const char *dir;		/* The tree to walk */
+  path_item *head, *tail;	/* The files found and not yet taken */
+  bool walked;			/* The walk has ended */
+  out_format format;
+  bool verify;			/* Check the whole files, not just the headers */
+  out_block *ready;		/* Stack of output to write */
+  int running;			/* Workers still running */
+  unsigned long nfailed;	/* Files that were not EOT, atomic */
+  stats_summary *stats;		/* Costs of the files, or NULL */
+  pthread_mutex_t lock;		/* Protects all of the above but nfailed */
+  pthread_cond_t found;		/* Signals a new path or the end of the walk */
+  pthread_cond_t output;	/* Signals new output or a worker's end */
+} scan;
+
+static scan *walking;		/* The scan that add_path() adds to */
+
+
+/* Keywords for the bits of UnicodeRange1-4, NULL for reserved bits */
+static const char *const unicode_ranges[128] = {
+  /* UnicodeRange1, bits 0-31 */
+  "basic-latin", "latin-1-supplement", "latin-extended-a", "latin-extended-b",
+  "ipa-extensions", "spacing-modifiers", "combining-diacritical",
+  "greek-and-coptic", "coptic", "cyrillic", "armenian", "hebrew", "vai",
+  "arabic", "nko", "devanagari", "bengali", "gurmukhi", "gujarati", "oriya",
+  "tamil", "teluga", "kannada", "malayalam", "thai", "lao", "georgian",
+  "balinese", "hangul-jamo", "latin-extended-additional", "greek-extended",
+  "general-punctuation",
+  /* UnicodeRange2, bits 32-63 */
+  "super-and-subscripts", "currency", "combining-diacriticals-for-symbols",
+  "letterlike", "number-forms", "arrows", "mathematical", "technical",
+  "control-pictures", "ocr", "enclosed-alphanumerics", "box-drawing",
+  "block-elements", "geometric-shapes", "misc-symbols", "dingbats",
+  "cjk-symbols-and-punctuation", "hiragana", "katakana", "bopomofo",
+  "hangul-compatibility-jamo", "phags-pa", "enclosed-cjk",
+  "cjk-compatibility", "hangul-syllables", "non-plane-0", "phoenician", "cjk",
+  "private-use-0", "cjk-strokes", "alphabetic-presentation-forms",
+  "arabic-presentation-a",
+  /* UnicodeRange3, bits 64-95 */
+  "combining-half-marks", "vertical-forms", "small-form-variants",
+  "arabic-presentation-b", "halfwidth-andfullwidth-forms", "specials",
+  "tibetan", "syriac", "thaana", "sinhala", "myanmar", "ethiopic", "cherokee",
+  "unified-canadian-aboriginal", "ogham", "runic", "khmer", "mongolian",
+  "braille", "yi", "tagalog-hanunoo-buhid-tagbanwa", "old-italic", "gothic",
+  "deseret", "musical-symbols", "mathematical-alphanumeric-symbols",
+  "private-use-15-16",
+  "variation-selectors", "tags", "limbu", "taile", "new-tai-lue",
+  /* UnicodeRange4, bits 96-127 */
+  "buginese", "glagolitic", "tifinagh", "yijing-hexagram", "syloti-nagri",
+  "linear-b", "ancient-greek-numbers", "ugaritic", "old-persian", "shavian",
+  "osmanya", "cypriot", "kharoshthi", "tai-xuan-jing", "cuneiform",
+  "counting-rod-numerals", "sundanese", "lepcha", "ol-chiki", "saurashtra",
+  "kayah-li", "rejang", "cham", "ancient-symbols", "phaistos-disc",
+  "carian-lycian-lydian", "domino-mahjong", NULL, NULL, NULL, NULL, NULL
+};
+
+/* Keywords for the bits of CodePageRange1-2, NULL for reserved bits */
+static const char *const code_pages[64] = {
+  /* CodePageRange1, bits 0-31 */
+  "cp1252-latin-1", "cp1250-latin-2", "cp1251-cyrillic", "cp1253-greek",
+  "cp1254-turkish", "cp1255-hebrew", "cp1256-arabic", "cp1257-baltic",
+  "cp1258-vietnamese", NULL, NULL, NULL, NULL, NULL, NULL, NULL, "cp874-thai",
+  "cp932-japanese", "cp936-simplified-chinese", "cp949-korean-wansung",
+  "cp950-traditional-chinese", "cp1361-korean-johab", NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, "macintosh", "oem", "symbol",
+  /* CodePageRange2, bits 32-63 */
+  NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+  NULL, NULL, NULL, NULL, "cp869-ibm-greek", "cp866-ms-dos-russian",
+  "cp865-ms-dos-nordic", "cp864-arabic", "cp863-ms-dos-canadian-french",
+  "cp862-hebrew", "cp861-ms-dos-icelandic", "cp860-ms-dos-portuguese",
+  "cp857-ibm-turkish", "cp855-ibm-cyrillic", "cp852-latin-2",
+  "cp775-ms-dos-baltic", "cp737-greek", "cp708-arabic-asmo",
+  "cp850-we-latin-1", "cp437-us"
+};
+
+
+/* text_reserve -- make room for n more bytes in a text */
+static void text_reserve(text *t, size_t n)
 {
-  unsigned char s[4];
+  char *p;
 
-  if (fread(s, 1, 4, f) != 4) return false;
-  *x = (s[3] << 24) + (s[2] << 16) + (s[1] << 8) + s[0];
-  return true;
+  if (t->alloc - t->len >= n) return;
+  t->alloc = t->alloc ? t->alloc : 4096;
+  while (t->alloc - t->len < n) t->alloc *= 2;
+  if (!(p = realloc(t->data, t->alloc))) err(EX_OSERR, NULL);
+  t->data = p;
 }
 
 
-/* read_ushort -- read a little endian unsigned short */
-static bool read_ushort(FILE *f, unsigned short *x)
+/* put_str -- append a string to a text */
+static void put_str(text *t, const char *s)
 {
-  unsigned char s[2];
+  size_t n = strlen(s);
 
-  if (fread(s, 1, 2, f) != 2) return false;
-  *x = (s[1] << 8) + s[0];
-  return true;
+  text_reserve(t, n);
+  memcpy(t->data + t->len, s, n);
+  t->len += n;
 }
 
 
-/* read_EOT_header -- read the header part of an EOT file */
-static bool read_EOT_header(FILE *f, EOT_Header *h)
+/* put_fmt -- append formatted output to a text */
+static void put_fmt(text *t, const char *fmt, ...)
 {
-  if (!read_ulong(f, &(h->EOTSize))) return false;
-  if (!read_ulong(f, &(h->FontDataSize))) return false;
-  if (!read_ulong(f, &(h->Version))) return false;
-  if (!read_ulong(f, &(h->Flags))) return false;
-  if (fread(h->FontPANOSE, 1, 10, f) != 10) return false;
-  if (fread(&(h->Charset), 1, 1, f) != 1) return false;
-  if (fread(&(h->Italic), 1, 1, f) != 1) return false;
-  if (!read_ulong(f, &(h->Weight))) return false;
-  if (!read_ushort(f, &(h->fsType))) return false;
-  if (!read_ushort(f, &(h->MagicNumber))) return false;
-  if (h->MagicNumber != 0x504C) return false;
-  if (!read_ulong(f, &(h->UnicodeRange1))) return false;
-  if (!read_ulong(f, &(h->UnicodeRange2))) return false;
-  if (!read_ulong(f, &(h->UnicodeRange3))) return false;
-  if (!read_ulong(f, &(h->UnicodeRange4))) return false;
-  if (!read_ulong(f, &(h->CodePageRange1))) return false;
-  if (!read_ulong(f, &(h->CodePageRange2))) return false;
-  if (!read_ulong(f, &(h->CheckSumAdjustment))) return false;
-  if (!read_ulong(f, &(h->Reserved1))) return false;
-  if (h->Reserved1 != 0) return false;
-  if (!read_ulong(f, &(h->Reserved2))) return false;
-  if (h->Reserved2 != 0) return false;
-  if (!read_ulong(f, &(h->Reserved3))) return false;
-  if (h->Reserved3 != 0) return false;
-  if (!read_ulong(f, &(h->Reserved4))) return false;
-  if (h->Reserved4 != 0) return false;
-  if (!read_ushort(f, &(h->Padding1))) return false;
-  if (h->Padding1 != 0) return false;
-  if (!read_ushort(f, &(h->FamilyNameSize))) return false;
-  if (!(h->FamilyName = malloc(h->FamilyNameSize))) err(EX_OSERR, NULL);
-  if (fread(h->FamilyName, 1, h->FamilyNameSize, f) != h->FamilyNameSize) return false;
-  if (!read_ushort(f, &(h->Padding2))) return false;
-  if (h->Padding2 != 0) return false;
-  if (!read_ushort(f, &(h->StyleNameSize))) return false;
-  if (!(h->StyleName = malloc(h->StyleNameSize))) err(EX_OSERR, NULL);
-  if (fread(h->StyleName, 1, h->StyleNameSize, f) != h->StyleNameSize) return false;
-  if (!read_ushort(f, &(h->Padding3))) return false;
-  if (h->Padding3 != 0) return false;
-  if (!read_ushort(f, &(h->VersionNameSize))) return false;
-  if (!(h->VersionName = malloc(h->VersionNameSize))) err(EX_OSERR, NULL);
-  if (fread(h->VersionName, 1, h->VersionNameSize, f) != h->VersionNameSize) return false;
-  if (!read_ushort(f, &(h->Padding4))) return false;
-  if (h->Padding4 != 0) return false;
-  if (!read_ushort(f, &(h->FullNameSize))) return false;
-  if (!(h->FullName = malloc(h->FullNameSize))) err(EX_OSERR, NULL);
-  if (fread(h->FullName, 1, h->FullNameSize, f) != h->FullNameSize) return false;
-
-  switch (h->Version) {
-  case 0x0001000:
-    break;
-  case 0x00020001:
-    if (!read_ushort(f, &(h->Padding5))) return false;
-    if (h->Padding5 != 0) return false;
-    if (!read_ushort(f, &(h->RootStringSize))) return false;
-    if (!(h->RootString = malloc(h->RootStringSize))) err(EX_OSERR, NULL);
-    if (fread(h->RootString, 1, h->RootStringSize, f) != h->RootStringSize) return false;
-    break;
-  case 0x00020002:
-    if (!read_ushort(f, &(h->Padding5))) return false;
-    if (h->Padding5 != 0) return false;
-    if (!read_ushort(f, &(h->RootStringSize))) return false;
-    if (!(h->RootString = malloc(h->RootStringSize))) err(EX_OSERR, NULL);
-    if (fread(h->RootString, 1, h->RootStringSize, f) != h->RootStringSize) return false;
-    break;
-    if (!read_ulong(f, &(h->RootStringCheckSum))) return false;
-    if (!read_ulong(f, &(h->EUDCCodePage))) return false;
-    if (!read_ushort(f, &(h->Padding6))) return false;
-    if (h->Padding6 != 0) return false;
-    if (!read_ushort(f, &(h->SignatureSize))) return false;
-    if (!(h->Signature = malloc(h->SignatureSize))) err(EX_OSERR, NULL);
-    if (fread(h->Signature, 1, h->SignatureSize, f) != h->SignatureSize) return false;
-    if (!read_ulong(f, &(h->EUDCFlags))) return false;
-    if (!read_ulong(f, &(h->EUDCFontSize))) return false;
-    if (!(h->EUDCFontData = malloc(h->EUDCFontSize))) err(EX_OSERR, NULL);
-    if (fread(h->EUDCFontData, 1, h->EUDCFontSize, f) != h->EUDCFontSize) return false;
-    break;
-  default:
-    return false;
+  va_list ap;
+  int n;
+
+  va_start(ap, fmt);
+  n = vsnprintf(NULL, 0, fmt, ap);
+  va_end(ap);
+  text_reserve(t, n + 1);
+  va_start(ap, fmt);
+  (void) vsnprintf(t->data + t->len, n + 1, fmt, ap);
+  va_end(ap);
+  t->len += n;
+}
+
+
+/* put_num -- append a number and a separator to a text */
+static void put_num(text *t, unsigned long n, const char *sep)
+{
+  char s[32];
+
+  (void) snprintf(s, sizeof(s), "%lu%s", n, sep);
+  put_str(t, s);
+}
+
+
+/* put_char -- append a character to a text, escaped for the format */
+static void put_char(text *t, long c, out_format format)
+{
+  char *p;
+
+  text_reserve(t, 8);
+  p = t->data + t->len;
+  if (format == FORMAT_JSON && (c == '"' || c == '\\')) {
+    *p++ = '\\'; *p++ = c;
+  } else if (format == FORMAT_JSON && c < 0x20) {
+    p += sprintf(p, "\\u%04lx", c);
+  } else if (format == FORMAT_CSV && c == '"') {
+    *p++ = '"'; *p++ = '"';
+  } else if (c <= 0x7F) {			/* UTF-8 from here on */
+    *p++ = c;
+  } else if (c <= 0x07FF) {
+    *p++ = 0xC0 | (c >> 6);
+    *p++ = 0x80 | (c & 0x3F);
+  } else if (c <= 0xFFFF) {
+    *p++ = 0xE0 | (c >> 12);
+    *p++ = 0x80 | ((c >> 6) & 0x3F);
+    *p++ = 0x80 | (c & 0x3F);
+  } else {
+    *p++ = 0xF0 | (c >> 18);
+    *p++ = 0x80 | ((c >> 12) & 0x3F);
+    *p++ = 0x80 | ((c >> 6) & 0x3F);
+    *p++ = 0x80 | (c & 0x3F);
   }
-  return true;
+  t->len = p - t->data;
+}
+
+
+/* get_utf8 -- decode a UTF-8 character, -1 if *s does not start one */
+static long get_utf8(const unsigned char *s, int *len)
+{
+  static const long min[] = {0, 0, 0x80, 0x800, 0x10000};
+  long c;
+  int i;
+
+  if (*s < 0x80) {*len = 1; return *s;}
+  else if (*s >= 0xC2 && *s <= 0xDF) {*len = 2; c = *s & 0x1F;}
+  else if (*s >= 0xE0 && *s <= 0xEF) {*len = 3; c = *s & 0x0F;}
+  else if (*s >= 0xF0 && *s <= 0xF4) {*len = 4; c = *s & 0x07;}
+  else return -1;
+  for (i = 1; i < *len; i++) {
+    if ((s[i] & 0xC0) != 0x80) return -1;
+    c = (c << 6) | (s[i] & 0x3F);
+  }
+  if (c < min[*len] || (c >= 0xD800 && c <= 0xDFFF) || c > 0x10FFFF)
+    return -1;
+  return c;
+}
+
+
+/* put_bytes -- append a string of bytes, such as a path, escaped
+ *
+ * The bytes are copied as they are for FORMAT_TEXT. JSON and CSV are
+ * UTF-8, so there bytes that are not part of a valid UTF-8 character
+ * become U+FFFD.
+ */
+static void put_bytes(text *t, const char *s, out_format format)
+{
+  const unsigned char *p = (const unsigned char *)s;
+  long c;
+  int n;
+
+  while (*p)
+    if (format == FORMAT_TEXT && *p >= 0x80) {
+      text_reserve(t, 1);
+      t->data[t->len++] = *p++;
+    } else if ((c = get_utf8(p, &n)) < 0) {
+      put_char(t, 0xFFFD, format);
+      p++;
+    } else {
+      put_char(t, c, format);
+      p += n;
+    }
 }
 
 
-/* print_unicode_range -- print keywords for all bits in the Unicode range */
-static void print_unicode_range(EOT_Header h)
+/* put_utf16 -- append a UTF-16LE string and a separator to a text
+ *
+ * The string is quoted, unless the format is FORMAT_TEXT. NUL
+ * characters, which separate the URLs in a RootString, become spaces.
+ * Unpaired surrogates become U+FFFD.
+ */
+static void put_utf16(text *t, const unsigned char *s, size_t n,
+		      out_format format, const char *sep)
 {
-  if (h.UnicodeRange1 & 0x00000001) printf(" basic-latin");
-  if (h.UnicodeRange1 & 0x00000002) printf(" latin-1-supplement");
-  if (h.UnicodeRange1 & 0x00000004) printf(" latin-extended-a");
-  if (h.UnicodeRange1 & 0x00000008) printf(" latin-extended-b");
-  if (h.UnicodeRange1 & 0x00000010) printf(" ipa-extensions");
-  if (h.UnicodeRange1 & 0x00000020) printf(" spacing-modifiers");
-  if (h.UnicodeRange1 & 0x00000040) printf(" combining-diacritical");
-  if (h.UnicodeRange1 & 0x00000080) printf(" greek-and-coptic");
-  if (h.UnicodeRange1 & 0x00000100) printf(" coptic");
-  if (h.UnicodeRange1 & 0x00000200) printf(" cyrillic");
-  if (h.UnicodeRange1 & 0x00000400) printf(" armenian");
-  if (h.UnicodeRange1 & 0x00000800) printf(" hebrew");
-  if (h.UnicodeRange1 & 0x00001000) printf(" vai");
-  if (h.UnicodeRange1 & 0x00002000) printf(" arabic");
-  if (h.UnicodeRange1 & 0x00004000) printf(" nko");
-  if (h.UnicodeRange1 & 0x00008000) printf(" devanagari");
-  if (h.UnicodeRange1 & 0x00010000) printf(" bengali");
-  if (h.UnicodeRange1 & 0x00020000) printf(" gurmukhi");
-  if (h.UnicodeRange1 & 0x00040000) printf(" gujarati");
-  if (h.UnicodeRange1 & 0x00080000) printf(" oriya");
-  if (h.UnicodeRange1 & 0x00100000) printf(" tamil");
-  if (h.UnicodeRange1 & 0x00200000) printf(" teluga");
-  if (h.UnicodeRange1 & 0x00400000) printf(" kannada");
-  if (h.UnicodeRange1 & 0x00800000) printf(" malayalam");
-  if (h.UnicodeRange1 & 0x01000000) printf(" thai");
-  if (h.UnicodeRange1 & 0x02000000) printf(" lao");
-  if (h.UnicodeRange1 & 0x04000000) printf(" georgian");
-  if (h.UnicodeRange1 & 0x08000000) printf(" balinese");
-  if (h.UnicodeRange1 & 0x10000000) printf(" hangul-jamo");
-  if (h.UnicodeRange1 & 0x20000000) printf(" latin-extended-additional");
-  if (h.UnicodeRange1 & 0x40000000) printf(" greek-extended");
-  if (h.UnicodeRange1 & 0x80000000) printf(" general-punctuation");
-  if (h.UnicodeRange2 & 0x00000001) printf(" super-and-subscripts");
-  if (h.UnicodeRange2 & 0x00000002) printf(" currency");
-  if (h.UnicodeRange2 & 0x00000004) printf(" combining-diacriticals-for-symbols");
-  if (h.UnicodeRange2 & 0x00000008) printf(" letterlike");
-  if (h.UnicodeRange2 & 0x00000010) printf(" number-forms");
-  if (h.UnicodeRange2 & 0x00000020) printf(" arrows");
-  if (h.UnicodeRange2 & 0x00000040) printf(" mathematical");
-  if (h.UnicodeRange2 & 0x00000080) printf(" technical");
-  if (h.UnicodeRange2 & 0x00000100) printf(" control-pictures");
-  if (h.UnicodeRange2 & 0x00000200) printf(" ocr");
-  if (h.UnicodeRange2 & 0x00000400) printf(" enclosed-alphanumerics");
-  if (h.UnicodeRange2 & 0x00000800) printf(" box-drawing");
-  if (h.UnicodeRange2 & 0x00001000) printf(" block-elements");
-  if (h.UnicodeRange2 & 0x00002000) printf(" geometric-shapes");
-  if (h.UnicodeRange2 & 0x00004000) printf(" misc-symbols");
-  if (h.UnicodeRange2 & 0x00008000) printf(" dingbats");
-  if (h.UnicodeRange2 & 0x00010000) printf(" cjk-symbols-and-punctuation");
-  if (h.UnicodeRange2 & 0x00020000) printf(" hiragana");
-  if (h.UnicodeRange2 & 0x00040000) printf(" katakana");
-  if (h.UnicodeRange2 & 0x00080000) printf(" bopomofo");
-  if (h.UnicodeRange2 & 0x00100000) printf(" hangul-compatibility-jamo");
-  if (h.UnicodeRange2 & 0x00200000) printf(" phags-pa");
-  if (h.UnicodeRange2 & 0x00400000) printf(" enclosed-cjk");
-  if (h.UnicodeRange2 & 0x00800000) printf(" cjk-compatibility");
-  if (h.UnicodeRange2 & 0x01000000) printf(" hangul-syllables");
-  if (h.UnicodeRange2 & 0x02000000) printf(" non-plane-0");
-  if (h.UnicodeRange2 & 0x04000000) printf(" phoenician");
-  if (h.UnicodeRange2 & 0x08000000) printf(" cjk");
-  if (h.UnicodeRange2 & 0x10000000) printf(" private-use-0");
-  if (h.UnicodeRange2 & 0x20000000) printf(" cjk-strokes");
-  if (h.UnicodeRange2 & 0x40000000) printf(" alphabetic-presentation-forms");
-  if (h.UnicodeRange2 & 0x80000000) printf(" arabic-presentation-a");
-  if (h.UnicodeRange3 & 0x00000001) printf(" combining-half-marks");
-  if (h.UnicodeRange3 & 0x00000002) printf(" vertical-forms");
-  if (h.UnicodeRange3 & 0x00000004) printf(" small-form-variants");
-  if (h.UnicodeRange3 & 0x00000008) printf(" arabic-presentation-b");
-  if (h.UnicodeRange3 & 0x00000010) printf(" halfwidth-andfullwidth-forms");
-  if (h.UnicodeRange3 & 0x00000020) printf(" specials");
-  if (h.UnicodeRange3 & 0x00000040) printf(" tibetan");
-  if (h.UnicodeRange3 & 0x00000080) printf(" syriac");
-  if (h.UnicodeRange3 & 0x00000100) printf(" thaana");
-  if (h.UnicodeRange3 & 0x00000200) printf(" sinhala");
-  if (h.UnicodeRange3 & 0x00000400) printf(" myanmar");
-  if (h.UnicodeRange3 & 0x00000800) printf(" ethiopic");
-  if (h.UnicodeRange3 & 0x00001000) printf(" cherokee");
-  if (h.UnicodeRange3 & 0x00002000) printf(" unified-canadian-aboriginal");
-  if (h.UnicodeRange3 & 0x00004000) printf(" ogham");
-  if (h.UnicodeRange3 & 0x00008000) printf(" runic");
-  if (h.UnicodeRange3 & 0x00010000) printf(" khmer");
-  if (h.UnicodeRange3 & 0x00020000) printf(" mongolian");
-  if (h.UnicodeRange3 & 0x00040000) printf(" braille");
-  if (h.UnicodeRange3 & 0x00080000) printf(" yi");
-  if (h.UnicodeRange3 & 0x00100000) printf(" tagalog-hanunoo-buhid-tagbanwa");
-  if (h.UnicodeRange3 & 0x00200000) printf(" old-italic");
-  if (h.UnicodeRange3 & 0x00400000) printf(" gothic");
-  if (h.UnicodeRange3 & 0x00800000) printf(" deseret");
-  if (h.UnicodeRange3 & 0x01000000) printf(" musical-symbols");
-  if (h.UnicodeRange3 & 0x02000000) printf(" mathematical alphanumeric symbols");
-  if (h.UnicodeRange3 & 0x04000000) printf(" private-use-15-16");
-  if (h.UnicodeRange3 & 0x08000000) printf(" variation-selectors");
-  if (h.UnicodeRange3 & 0x10000000) printf(" tags");
-  if (h.UnicodeRange3 & 0x20000000) printf(" limbu");
-  if (h.UnicodeRange3 & 0x40000000) printf(" taile");
-  if (h.UnicodeRange3 & 0x80000000) printf(" new-tai-lue");
-  if (h.UnicodeRange4 & 0x00000001) printf(" buginese");
-  if (h.UnicodeRange4 & 0x00000002) printf(" glagolitic");
-  if (h.UnicodeRange4 & 0x00000004) printf(" tifinagh");
-  if (h.UnicodeRange4 & 0x00000008) printf(" yijing-hexagram");
-  if (h.UnicodeRange4 & 0x00000010) printf(" syloti-nagri");
-  if (h.UnicodeRange4 & 0x00000020) printf(" linear-b");
-  if (h.UnicodeRange4 & 0x00000040) printf(" ancient-greek-numbers");
-  if (h.UnicodeRange4 & 0x00000080) printf(" ugaritic");
-  if (h.UnicodeRange4 & 0x00000100) printf(" old-persian");
-  if (h.UnicodeRange4 & 0x00000200) printf(" shavian");
-  if (h.UnicodeRange4 & 0x00000400) printf(" osmanya");
-  if (h.UnicodeRange4 & 0x00000800) printf(" cypriot");
-  if (h.UnicodeRange4 & 0x00001000) printf(" kharoshthi");
-  if (h.UnicodeRange4 & 0x00002000) printf(" tai-xuan-jing");
-  if (h.UnicodeRange4 & 0x00004000) printf(" cuneiform");
-  if (h.UnicodeRange4 & 0x00008000) printf(" counting-rod-numerals");
-  if (h.UnicodeRange4 & 0x00010000) printf(" sundanese");
-  if (h.UnicodeRange4 & 0x00020000) printf(" lepcha");
-  if (h.UnicodeRange4 & 0x00040000) printf(" ol-chiki");
-  if (h.UnicodeRange4 & 0x00080000) printf(" saurashtra");
-  if (h.UnicodeRange4 & 0x00100000) printf(" kayah-li");
-  if (h.UnicodeRange4 & 0x00200000) printf(" rejang");
-  if (h.UnicodeRange4 & 0x00400000) printf(" cham");
-  if (h.UnicodeRange4 & 0x00800000) printf(" ancient-symbols");
-  if (h.UnicodeRange4 & 0x01000000) printf(" phaistos-disc");
-  if (h.UnicodeRange4 & 0x02000000) printf(" carian-lycian-lydian");
-  if (h.UnicodeRange4 & 0x04000000) printf(" domino-mahjong");
+  long c, d;
+  size_t i;
+
+  if (format != FORMAT_TEXT) put_str(t, "\"");
+  for (i = 0; i + 1 < n; i += 2) {
+    c = s[i] | (s[i+1] << 8);
+    if (c >= 0xD800 && c <= 0xDBFF && i + 3 < n &&
+	(d = s[i+2] | (s[i+3] << 8)) >= 0xDC00 && d <= 0xDFFF) {
+      c = 0x10000 + ((c - 0xD800) << 10) + (d - 0xDC00);
+      i += 2;
+    } else if (c >= 0xD800 && c <= 0xDFFF) {
+      c = 0xFFFD;
+    }
+    put_char(t, c ? c : ' ', format);
+  }
+  if (format != FORMAT_TEXT) put_str(t, "\"");
+  put_str(t, sep);
 }
 
 
-/* print_code_page_range -- print codepages supported by the font */
-static void print_code_page_range(EOT_Header h)
+/* put_bit_names -- append the keywords for the bits that are set in words
+ *
+ * words holds n 32-bit words, bit 0 of words[0] first. Only the set
+ * bits are visited, by counting trailing zeros. In FORMAT_TEXT, each
+ * keyword is preceded by a space, in FORMAT_JSON, the keywords are
+ * quoted and separated by commas.
+ */
+static void put_bit_names(text *t, const unsigned long words[], int n,
+			  const char *const names[], out_format format)
 {
-  printf(" to do...");
+  const char *name;
+  bool first = true;
+  unsigned long w;
+  int i;
+
+  for (i = 0; i < n; i++)
+    for (w = words[i] & 0xFFFFFFFF; w; w &= w - 1) {
+      if (!(name = names[32 * i + __builtin_ctzl(w)])) continue;
+      if (format == FORMAT_JSON) put_str(t, first ? "\"" : ",\"");
+      else put_str(t, " ");
+      put_str(t, name);
+      if (format == FORMAT_JSON) put_str(t, "\"");
+      first = false;
+    }
 }
 
 
-/* putUTF8 -- write a character to stdout in UTF8 encoding */
-static void putUTF8(long c)
+/* put_record -- append the header of one EOT file, or an error, to a text */
+static void put_record(text *t, out_format format, const char *path,
+		       const EOT_header *h, const char *error)
 {
-  if (c <= 0x7F) {				/* Leave ASCII encoded */
-    putchar(c);
-  } else if (c <= 0x07FF) {			/* 110xxxxx 10xxxxxx */
-    putchar(0xC0 | (c >> 6));
-    putchar(0x80 | (c & 0x3F));
-  } else if (c <= 0xFFFF) {			/* 1110xxxx + 2 */
-    putchar(0xE0 | (c >> 12));
-    putchar(0x80 | ((c >> 6) & 0x3F));
-    putchar(0x80 | (c & 0x3F));
-  } else if (c <= 0x1FFFFF) {			/* 11110xxx + 3 */
-    putchar(0xF0 | (c >> 18));
-    putchar(0x80 | ((c >> 12) & 0x3F));
-    putchar(0x80 | ((c >> 6) & 0x3F));
-    putchar(0x80 | (c & 0x3F));
-  } else if (c <= 0x3FFFFFF) {			/* 111110xx + 4 */
-    putchar(0xF8 | (c >> 24));
-    putchar(0x80 | ((c >> 18) & 0x3F));
-    putchar(0x80 | ((c >> 12) & 0x3F));
-    putchar(0x80 | ((c >> 6) & 0x3F));
-    putchar(0x80 | (c & 0x3F));
-  } else if (c <= 0x7FFFFFFF) {			/* 1111110x + 5 */
-    putchar(0xFC | (c >> 30));
-    putchar(0x80 | ((c >> 24) & 0x3F));
-    putchar(0x80 | ((c >> 18) & 0x3F));
-    putchar(0x80 | ((c >> 12) & 0x3F));
-    putchar(0x80 | ((c >> 6) & 0x3F));
-    putchar(0x80 | (c & 0x3F));
-  } else {					/* Not a valid character... */
-    printf("<%ld>", c);
-  } 
+  const unsigned long unicode[] = {h ? h->UnicodeRange1 : 0,
+				   h ? h->UnicodeRange2 : 0,
+				   h ? h->UnicodeRange3 : 0,
+				   h ? h->UnicodeRange4 : 0};
+  const unsigned long codepages[] = {h ? h->CodePageRange1 : 0,
+				     h ? h->CodePageRange2 : 0};
+
+  if (format == FORMAT_JSON) put_str(t, "{\"path\":\"");
+  else put_str(t, "\"");
+  put_bytes(t, path, format);
+  if (format == FORMAT_JSON) {
+    put_str(t, "\",");
+    if (error) {
+      put_str(t, "\"error\":\"");
+      put_bytes(t, error, format);
+      put_str(t, "\"}\n");
+      return;
+    }
+    put_str(t, "\"EOTSize\":"); put_num(t, h->EOTSize, ",");
+    put_str(t, "\"FontDataSize\":"); put_num(t, h->FontDataSize, ",");
+    put_str(t, "\"Version\":"); put_num(t, h->Version, ",");
+    put_str(t, "\"Flags\":"); put_num(t, h->Flags, ",");
+    put_str(t, "\"Charset\":"); put_num(t, h->Charset, ",");
+    put_str(t, "\"Italic\":"); put_num(t, h->Italic, ",");
+    put_str(t, "\"Weight\":"); put_num(t, h->Weight, ",");
+    put_str(t, "\"fsType\":"); put_num(t, h->fsType, ",");
+    put_str(t, "\"UnicodeRange\":["); put_num(t, h->UnicodeRange1, ",");
+    put_num(t, h->UnicodeRange2, ","); put_num(t, h->UnicodeRange3, ",");
+    put_num(t, h->UnicodeRange4, "],");
+    put_str(t, "\"CodePageRange\":["); put_num(t, h->CodePageRange1, ",");
+    put_num(t, h->CodePageRange2, "],");
+    put_str(t, "\"UnicodeRangeNames\":[");
+    put_bit_names(t, unicode, 4, unicode_ranges, format);
+    put_str(t, "],\"CodePageRangeNames\":[");
+    put_bit_names(t, codepages, 2, code_pages, format);
+    put_str(t, "],");
+    put_str(t, "\"CheckSumAdjustment\":");
+    put_num(t, h->CheckSumAdjustment, ",");
+    put_str(t, "\"FamilyName\":");
+    put_utf16(t, h->FamilyName, h->FamilyNameSize, format, ",");
+    put_str(t, "\"StyleName\":");
+    put_utf16(t, h->StyleName, h->StyleNameSize, format, ",");
+    put_str(t, "\"VersionName\":");
+    put_utf16(t, h->VersionName, h->VersionNameSize, format, ",");
+    put_str(t, "\"FullName\":");
+    put_utf16(t, h->FullName, h->FullNameSize, format, ",");
+    put_str(t, "\"RootString\":");
+    put_utf16(t, h->RootString, h->RootStringSize, format, "}\n");
+  } else {
+    put_str(t, "\",\"");
+    if (error) {
+      put_bytes(t, error, format);
+      put_str(t, "\",,,,,,,,,,,,,,,,,,,,\r\n");
+      return;
+    }
+    put_str(t, "\",");
+    put_num(t, h->EOTSize, ",");
+    put_num(t, h->FontDataSize, ",");
+    put_num(t, h->Version, ",");
+    put_num(t, h->Flags, ",");
+    put_num(t, h->Charset, ",");
+    put_num(t, h->Italic, ",");
+    put_num(t, h->Weight, ",");
+    put_num(t, h->fsType, ",");
+    put_num(t, h->UnicodeRange1, ",");
+    put_num(t, h->UnicodeRange2, ",");
+    put_num(t, h->UnicodeRange3, ",");
+    put_num(t, h->UnicodeRange4, ",");
+    put_num(t, h->CodePageRange1, ",");
+    put_num(t, h->CodePageRange2, ",");
+    put_num(t, h->CheckSumAdjustment, ",");
+    put_utf16(t, h->FamilyName, h->FamilyNameSize, format, ",");
+    put_utf16(t, h->StyleName, h->StyleNameSize, format, ",");
+    put_utf16(t, h->VersionName, h->VersionNameSize, format, ",");
+    put_utf16(t, h->FullName, h->FullNameSize, format, ",");
+    put_utf16(t, h->RootString, h->RootStringSize, format, "\r\n");
+  }
 }
 
 
 /* dump_header -- print out the header in a readable way */
-static void dump_header(EOT_Header h)
+static void dump_header(EOT_header h)
 {
-  unsigned short i;
-  long c;
+  const unsigned long unicode[] = {h.UnicodeRange1, h.UnicodeRange2,
+				   h.UnicodeRange3, h.UnicodeRange4};
+  const unsigned long codepages[] = {h.CodePageRange1, h.CodePageRange2};
+  unsigned long long start = stats_clock();
+  text t = {NULL, 0, 0};
+
+  put_fmt(&t, "EOTSize:            %ld\n", h.EOTSize);
+  put_fmt(&t, "FontDataSize:       %ld\n", h.FontDataSize);
+  put_fmt(&t, "Version:            0x%08lX\n", h.Version);
+  put_fmt(&t, "Flags:              %s %s %s %s\n",
+	  (h.Flags & TTEMBED_SUBSET) ? "subsetted" : "not-subsetted",
+	  (h.Flags & TTEMBED_TTCOMPRESSED) ? "compressed" : "not-compressed",
+	  (h.Flags & TTEMBED_EMBEDEUDC) ? "EUDC": "no-EUDC",
+	  (h.Flags & TTEMBED_XORENCRYPTDATA) ? "xor" : "no-xor");
+  put_fmt(&t, "PANOSE:             %u %u %u %u %u %u %u %u %u %u\n",
+	  h.FontPANOSE[0], h.FontPANOSE[1], h.FontPANOSE[2], h.FontPANOSE[3],
+	  h.FontPANOSE[4], h.FontPANOSE[5], h.FontPANOSE[6], h.FontPANOSE[7],
+	  h.FontPANOSE[8], h.FontPANOSE[9]);
+  put_fmt(&t, "Charset:            %u\n", h.Charset);
+  put_fmt(&t, "Italic:             %s\n", h.Italic ? "yes" : "no");
+  put_fmt(&t, "Weight:             %lu\n", h.Weight);
+  put_str(&t, "fsType:            ");
+  if (h.fsType == 0) put_str(&t, " installable");
+  else if (h.fsType & FSTYPE_EDITABLE) put_str(&t, " editable");
+  else if (h.fsType & FSTYPE_PREVIEW) put_str(&t, " preview-and-print");
+  else if (h.fsType & FSTYPE_RESTRICTED) put_str(&t, " restricted");
+  if (h.fsType & FSTYPE_NOSUBSETTING) put_str(&t, " no-subsetting");
+  if (h.fsType & FSTYPE_BITMAP) put_str(&t, " bitmap-only");
+  put_str(&t, "\nUnicodeRange:      ");
+  put_bit_names(&t, unicode, 4, unicode_ranges, FORMAT_TEXT);
+  put_str(&t, "\nCodePageRange:     ");
+  put_bit_names(&t, codepages, 2, code_pages, FORMAT_TEXT);
+  put_fmt(&t, "\nCheckSumAdjustment: %lu\n", h.CheckSumAdjustment);
+  put_str(&t, "FamilyName:         ");
+  put_utf16(&t, h.FamilyName, h.FamilyNameSize, FORMAT_TEXT, "\n");
+  put_str(&t, "StyleName:          ");
+  put_utf16(&t, h.StyleName, h.StyleNameSize, FORMAT_TEXT, "\n");
+  put_str(&t, "VersionName:        ");
+  put_utf16(&t, h.VersionName, h.VersionNameSize, FORMAT_TEXT, "\n");
+  put_str(&t, "FullName:           ");
+  put_utf16(&t, h.FullName, h.FullNameSize, FORMAT_TEXT, "\n");
+  put_str(&t, "RootString:         ");
+  put_utf16(&t, h.RootString, h.RootStringSize, FORMAT_TEXT, "\n");
+  if (!write_all(STDOUT_FILENO, (unsigned char*)t.data, t.len))
+    err(EX_IOERR, NULL);
+  free(t.data);
+  stats_phase(STATS_OUTPUT, start);
+}
+
+
+/* extract_font -- write the font of an EOT file to path ("-" is stdout)
+ *
+ * Obfuscated font data is deobfuscated and compressed font data is
+ * decompressed. Other font data is copied straight from the EOT file.
+ * len is the size of the EOT header.
+ */
+static void extract_font(const char *path, mapped_file f, EOT_header h,
+			 size_t len)
+{
+  unsigned char *font = NULL, *plain = NULL;
+  const unsigned char *data = h.FontData;
+  unsigned long long t;
+  size_t size;
+  eot_status e;
+  int out;
+
+  if (!h.FontData) errx(EX_DATAERR, "%s", eot_strerror(EOT_ERR_TRUNCATED));
+  if ((h.Flags & TTEMBED_XORENCRYPTDATA) &&
+      (h.Flags & TTEMBED_TTCOMPRESSED)) {
+    /* The compressed data was obfuscated, undo that first */
+    if (!(plain = malloc(h.FontDataSize))) err(EX_OSERR, NULL);
+    eot_xor(plain, h.FontData, h.FontDataSize);
+    data = plain;
+  }
+  if ((h.Flags & TTEMBED_TTCOMPRESSED) &&
+      (e = eot_decompress_font(data, h.FontDataSize, &font, &size))
+      != EOT_OK) errx(EX_DATAERR, "%s", eot_strerror(e));
+
+  t = stats_clock();
+  if (strcmp(path, "-") == 0) out = STDOUT_FILENO;
+  else if ((out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+    err(EX_CANTCREAT, "%s", path);
+  if (font ? !write_all(out, font, size) :
+      (h.Flags & TTEMBED_XORENCRYPTDATA) ?
+      !write_xor(out, h.FontData, h.FontDataSize) :
+      !copy_range(f, len, h.FontDataSize, out))
+    err(EX_IOERR, "%s", path);
+  if (out != STDOUT_FILENO && close(out) != 0) err(EX_IOERR, "%s", path);
+  if (out != STDOUT_FILENO) io_count.syscalls += 2;
+  stats_phase(STATS_COPY, t);
+  free(plain);
+  free(font);
+}
+
+
+/* scan_file -- read the header of one EOT file and append it to a text
+ *
+ * Usually the first SCAN_PREFIX bytes hold the whole header, so only
+ * those are read. If they don't, or if verify is true, the whole file
+ * is mapped instead. buf must have room for SCAN_PREFIX bytes.
+ */
+static bool scan_file(const char *path, out_format format, bool verify,
+		      unsigned char *buf, text *t)
+{
+  unsigned long long start = stats_clock();
+  EOT_header h;
+  mapped_file f;
+  struct stat st;
+  eot_status e;
+  ssize_t n;
+  size_t len;
+  int fd;
+
+  io_count.syscalls += 2;
+  if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1) {
+    put_record(t, format, path, NULL, strerror(errno));
+    if (fd != -1) (void) close(fd);
+    return false;
+  }
+  if (verify) {
+    if (!map_fd(fd, &f)) {
+      put_record(t, format, path, NULL, strerror(errno));
+      (void) close(fd);
+      return false;
+    }
+    stats_phase(STATS_MAP, start);
+    if ((e = eot_read_header(&h, f.data, f.size, &len)) == EOT_OK)
+      e = eot_verify(f.data, f.size);
+    (void) unmap_file(&f);
+    start = stats_clock();
+    put_record(t, format, path, &h, e == EOT_OK ? NULL : eot_strerror(e));
+    stats_phase(STATS_OUTPUT, start);
+    eot_free_header(&h);
+    return e == EOT_OK;
+  }
+  while ((n = pread(fd, buf, SCAN_PREFIX, 0)) == -1 && errno == EINTR);
+  io_count.syscalls++;
+  if (n == -1) {
+    put_record(t, format, path, NULL, strerror(errno));
+    (void) close(fd);
+    return false;
+  }
+  io_count.read += n;
+  stats_phase(STATS_MAP, start);
+  e = eot_read_header(&h, buf, n, &len);
+  if (e != EOT_OK && e != EOT_ERR_NOMEM && st.st_size > n) {
+    eot_free_header(&h);
+    start = stats_clock();
+    if (!map_fd(fd, &f)) {
+      put_record(t, format, path, NULL, strerror(errno));
+      (void) close(fd);
+      return false;
+    }
+    stats_phase(STATS_MAP, start);
+    e = eot_read_header(&h, f.data, f.size, &len);
+    (void) unmap_file(&f);
+  } else {
+    (void) close(fd);
+    io_count.syscalls++;
+  }
+  start = stats_clock();
+  put_record(t, format, path, &h, e == EOT_OK ? NULL : eot_strerror(e));
+  stats_phase(STATS_OUTPUT, start);
+  eot_free_header(&h);
+  return e == EOT_OK;
+}
+
+
+/* add_path -- callback for nftw, hand the EOT files of the tree to workers */
+static int add_path(const char *path, const struct stat *st, int type,
+		    struct FTW *ftw)
+{
+  size_t n = strlen(path);
+  path_item *p;
+
+  (void) st;
+  (void) ftw;
+  if (type != FTW_F || n < 4 || strcasecmp(path + n - 4, ".eot") != 0)
+    return 0;
+  if (!(p = malloc(sizeof(*p) + n + 1))) err(EX_OSERR, NULL);
+  p->next = NULL;
+  memcpy(p->path, path, n + 1);
+  pthread_mutex_lock(&walking->lock);
+  if (walking->tail) walking->tail->next = p;
+  else walking->head = p;
+  walking->tail = p;
+  pthread_cond_signal(&walking->found);
+  pthread_mutex_unlock(&walking->lock);
+  return 0;
+}
+
+
+/* walk_tree -- thread that walks the tree and queues the EOT files */
+static void *walk_tree(void *arg)
+{
+  scan *s = arg;
+
+  walking = s;
+  if (nftw(s->dir, add_path, 32, FTW_PHYS) != 0) err(EX_NOINPUT, "%s", s->dir);
+  pthread_mutex_lock(&s->lock);
+  s->walked = true;
+  pthread_cond_broadcast(&s->found);
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
+
+/* next_path -- wait for the next file to scan, NULL after the last */
+static path_item *next_path(scan *s)
+{
+  path_item *p;
+
+  pthread_mutex_lock(&s->lock);
+  while (!s->head && !s->walked) pthread_cond_wait(&s->found, &s->lock);
+  if ((p = s->head) && !(s->head = p->next)) s->tail = NULL;
+  pthread_mutex_unlock(&s->lock);
+  return p;
+}
+
+
+/* push_output -- hand a full text to the writer */
+static void push_output(scan *s, text *t)
+{
+  out_block *b;
+
+  if (!(b = malloc(sizeof(*b)))) err(EX_OSERR, NULL);
+  b->t = *t;
+  pthread_mutex_lock(&s->lock);
+  b->next = s->ready;
+  s->ready = b;
+  pthread_cond_signal(&s->output);
+  pthread_mutex_unlock(&s->lock);
+  t->data = NULL;
+  t->len = t->alloc = 0;
+}
+
+
+/* scan_worker -- thread that scans files as the walk finds them
+ *
+ * With --stats, the costs of the files are collected in the worker's
+ * own summary, which is added to the scan's at the end.
+ */
+static void *scan_worker(void *arg)
+{
+  scan *s = arg;
+  text t = {NULL, 0, 0};
+  stats_summary sum;
+  unsigned char *buf;
+  path_item *p;
+  stats cost;
+
+  if (!(buf = malloc(SCAN_PREFIX))) err(EX_OSERR, NULL);
+  if (s->stats) stats_begin_summary(&sum);
+  while ((p = next_path(s))) {
+    if (s->stats) stats_start(&cost);
+    if (!scan_file(p->path, s->format, s->verify, buf, &t))
+      __atomic_add_fetch(&s->nfailed, 1, __ATOMIC_RELAXED);
+    if (s->stats) {stats_stop(&cost); stats_add(&sum, &cost);}
+    free(p);
+    if (t.len >= SCAN_FLUSH) push_output(s, &t);
+  }
+  if (t.len) push_output(s, &t);
+  free(buf);
+  pthread_mutex_lock(&s->lock);
+  if (s->stats) stats_merge(s->stats, &sum);
+  s->running--;
+  pthread_cond_signal(&s->output);
+  pthread_mutex_unlock(&s->lock);
+  return NULL;
+}
+
 
-  printf("EOTSize:            %ld\n", h.EOTSize);
-  printf("FontDataSize:       %ld\n", h.FontDataSize);
-  printf("Version:            0x%08lX\n", h.Version);
-  printf("Flags:              %s %s %s %s\n",
-	 (h.Version & TTEMBED_SUBSET) ? "subsetted" : "not-subsetted",
-	 (h.Version & TTEMBED_TTCOMPRESSED) ? "compressed" : "not-compressed",
-	 (h.Version & TTEMBED_EMBEDEUDC) ? "EUDC": "no-EUDC",
-	 (h.Version & TTEMBED_XORENCRYPTDATA) ? "xor" : "no-xor");
-  printf("PANOSE:             %u %u %u %u %u %u %u %u %u %u\n", h.FontPANOSE[0],
-	 h.FontPANOSE[1], h.FontPANOSE[2], h.FontPANOSE[3], h.FontPANOSE[4],
-	 h.FontPANOSE[5], h.FontPANOSE[6], h.FontPANOSE[7], h.FontPANOSE[8],
-	 h.FontPANOSE[9]);
-  printf("Charset:            %u\n", h.Charset);
-  printf("Italic:             %s\n", h.Italic ? "yes" : "no");
-  printf("Weight:             %lu\n", h.Weight);
-  printf("fsType:            ");
-  if (h.fsType == 0) printf(" installable");
-  else if (h.fsType & FSTYPE_EDITABLE) printf(" editable");
-  else if (h.fsType & FSTYPE_PREVIEW) printf(" preview-and-print");
-  else if (h.fsType & FSTYPE_RESTRICTED) printf(" restricted");
-  if (h.fsType & FSTYPE_NOSUBSETTING) printf(" no-subsetting");
-  if (h.fsType & FSTYPE_BITMAP) printf(" bitmap-only");
-  printf("\n");
-  printf("UnicodeRange:      "); print_unicode_range(h); printf("\n");
-  printf("CodePageRange:     "); print_code_page_range(h); printf("\n");
-  printf("CheckSumAdjustment: %lu\n", h.CheckSumAdjustment);
-  printf("FamilyName:         ");
-  for (i = 0; i < h.FamilyNameSize; i += 2) /* UTF-16LE -> UTF-8 */
-    if ((c = h.FamilyName[i] + 256 * h.FamilyName[i+1])) putUTF8(c);
-  printf("\n");
-  printf("StyleName:          ");
-  for (i = 0; i < h.StyleNameSize; i += 2) /* UTF-16LE -> UTF-8 */
-    if ((c = h.StyleName[i] + 256 * h.StyleName[i+1])) putUTF8(c);
-  printf("\n");
-  printf("VersionName:        ");
-  for (i = 0; i < h.VersionNameSize; i += 2) /* UTF-16LE -> UTF-8 */
-    if ((c = h.VersionName[i] + 256 * h.VersionName[i+1])) putUTF8(c);
-  printf("\n");
-  printf("FullName:           ");
-  for (i = 0; i < h.FullNameSize; i += 2) /* UTF-16LE -> UTF-8 */
-    if ((c = h.FullName[i] + 256 * h.FullName[i+1])) putUTF8(c);
-  printf("\n");
-  printf("RootString:         ");
-  for (i = 0; i < h.RootStringSize; i += 2) /* UTF-16LE -> UTF-8 */
-    if ((c = h.RootString[i] + 256 * h.RootString[i+1])) putUTF8(c);
-    else putUTF8(' ');
-  printf("\n");
+/* write_output -- write the texts that the workers pushed, oldest first */
+static void write_output(out_block *b)
+{
+  out_block *prev = NULL, *next;
+
+  for (; b; b = next) {next = b->next; b->next = prev; prev = b;}
+  for (b = prev; b; b = next) {
+    next = b->next;
+    if (!write_all(STDOUT_FILENO, (unsigned char*)b->t.data, b->t.len))
+      err(EX_IOERR, NULL);
+    free(b->t.data);
+    free(b);
+  }
+}
+
+
+/* run_scan -- print the headers of all EOT files under dir, in parallel
+ *
+ * A thread walks the tree and queues the EOT files as it finds them.
+ * The workers each take the next file from the queue and format the
+ * records into their own text. Full texts are pushed onto a stack,
+ * which this thread empties and writes to stdout, so the workers only
+ * hold the lock to take a file or hand over a text, never while the
+ * output is written. With --stats, the cost of each file is added to
+ * sum. Returns an exit status.
+ */
+static int run_scan(const char *dir, out_format format, bool verify,
+		    int nworkers, stats_summary *sum)
+{
+  scan s = {.dir = dir, .head = NULL, .tail = NULL, .walked = false,
+	    .format = format, .verify = verify, .ready = NULL, .nfailed = 0,
+	    .stats = sum};
+  pthread_t *threads, walker;
+  struct stat st;
+  out_block *b;
+  int j;
+
+  if (stat(dir, &st) == -1) err(EX_NOINPUT, "%s", dir);
+  pthread_mutex_init(&s.lock, NULL);
+  pthread_cond_init(&s.found, NULL);
+  pthread_cond_init(&s.output, NULL);
+
+  if (format == FORMAT_CSV) {
+    static const char head[] = "path,error,EOTSize,FontDataSize,Version,"
+      "Flags,Charset,Italic,Weight,fsType,UnicodeRange1,UnicodeRange2,"
+      "UnicodeRange3,UnicodeRange4,CodePageRange1,CodePageRange2,"
+      "CheckSumAdjustment,FamilyName,StyleName,VersionName,FullName,"
+      "RootString\r\n";
+    if (!write_all(STDOUT_FILENO, (const unsigned char*)head, strlen(head)))
+      err(EX_IOERR, NULL);
+  }
+
+  if (nworkers <= 0) nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+  if (nworkers <= 0) nworkers = 1;
+  s.running = nworkers;
+  if (!(threads = malloc(nworkers * sizeof(threads[0])))) err(EX_OSERR, NULL);
+  if ((errno = pthread_create(&walker, NULL, walk_tree, &s)) != 0)
+    err(EX_OSERR, NULL);
+  for (j = 0; j < nworkers; j++)
+    if ((errno = pthread_create(&threads[j], NULL, scan_worker, &s)) != 0)
+      err(EX_OSERR, NULL);
+
+  pthread_mutex_lock(&s.lock);
+  for (;;) {
+    while (!s.ready && s.running) pthread_cond_wait(&s.output, &s.lock);
+    if (!(b = s.ready)) break;
+    s.ready = NULL;
+    pthread_mutex_unlock(&s.lock);
+    write_output(b);
+    pthread_mutex_lock(&s.lock);
+  }
+  pthread_mutex_unlock(&s.lock);
+
+  pthread_join(walker, NULL);
+  for (j = 0; j < nworkers; j++) pthread_join(threads[j], NULL);
+  pthread_cond_destroy(&s.output);
+  pthread_cond_destroy(&s.found);
+  pthread_mutex_destroy(&s.lock);
+  free(threads);
+  return s.nfailed ? EX_DATAERR : 0;
+}
+
+
+/* verify_exit -- the exit status of --verify for a problem */
+static int verify_exit(eot_status e)
+{
+  switch (e) {
+  case EOT_OK: return 0;
+  case EOT_ERR_HEADER: case EOT_ERR_VERSION: return 2;
+  case EOT_ERR_EOT_SIZE: return 3;
+  case EOT_ERR_FONT_DATA_SIZE: return 4;
+  case EOT_ERR_ROOTSTRING_CHECKSUM: return 5;
+  case EOT_ERR_TABLE_CHECKSUM: return 7;
+  case EOT_ERR_FONT_CHECKSUM: return 8;
+  case EOT_ERR_ADJUSTMENT: return 9;
+  case EOT_ERR_NOMEM: return EX_OSERR;
+  default: return 6;		/* The font data is corrupt */
+  }
+}
+
+
+/* verify_files -- check n EOT files (stdin if n is 0), return exit status
+ *
+ * Problems are reported on stderr. The exit status is that of the
+ * first file with a problem, or 0 if all files are valid. With
+ * --stats, the cost of each file is added to sum.
+ */
+static int verify_files(int n, char *paths[], stats_summary *sum)
+{
+  unsigned long long t;
+  mapped_file f;
+  eot_status e;
+  int i, status = 0, s;
+  stats cost;
+
+  for (i = 0; i < (n ? n : 1); i++) {
+    if (sum) stats_start(&cost);
+    t = stats_clock();
+    if (n ? !map_file(paths[i], &f) : !map_fd(STDIN_FILENO, &f)) {
+      warn("%s", n ? paths[i] : "stdin");
+      s = EX_NOINPUT;
+    } else {
+      stats_phase(STATS_MAP, t);
+      if ((e = eot_verify(f.data, f.size)) != EOT_OK)
+	warnx("%s: %s", n ? paths[i] : "stdin", eot_strerror(e));
+      s = verify_exit(e);
+      (void) unmap_file(&f);
+    }
+    if (sum) {stats_stop(&cost); stats_add(sum, &cost);}
+    if (status == 0) status = s;
+  }
+  return status;
 }
 
 
 /* usage -- print usage message and exit */
 static void usage(char *progname)
 {
-  fprintf(stderr, "%s EOT-file\n", progname);
+  fprintf(stderr, "%s [--extract font-file] [EOT-file]\n", progname);
+  fprintf(stderr, "%s --verify [EOT-file...]\n", progname);
+  fprintf(stderr,
+	  "%s --scan directory [--format json|csv] [--jobs N] [--verify]\n",
+	  progname);
+  fprintf(stderr, "Options: --stats json, --stats-file file\n");
   exit(1);
 }
 
 
 int main(int argc, char *argv[])
 {
-  FILE *f;
-  EOT_Header header;
+  static const struct option longopts[] = {
+    {"extract", required_argument, NULL, 'x'},
+    {"format", required_argument, NULL, 'f'},
+    {"jobs", required_argument, NULL, 'j'},
+    {"scan", required_argument, NULL, 's'},
+    {"stats", required_argument, NULL, 'T'},
+    {"stats-file", required_argument, NULL, 'o'},
+    {"verify", no_argument, NULL, 'v'},
+    {NULL, 0, NULL, 0}
+  };
+  const char *extract = NULL, *dir = NULL, *stats_file = NULL;
+  out_format format = FORMAT_JSON;
+  stats_summary summary, *sum = NULL;
+  unsigned long long t;
+  mapped_file f;
+  EOT_header header;
+  size_t len;
+  eot_status e;
+  bool verify = false, want_stats = false;
+  int c, status, nworkers = 0;
+  unsigned long jobs;
+  stats run;
+  char *end;
+
+  while ((c = getopt_long(argc, argv, "f:j:o:s:T:vx:", longopts, NULL))
+	 != -1)
+    switch (c) {
+    case 'x': extract = optarg; break;
+    case 's': dir = optarg; break;
+    case 'v': verify = true; break;
+    case 'j':
+      jobs = strtoul(optarg, &end, 10);
+      if (*end || !isdigit((unsigned char)*optarg) || jobs == 0 ||
+	  jobs > INT_MAX) usage(argv[0]);
+      nworkers = jobs;
+      break;
+    case 'f':
+      if (strcmp(optarg, "json") == 0) format = FORMAT_JSON;
+      else if (strcmp(optarg, "csv") == 0) format = FORMAT_CSV;
+      else usage(argv[0]);
+      break;
+    case 'T':
+      if (strcmp(optarg, "json") != 0) usage(argv[0]);
+      want_stats = true;
+      break;
+    case 'o': stats_file = optarg; want_stats = true; break;
+    default: usage(argv[0]);
+    }
 
-  switch (argc) {
-  case 1: f = stdin; break;
-  case 2: if (! (f = fopen(argv[1], "r"))) err(EX_NOINPUT,"%s",argv[1]); break;
-  default: usage(argv[0]);
+  if (dir && (extract || optind != argc)) usage(argv[0]);
+  if (verify && extract) usage(argv[0]);
+  if (!dir && !verify && argc - optind > 1) usage(argv[0]);
+  if (want_stats && (dir || verify)) {
+    stats_begin_summary(&summary);
+    sum = &summary;
+  } else if (want_stats) {
+    stats_start(&run);
   }
-  if (! read_EOT_header(f, &header)) errx(1, "Unrecognized EOT header");
-  dump_header(header);
-  return 0;
+
+  if (dir) {
+    status = run_scan(dir, format, verify, nworkers, sum);
+  } else if (verify) {
+    status = verify_files(argc - optind, argv + optind, sum);
+  } else {
+    t = stats_clock();
+    if (optind == argc ? !map_fd(STDIN_FILENO, &f) :
+	!map_file(argv[optind], &f))
+      err(EX_NOINPUT, "%s", optind == argc ? "stdin" : argv[optind]);
+    stats_phase(STATS_MAP, t);
+    if ((e = eot_read_header(&header, f.data, f.size, &len)) != EOT_OK)
+      errx(1, "%s", eot_strerror(e));
+    if (extract) extract_font(extract, f, header, len);
+    else dump_header(header);
+    eot_free_header(&header);
+    (void) unmap_file(&f);
+    status = 0;
+  }
+
+  if (want_stats && !sum) stats_stop(&run);
+  if (want_stats && !stats_write(stats_file, "eotinfo", &run, sum))
+    err(EX_CANTCREAT, "%s", stats_file ? stats_file : "stats");
+  return status;
 }
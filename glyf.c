@@ -0,0 +1,237 @@
+/* glyf -- decode and encode TrueType glyphs
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include "glyf.h"
+#include "alloc.h"
+
+#define OFFSET_INDEX_TO_LOC_FORMAT 50	/* In the head table */
+#define OFFSET_NUM_GLYPHS 4		/* In the maxp table */
+
+
+/* get_loca -- read entry i of a loca table */
+bool get_loca(view loca, bool long_format, unsigned long i,
+	      unsigned long *offset)
+{
+  unsigned short x;
+
+  loca.pos = long_format ? 4 * i : 2 * i;
+  if (long_format) return get_4be(&loca, offset);
+  if (!get_2be(&loca, &x)) return false;
+  *offset = 2UL * x;
+  return true;
+}
+
+
+/* get_glyf_info -- find the number of glyphs and the format of loca */
+bool get_glyf_info(sfnt_offset_table sfnt, unsigned short *nglyphs,
+		   bool *long_format)
+{
+  short format;
+  view v;
+
+  if (!find_table(sfnt, "head", &v)) return false;
+  v.pos = OFFSET_INDEX_TO_LOC_FORMAT;
+  if (!get_2be_signed(&v, &format)) return false;
+  *long_format = format != 0;
+  if (!find_table(sfnt, "maxp", &v)) return false;
+  v.pos = OFFSET_NUM_GLYPHS;
+  return get_2be(&v, nglyphs);
+}
+
+
+/* get_glyph -- make a view of glyph i, empty if the glyph has no outline */
+bool get_glyph(view glyf, view loca, bool long_format, unsigned short i,
+	       view *glyph)
+{
+  unsigned long start, end;
+
+  return get_loca(loca, long_format, i, &start) &&
+    get_loca(loca, long_format, i + 1, &end) && end >= start &&
+    make_view(glyf.data, glyf.length, start, end - start, glyph);
+}
+
+
+/* alloc_simple_glyph -- allocate contours and points of a simple glyph */
+eot_status alloc_simple_glyph(simple_glyph *g, short ncontours,
+			      unsigned short npoints)
+{
+  g->numberOfContours = ncontours;
+  g->numPoints = npoints;
+  g->endPtsOfContours =
+    counted_malloc(ncontours * sizeof(g->endPtsOfContours[0]));
+  g->points = counted_malloc((npoints ? npoints : 1) * sizeof(g->points[0]));
+  g->instructionLength = 0;
+  g->instructions = NULL;
+  if (g->endPtsOfContours && g->points) return EOT_OK;
+  free_simple_glyph(g);
+  return EOT_ERR_NOMEM;
+}
+
+
+/* free_simple_glyph -- free the memory allocated for a simple glyph */
+void free_simple_glyph(simple_glyph *g)
+{
+  free(g->endPtsOfContours);
+  free(g->points);
+  g->endPtsOfContours = NULL;
+  g->points = NULL;
+}
+
+
+/* compute_bbox -- set the bounding box of a simple glyph from its points */
+void compute_bbox(simple_glyph *g)
+{
+  unsigned short i;
+
+  if (g->numPoints == 0) {g->xMin = g->yMin = g->xMax = g->yMax = 0; return;}
+  g->xMin = g->xMax = g->points[0].x;
+  g->yMin = g->yMax = g->points[0].y;
+  for (i = 1; i < g->numPoints; i++) {
+    if (g->points[i].x < g->xMin) g->xMin = g->points[i].x;
+    if (g->points[i].x > g->xMax) g->xMax = g->points[i].x;
+    if (g->points[i].y < g->yMin) g->yMin = g->points[i].y;
+    if (g->points[i].y > g->yMax) g->yMax = g->points[i].y;
+  }
+}
+
+
+/* point_flag -- the flag byte for a point, without the repeat bit */
+static unsigned char point_flag(bool on_curve, int dx, int dy)
+{
+  unsigned char flag = on_curve ? GLYF_ON_CURVE : 0;
+
+  if (dx == 0) flag |= GLYF_X_SAME_OR_POS;
+  else if (dx > -256 && dx < 256)
+    flag |= GLYF_X_SHORT | (dx > 0 ? GLYF_X_SAME_OR_POS : 0);
+  if (dy == 0) flag |= GLYF_Y_SAME_OR_POS;
+  else if (dy > -256 && dy < 256)
+    flag |= GLYF_Y_SHORT | (dy > 0 ? GLYF_Y_SAME_OR_POS : 0);
+  return flag;
+}
+
+
+/* put_coordinate -- write one x or y coordinate delta of a simple glyph */
+static void put_coordinate(buffer *b, unsigned char flag,
+			   unsigned char is_short, int delta)
+{
+  if (flag & is_short) buf_put_1(b, delta < 0 ? -delta : delta);
+  else if (delta != 0) buf_put_2be(b, (unsigned short)delta);
+}
+
+
+/* write_simple_glyph -- encode a simple glyph in TrueType format */
+void write_simple_glyph(buffer *b, const simple_glyph *g)
+{
+  unsigned short i, j;
+  unsigned char flag;
+  int px, py;
+
+  buf_put_2be(b, g->numberOfContours);
+  buf_put_2be(b, g->xMin);
+  buf_put_2be(b, g->yMin);
+  buf_put_2be(b, g->xMax);
+  buf_put_2be(b, g->yMax);
+  for (i = 0; i < g->numberOfContours; i++)
+    buf_put_2be(b, g->endPtsOfContours[i]);
+  buf_put_2be(b, g->instructionLength);
+  buf_put_bytes(b, g->instructions, g->instructionLength);
+
+  /* Flags, with runs of equal flags collapsed */
+  for (i = 0, px = py = 0; i < g->numPoints; i = j) {
+    flag = point_flag(g->points[i].on_curve, g->points[i].x - px,
+		      g->points[i].y - py);
+    px = g->points[i].x;
+    py = g->points[i].y;
+    for (j = i + 1; j < g->numPoints && j - i <= 255; j++) {
+      if (point_flag(g->points[j].on_curve, g->points[j].x - px,
+		     g->points[j].y - py) != flag) break;
+      px = g->points[j].x;
+      py = g->points[j].y;
+    }
+    if (j - i > 1) {
+      buf_put_1(b, flag | GLYF_REPEAT);
+      buf_put_1(b, j - i - 1);
+    } else {
+      buf_put_1(b, flag);
+    }
+  }
+
+  /* X coordinates, then Y coordinates */
+  for (i = 0, px = 0; i < g->numPoints; px = g->points[i++].x)
+    put_coordinate(b, point_flag(g->points[i].on_curve, g->points[i].x - px,
+				 0), GLYF_X_SHORT, g->points[i].x - px);
+  for (i = 0, py = 0; i < g->numPoints; py = g->points[i++].y)
+    put_coordinate(b, point_flag(g->points[i].on_curve, 0,
+				 g->points[i].y - py), GLYF_Y_SHORT,
+		   g->points[i].y - py);
+}
+
+
+/* next_component -- read one component of a composite glyph
+ *
+ * v must be positioned at the component's flags. On return, it is
+ * positioned at the next component, or at the instructions.
+ */
+bool next_component(view *v, unsigned short *flags, unsigned short *glyphIndex)
+{
+  size_t n;
+
+  if (!get_2be(v, flags) || !get_2be(v, glyphIndex)) return false;
+  n = (*flags & GLYF_ARG_1_AND_2_ARE_WORDS) ? 4 : 2;
+  if (*flags & GLYF_WE_HAVE_A_SCALE) n += 2;
+  else if (*flags & GLYF_WE_HAVE_AN_X_AND_Y_SCALE) n += 4;
+  else if (*flags & GLYF_WE_HAVE_A_TWO_BY_TWO) n += 8;
+  if (v->length - v->pos < n) return false;
+  v->pos += n;
+  return true;
+}
+
+
+/* with_sign -- apply the sign bit (bit 0 set means positive) to a value */
+static int with_sign(int flag, int value)
+{
+  return (flag & 1) ? value : -value;
+}
+
+
+/* get_triplet -- decode a point from its flag byte and data bytes */
+bool get_triplet(unsigned char flag, view *data, int *dx, int *dy)
+{
+  unsigned char b[4];
+
+  flag &= 0x7f;
+  if (flag < 10) {
+    if (!get_bytes(data, b, 1)) return false;
+    *dx = 0;
+    *dy = with_sign(flag, ((flag & 14) << 7) + b[0]);
+  } else if (flag < 20) {
+    if (!get_bytes(data, b, 1)) return false;
+    *dx = with_sign(flag, (((flag - 10) & 14) << 7) + b[0]);
+    *dy = 0;
+  } else if (flag < 84) {
+    if (!get_bytes(data, b, 1)) return false;
+    *dx = with_sign(flag, 1 + ((flag - 20) & 0x30) + (b[0] >> 4));
+    *dy = with_sign(flag >> 1, 1 + (((flag - 20) & 0x0c) << 2) + (b[0] & 0x0f));
+  } else if (flag < 120) {
+    if (!get_bytes(data, b, 2)) return false;
+    *dx = with_sign(flag, 1 + (((flag - 84) / 12) << 8) + b[0]);
+    *dy = with_sign(flag >> 1, 1 + ((((flag - 84) % 12) >> 2) << 8) + b[1]);
+  } else if (flag < 124) {
+    if (!get_bytes(data, b, 3)) return false;
+    *dx = with_sign(flag, (b[0] << 4) + (b[1] >> 4));
+    *dy = with_sign(flag >> 1, ((b[1] & 0x0f) << 8) + b[2]);
+  } else {
+    if (!get_bytes(data, b, 4)) return false;
+    *dx = with_sign(flag, (b[0] << 8) + b[1]);
+    *dy = with_sign(flag >> 1, (b[2] << 8) + b[3]);
+  }
+  return true;
+}
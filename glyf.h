@@ -0,0 +1,65 @@
+/* glyf.h -- decode and encode TrueType glyphs (internal to libeot)
+ *
+ * Besides the TrueType glyf format itself, this handles the compact
+ * "triplet" encoding of points and the 255UShort numbers that the
+ * MicroType Express CTF format (and WOFF 2.0 after it) uses.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef GLYF_H
+#define GLYF_H
+
+#include "sfnt.h"
+
+/* Flags in simple glyphs */
+#define GLYF_ON_CURVE		0x01
+#define GLYF_X_SHORT		0x02
+#define GLYF_Y_SHORT		0x04
+#define GLYF_REPEAT		0x08
+#define GLYF_X_SAME_OR_POS	0x10
+#define GLYF_Y_SAME_OR_POS	0x20
+
+/* Flags in composite glyphs */
+#define GLYF_ARG_1_AND_2_ARE_WORDS	0x0001
+#define GLYF_WE_HAVE_A_SCALE		0x0008
+#define GLYF_MORE_COMPONENTS		0x0020
+#define GLYF_WE_HAVE_AN_X_AND_Y_SCALE	0x0040
+#define GLYF_WE_HAVE_A_TWO_BY_TWO	0x0080
+#define GLYF_WE_HAVE_INSTRUCTIONS	0x0100
+
+typedef struct {
+  int x, y;			/* Absolute coordinates */
+  bool on_curve;
+} glyph_point;
+
+typedef struct {
+  short numberOfContours;	/* > 0 */
+  short xMin, yMin, xMax, yMax;
+  unsigned short *endPtsOfContours;
+  unsigned short numPoints;
+  glyph_point *points;
+  unsigned short instructionLength;
+  const unsigned char *instructions; /* Points into the font */
+} simple_glyph;
+
+extern bool get_glyf_info(sfnt_offset_table sfnt, unsigned short *nglyphs,
+			  bool *long_format);
+extern bool get_loca(view loca, bool long_format, unsigned long i,
+		     unsigned long *offset);
+extern bool get_glyph(view glyf, view loca, bool long_format,
+		      unsigned short i, view *glyph);
+
+extern eot_status alloc_simple_glyph(simple_glyph *g, short ncontours,
+				     unsigned short npoints);
+extern void free_simple_glyph(simple_glyph *g);
+extern void compute_bbox(simple_glyph *g);
+extern void write_simple_glyph(buffer *b, const simple_glyph *g);
+
+extern bool next_component(view *v, unsigned short *flags,
+			   unsigned short *glyphIndex);
+
+extern bool get_triplet(unsigned char flag, view *data, int *dx, int *dy);
+
+#endif /* GLYF_H */
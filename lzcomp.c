@@ -0,0 +1,271 @@
+/* lzcomp -- decompression of LZ77 with adaptive Huffman codes, as in MTX
+ *
+ * The stream starts with one bit (1 if run-length coding was used,
+ * which is not supported) and the uncompressed length in 24 bits. Then follow symbols from three adaptive Huffman coders:
+ * the main coder has the 256 byte values, a symbol per combination of
+ * distance range and first length chunk, and the three symbols DUP2,
+ * DUP4 and DUP6, which repeat the last 2, 4 or 6 bytes; the other two
+ * code the remaining length and distance chunks.
+ *
+ * Lengths are coded in chunks of LEN_WIDTH - 1 bits plus a bit that
+ * says whether another chunk follows, distances in a known number of
+ * chunks of DIST_WIDTH bits. Copies from FAR_DIST or more bytes back
+ * are at least LEN_MIN + 1 long and their lengths are coded from
+ * there. Copies may refer back into a fixed history of PRELOAD_SIZE
+ * bytes that precedes the data.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include "lzcomp.h"
+#include "alloc.h"
+
+#define LEN_WIDTH 3
+#define DIST_WIDTH 3
+#define LEN_MIN 2
+#define DIST_MIN 1
+#define FAR_DIST 512
+#define PRELOAD_SIZE (2 * 32 * 96 + 4 * 256)
+#define MAX_RANGES 9		/* 27 bits cover PRELOAD_SIZE + 2^24 */
+#define MAX_SYMS (256 + MAX_RANGES * (1 << LEN_WIDTH) + 3)
+#define MAX_NODES (2 * MAX_SYMS - 1)
+#define MAX_WEIGHT 0x8000	/* Weights are halved when the root gets here */
+
+typedef struct {		/* Adaptive Huffman tree, nodes by weight */
+  int nsyms;
+  unsigned long weight[MAX_NODES];
+  int parent[MAX_NODES];	/* -1 for the root */
+  int child[MAX_NODES];		/* First of two children, or -(symbol+1) */
+  int leaf[MAX_SYMS];		/* The node of each symbol */
+} ahuff;
+
+typedef struct {
+  view *in;
+  unsigned char byte;
+  int nbits;
+  bool failed;
+} bit_reader;
+
+typedef struct {
+  ahuff sym, len, dist;
+  int ranges;			/* Most distance chunks a copy can have */
+} lz_coders;
+
+
+/* get_bit -- read one bit, return 0 and set failed at end of input */
+static int get_bit(bit_reader *r)
+{
+  if (r->nbits == 0) {
+    if (!get_1(r->in, &r->byte)) {r->failed = true; return 0;}
+    r->nbits = 8;
+  }
+  return (r->byte >> --r->nbits) & 1;
+}
+
+
+/* get_bits -- read an n bit number */
+static unsigned long get_bits(bit_reader *r, int n)
+{
+  unsigned long x = 0;
+
+  while (n--) x = (x << 1) | get_bit(r);
+  return x;
+}
+
+
+/* adopt -- make the parent pointers of node's children point to it */
+static void adopt(ahuff *t, int node)
+{
+  int c = t->child[node];
+
+  if (c < 0) t->leaf[-c - 1] = node;
+  else t->parent[c] = t->parent[c + 1] = node;
+}
+
+
+/* compare_leaves -- order leaves by weight, then by symbol, for qsort */
+static int compare_leaves(const void *a, const void *b)
+{
+  const unsigned long *x = a, *y = b;
+
+  if (x[0] != y[0]) return x[0] < y[0] ? -1 : 1;
+  return x[1] < y[1] ? -1 : x[1] > y[1];
+}
+
+
+/* rebuild -- make a Huffman tree for the weights of the leaves
+ *
+ * This is the two-queue Huffman algorithm. Nodes are numbered in the
+ * reverse of the order in which they were taken from the queues, which
+ * gives the sibling property that the FGK update relies on.
+ */
+static void rebuild(ahuff *t, bool halve)
+{
+  unsigned long leaves[MAX_SYMS][2], inner[MAX_SYMS];
+  int picked[MAX_NODES], pos[MAX_NODES], children[MAX_SYMS];
+  int n = t->nsyms, i, j, k, m, q1 = 0, q2 = 0, node;
+
+  for (i = 0; i < n; i++) {
+    leaves[i][0] = t->weight[t->leaf[i]];
+    if (halve) leaves[i][0] = (leaves[i][0] + 1) / 2;
+    leaves[i][1] = i;
+  }
+  qsort(leaves, n, sizeof(leaves[0]), compare_leaves);
+
+  /* Items 0..n-1 are leaves (in sorted order), n.. are inner nodes */
+  for (k = 0, m = 0; k < n - 1; k++) {
+    for (j = 0; j < 2; j++) {
+      if (q1 < n && (q2 == k || leaves[q1][0] <= inner[q2]))
+	picked[m++] = q1++;
+      else
+	picked[m++] = n + q2++;
+    }
+    for (inner[k] = 0, j = m - 2; j < m; j++)
+      inner[k] += picked[j] < n ? leaves[picked[j]][0] : inner[picked[j] - n];
+    children[k] = m - 1;
+  }
+
+  /* The root is node 0, the item picked m-th becomes node 2n-2-m */
+  pos[2 * n - 2] = 0;
+  for (m = 0; m < 2 * n - 2; m++) pos[picked[m]] = 2 * n - 2 - m;
+  t->parent[0] = -1;
+  for (i = 0; i < 2 * n - 1; i++) {
+    node = pos[i];
+    if (i < n) {
+      t->weight[node] = leaves[i][0];
+      t->child[node] = -(int)leaves[i][1] - 1;
+    } else {
+      t->weight[node] = inner[i - n];
+      t->child[node] = pos[picked[children[i - n]]];
+    }
+    adopt(t, node);
+  }
+}
+
+
+/* ahuff_init -- make a tree with all symbols at weight 1 */
+static void ahuff_init(ahuff *t, int nsyms)
+{
+  int i;
+
+  t->nsyms = nsyms;
+  for (i = 0; i < nsyms; i++) {t->leaf[i] = i; t->weight[i] = 1;}
+  rebuild(t, false);
+}
+
+
+/* ahuff_update -- increment the weight of a symbol (FGK algorithm) */
+static void ahuff_update(ahuff *t, int sym)
+{
+  int node, first, c;
+
+  if (t->weight[0] >= MAX_WEIGHT) rebuild(t, true);
+  for (node = t->leaf[sym]; node != -1; node = t->parent[node]) {
+    /* Swap with the first node of equal weight (never an ancestor) */
+    for (first = node; first > 0 && t->weight[first-1] == t->weight[node];)
+      first--;
+    if (first != node) {
+      c = t->child[first]; t->child[first] = t->child[node]; t->child[node] = c;
+      adopt(t, first);
+      adopt(t, node);
+      node = first;
+    }
+    t->weight[node]++;
+  }
+}
+
+
+/* ahuff_get -- read a symbol and update the tree */
+static int ahuff_get(ahuff *t, bit_reader *r)
+{
+  int node = 0, sym;
+
+  while (t->child[node] >= 0) node = t->child[node] + get_bit(r);
+  sym = -t->child[node] - 1;
+  ahuff_update(t, sym);
+  return sym;
+}
+
+
+/* preload -- fill the history that precedes the data */
+static void preload(unsigned char *p)
+{
+  int i, j;
+
+  /* Pairs of small numbers, and small numbers in 4 bytes (big endian) */
+  for (i = 0; i < 32; i++)
+    for (j = 0; j < 96; j++) {*p++ = i; *p++ = j + 32;}
+  for (i = 0; i < 256; i++) {*p++ = 0; *p++ = 0; *p++ = 0; *p++ = i;}
+}
+
+
+/* init_coders -- set up the three Huffman trees for a given data length */
+static lz_coders *init_coders(size_t len)
+{
+  unsigned long maxdist = PRELOAD_SIZE + len - DIST_MIN;
+  lz_coders *z;
+
+  if (!(z = counted_malloc(sizeof(*z)))) return NULL;
+  for (z->ranges = 1; maxdist >> (DIST_WIDTH * z->ranges); z->ranges++);
+  ahuff_init(&z->sym, 256 + z->ranges * (1 << LEN_WIDTH) + 3);
+  ahuff_init(&z->len, 1 << LEN_WIDTH);
+  ahuff_init(&z->dist, 1 << DIST_WIDTH);
+  return z;
+}
+
+
+/* lzcomp_decompress -- decompress data from a view and append it to out */
+eot_status lzcomp_decompress(view *in, buffer *out)
+{
+  unsigned long len, l, d;
+  size_t pos, end;
+  bit_reader r = {in, 0, 0, false};
+  unsigned char *win = NULL;
+  lz_coders *z = NULL;
+  int sym, chunk, i;
+  eot_status e = EOT_ERR_NOMEM;
+
+  if (get_bit(&r) != 0) return EOT_ERR_MTX; /* Run-length coding */
+  len = get_bits(&r, 24);
+  if (r.failed) return EOT_ERR_MTX;
+  end = PRELOAD_SIZE + len;
+  if (!(z = init_coders(len)) || !(win = counted_malloc(end))) goto done;
+  preload(win);
+
+  e = EOT_ERR_MTX;
+  for (pos = PRELOAD_SIZE; pos < end;) {
+    sym = ahuff_get(&z->sym, &r);
+    if (r.failed) goto done;
+    if (sym < 256) {win[pos++] = sym; continue;}
+    sym -= 256;
+    if (sym >= z->ranges * (1 << LEN_WIDTH)) { /* DUP2, DUP4 or DUP6 */
+      l = d = 2 * (sym - z->ranges * (1 << LEN_WIDTH) + 1);
+    } else {
+      for (chunk = sym % (1 << LEN_WIDTH), l = 0;;
+	   chunk = ahuff_get(&z->len, &r)) {
+	l = (l << (LEN_WIDTH - 1)) | (chunk & ((1 << (LEN_WIDTH - 1)) - 1));
+	if (!(chunk & (1 << (LEN_WIDTH - 1))) || r.failed) break;
+	if (l > end) goto done;
+      }
+      for (i = 0, d = 0; i < sym / (1 << LEN_WIDTH) + 1; i++)
+	d = (d << DIST_WIDTH) | ahuff_get(&z->dist, &r);
+      d += DIST_MIN;
+      l += LEN_MIN + (d >= FAR_DIST);
+    }
+    if (r.failed || d > pos || l > end - pos) goto done;
+    for (; l; l--, pos++) win[pos] = win[pos - d];
+  }
+  buf_put_bytes(out, win + PRELOAD_SIZE, len);
+  e = out->failed ? EOT_ERR_NOMEM : EOT_OK;
+
+ done:
+  free(win);
+  free(z);
+  return e;
+}
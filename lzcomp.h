@@ -0,0 +1,14 @@
+/* lzcomp.h -- the LZCOMP decompressor of MicroType Express (internal to libeot)
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef LZCOMP_H
+#define LZCOMP_H
+
+#include "sfnt.h"
+
+extern eot_status lzcomp_decompress(view *in, buffer *out);
+
+#endif /* LZCOMP_H */
@@ -0,0 +1,269 @@
+/* mapfile -- get a whole file into memory, mapped if possible
+ *
+ * Used by mkeot and eotinfo to give libeot the font or EOT file as
+ * one block of memory. Regular files are mapped, anything else (pipes,
+ * terminals) is read into a buffer. Parts of a mapped file can be
+ * copied to another file without passing through user space.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <err.h>
+#include <stdbool.h>
+#include <sysexits.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
+#include "eot.h"
+#include "mapfile.h"
+
+#define COPY_BUFSIZE (1024 * 1024)	/* For the read/write fallback */
+#define XOR_BUFSIZE (128 * 1024)	/* Stays in the cache until written */
+
+__thread io_counters io_count;
+
+
+/* map_fd -- map an open file into memory, or read it if it can't */
+bool map_fd(int fd, mapped_file *m)
+{
+  struct stat st;
+  unsigned char *buf = NULL, *p;
+  size_t size = 0, alloc = 0;
+  ssize_t n;
+  void *a;
+
+  io_count.syscalls++;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+    a = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    io_count.syscalls++;
+    if (a != MAP_FAILED) {
+      (void) madvise(a, st.st_size, MADV_WILLNEED);
+      io_count.syscalls++;
+      io_count.read += st.st_size;
+      m->data = a;
+      m->size = st.st_size;
+      m->mapped = true;
+      m->fd = fd;
+      return true;
+    }
+  }
+
+  /* Not a regular file (a pipe, say), or mmap failed: read it instead */
+  for (;;) {
+    if (size == alloc) {
+      alloc = alloc ? 2 * alloc : 65536;
+      if (!(p = realloc(buf, alloc))) err(EX_OSERR, NULL);
+      buf = p;
+    }
+    n = read(fd, buf + size, alloc - size);
+    io_count.syscalls++;
+    if (n == 0) break;
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1) {free(buf); return false;}
+    size += n;
+    io_count.read += n;
+  }
+  m->data = buf;
+  m->size = size;
+  m->mapped = false;
+  m->fd = fd;
+  return true;
+}
+
+
+/* map_file -- open a file and map it into memory, or read it */
+bool map_file(const char *path, mapped_file *m)
+{
+  int fd, e;
+
+  io_count.syscalls++;
+  if ((fd = open(path, O_RDONLY)) == -1) return false;
+  if (map_fd(fd, m)) return true;
+  e = errno;
+  (void) close(fd);
+  io_count.syscalls++;
+  errno = e;
+  return false;
+}
+
+
+/* unmap_file -- unmap or free a file and close it */
+bool unmap_file(mapped_file *m)
+{
+  if (m->mapped) (void) munmap((void*)m->data, m->size);
+  else free((void*)m->data);
+  m->data = NULL;
+  m->size = 0;
+  io_count.syscalls += m->mapped ? 2 : 1;
+  return close(m->fd) == 0;
+}
+
+
+/* write_all -- write len bytes from buf to file descriptor out */
+bool write_all(int out, const unsigned char *buf, size_t len)
+{
+  ssize_t n;
+
+  while (len > 0) {
+    n = write(out, buf, len);
+    io_count.syscalls++;
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    io_count.written += n;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+
+/* writev_all -- write all n buffers of iov to file descriptor out
+ *
+ * Usually one writev call is enough. After a partial write, iov is
+ * adjusted to what remains and writev is called again.
+ */
+bool writev_all(int out, struct iovec iov[], int n)
+{
+  ssize_t k;
+
+  while (n > 0) {
+    k = writev(out, iov, n);
+    io_count.syscalls++;
+    if (k == -1) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    io_count.written += k;
+    for (; n > 0 && (size_t)k >= iov->iov_len; iov++, n--) k -= iov->iov_len;
+    if (n > 0) {
+      iov->iov_base = (char*)iov->iov_base + k;
+      iov->iov_len -= k;
+    }
+  }
+  return true;
+}
+
+
+/* write_xor -- write len bytes from buf to out, XOR'ed with EOT_XOR_KEY
+ *
+ * The data is obfuscated one cache-sized piece at a time, just before
+ * it is written, so the data is read from memory only once.
+ */
+bool write_xor(int out, const unsigned char *buf, size_t len)
+{
+  unsigned char *tmp;
+  size_t n;
+
+  if (!(tmp = malloc(len < XOR_BUFSIZE ? len + 1 : XOR_BUFSIZE)))
+    err(EX_OSERR, NULL);
+  while (len > 0) {
+    n = len < XOR_BUFSIZE ? len : XOR_BUFSIZE;
+    eot_xor(tmp, buf, n);
+    if (!write_all(out, tmp, n)) {free(tmp); return false;}
+    buf += n;
+    len -= n;
+  }
+  free(tmp);
+  return true;
+}
+
+
+/* is_unsupported -- check if a copy syscall failed only for lack of support */
+static bool is_unsupported(int e)
+{
+  return e == EINVAL || e == ENOSYS || e == EXDEV || e == EBADF ||
+    e == EOPNOTSUPP || e == ENOTSUP;
+}
+
+
+/* copy_range -- copy part of a file to out, in the kernel if possible
+ *
+ * Tries copy_file_range (out is a regular file), then splice (out is
+ * a pipe), then sendfile, and finally falls back to a loop of pread
+ * and write with a large buffer. Each method continues where the
+ * previous one gave up, so the output is the same whichever is used.
+ */
+bool copy_range(mapped_file src, size_t start, size_t len, int out)
+{
+  off_t offset = start;
+  unsigned char *buf;
+  struct stat st;
+  ssize_t n;
+
+  if (!src.mapped)		/* File was read from a pipe, just write it */
+    return write_all(out, src.data + start, len);
+
+  io_count.syscalls++;
+  if (fstat(out, &st) == -1) return false;
+
+#ifdef HAVE_COPY_FILE_RANGE
+  if (S_ISREG(st.st_mode)) {
+    while (len > 0) {
+      n = copy_file_range(src.fd, &offset, out, NULL, len, 0);
+      io_count.syscalls++;
+      if (n == -1 && errno == EINTR) continue;
+      if (n == -1 && is_unsupported(errno)) break;
+      if (n == -1) return false;
+      if (n == 0) break;		/* File shrank? Let the fallbacks decide */
+      io_count.written += n;
+      len -= n;
+    }
+  }
+#endif
+
+#ifdef HAVE_SPLICE
+  if (S_ISFIFO(st.st_mode)) {
+    while (len > 0) {
+      n = splice(src.fd, &offset, out, NULL, len, SPLICE_F_MORE);
+      io_count.syscalls++;
+      if (n == -1 && errno == EINTR) continue;
+      if (n == -1 && is_unsupported(errno)) break;
+      if (n == -1) return false;
+      if (n == 0) break;
+      io_count.written += n;
+      len -= n;
+    }
+  }
+#endif
+
+#ifdef HAVE_SENDFILE
+  while (len > 0) {
+    n = sendfile(out, src.fd, &offset, len);
+    io_count.syscalls++;
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1 && is_unsupported(errno)) break;
+    if (n == -1) return false;
+    if (n == 0) break;
+    io_count.written += n;
+    len -= n;
+  }
+#endif
+
+  if (len == 0) return true;
+
+  /* Last resort: plain reads and writes */
+  if (!(buf = malloc(COPY_BUFSIZE))) err(EX_OSERR, NULL);
+  while (len > 0) {
+    n = pread(src.fd, buf, len < COPY_BUFSIZE ? len : COPY_BUFSIZE, offset);
+    io_count.syscalls++;
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0 || !write_all(out, buf, n)) {free(buf); return false;}
+    offset += n;
+    len -= n;
+  }
+  free(buf);
+  return true;
+}
@@ -0,0 +1,51 @@
+/* mapfile.h -- get a whole file into memory, mapped if possible
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+typedef struct {		/* A whole file, in memory */
+  const unsigned char *data;
+  size_t size;
+  bool mapped;			/* data is mmap'ed, else malloc'ed */
+  int fd;
+} mapped_file;
+
+typedef struct {		/* The I/O that a thread did */
+  unsigned long long read;	/* Bytes read, or mapped */
+  unsigned long long written;	/* Bytes written, or copied to a file */
+  unsigned long long syscalls;	/* I/O system calls made */
+} io_counters;
+
+/* io_count -- the counters of the current thread, updated by the callers */
+extern __thread io_counters io_count;
+
+/* map_file -- map a file into memory, or read it if it can't be mapped */
+extern bool map_file(const char *path, mapped_file *m);
+
+/* map_fd -- map or read an open file, e.g., standard input */
+extern bool map_fd(int fd, mapped_file *m);
+
+/* unmap_file -- unmap or free a file and close it */
+extern bool unmap_file(mapped_file *m);
+
+/* write_all -- write len bytes from buf to file descriptor out */
+extern bool write_all(int out, const unsigned char *buf, size_t len);
+
+/* writev_all -- write all n buffers of iov to out, iov is modified */
+extern bool writev_all(int out, struct iovec iov[], int n);
+
+/* write_xor -- write len bytes from buf to out, XOR'ed with EOT_XOR_KEY */
+extern bool write_xor(int out, const unsigned char *buf, size_t len);
+
+/* copy_range -- copy len bytes of src, from start, to file descriptor out */
+extern bool copy_range(mapped_file src, size_t start, size_t len, int out);
+
+#endif /* MAPFILE_H */
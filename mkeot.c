@@ -1,9 +1,24 @@
 /* mkeot -- create an EOT file from an OTF or TTF file
  *
  * Creates an EOT file given one or more URL prefixes and an OTF/TTF
- * font file. For the moment, MicroType Express compression is not
- * performed. Also, no obfuscation is done, and no subsetting. The
- * URLs can currently only be in ASCII.
+ * font file. With --subset, only the glyphs for the given characters
+ * are kept, and with --xor, the font is obfuscated. --verify-font rejects
+ * fonts whose checksums are wrong, --fix-checksums corrects them. The
+ * URLs are in UTF-8 and more of them can be read from a file with
+ * --urls-from. URLs that another URL is a prefix of are left out, and
+ * with --collapse-urls, URLs in the same directory are replaced by it.
+ * With --cache, EOT files are kept in a directory and reused when the
+ * same font is converted again with the same URLs and options.
+ * --template writes an EOT file without URLs and with the offset at
+ * which they go, from which --from-template then makes EOT files
+ * without reading the font again. The font file may be a TrueType
+ * Collection: --face picks one of its fonts, --all-faces converts all
+ * of them in parallel. WOFF and WOFF 2.0 files are decoded in memory.
+ * --stats=json reports the time spent in each phase, the I/O and the
+ * allocations, per run or, for a batch, as histograms over the jobs.
+ *
+ * The EOT header is made by libeot, this program only handles the
+ * files and the command line.
  *
  * Author: Bert Bos <bert@w3.org>
  * Created: 24 January 2010
@@ -12,727 +27,1060 @@
  * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
  */
 
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <err.h>
 #include <stdbool.h>
 #include <sysexits.h>
-#include <assert.h>
 #include <string.h>
-
-#define FSTYPE_RESTRICTED			0x0002
-#define FSTYPE_PREVIEW				0x0004
-#define FSTYPE_EDITABLE				0x0008
-#define FSTYPE_NOSUBSETTING			0x0100
-#define FSTYPE_BITMAP				0x0200
-
-/* sfnt version numbers for OpenType/TrueType */
-#define SFNT_OTTO (('O' << 24) | ('T' << 16) | ('T' << 8) | 'O')
-#define SFNT_TRUE (('t' << 24) | ('r' << 16) | ('u' << 8) | 'e')
-#define SFNT_TYP1 (('t' << 24) | ('y' << 16) | ('p' << 8) | '1')
-#define SFNT_VERSION_1_0 0x00010000
+#include <ctype.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include "eot.h"
+#include "mapfile.h"
+#include "cache.h"
+#include "stats.h"
+#include "probes.h"
+
+#define CACHE_SIZE (1ULL << 30)		/* Default limit of --cache */
+
+typedef struct {		/* Options that apply to every EOT file */
+  bool subset;
+  bool xor;			/* Obfuscate the font data */
+  bool verify;			/* Reject fonts with wrong checksums */
+  bool fix;			/* Recompute the font's checksums */
+  bool collapse;		/* Replace URLs by their shared directory */
+  bool template;		/* Write a template instead of an EOT file */
+  eot_unicode_range *ranges;	/* The characters to keep, if subset */
+  size_t nranges;
+  char **urls;			/* URLs from --urls-from, for every file */
+  int nurls;
+  cache *cache;			/* Cache of EOT files, or NULL */
+  stats_summary *stats;		/* Costs of the jobs of a batch, or NULL */
+} options;
+
+typedef struct {		/* A font file, and the font in it */
+  mapped_file file;		/* The file as read, for the cache key */
+  mapped_file sfnt;		/* The decoded WOFF or the file, or no data */
+  unsigned char *woff;		/* Memory that sfnt points to, or NULL */
+} font_source;
+
+typedef struct {		/* One line of a batch manifest */
+  unsigned long lineno;
+  long face;			/* Font in a collection, -1 for the first */
+  char *line;
+  int argc;
+  char **argv;			/* Font file, EOT file, URLs */
+} batch_job;
+
+typedef struct {		/* Jobs head..tail-1 belong to one worker */
+  pthread_mutex_t lock;
+  size_t head, tail;
+} job_queue;
 
 typedef struct {
-  unsigned long EOTSize;
-  unsigned long FontDataSize;
-  unsigned long Version;
-  unsigned long Flags;
-  unsigned char FontPANOSE[10];
-  unsigned char Charset;
-  unsigned char Italic;
-  unsigned long Weight;
-  unsigned short fsType;
-  unsigned short MagicNumber;	/* = 0x504C */
-  unsigned long UnicodeRange1;
-  unsigned long UnicodeRange2;
-  unsigned long UnicodeRange3;
-  unsigned long UnicodeRange4;
-  unsigned long CodePageRange1;
-  unsigned long CodePageRange2;
-  unsigned long CheckSumAdjustment;
-  unsigned long Reserved1;	/* = 0 */
-  unsigned long Reserved2;	/* = 0 */
-  unsigned long Reserved3;	/* = 0 */
-  unsigned long Reserved4;	/* = 0 */
-  unsigned short Padding1;	/* = 0 */
-  unsigned short FamilyNameSize;
-  unsigned char *FamilyName;	/* in UTF-16! */
-  unsigned short Padding2;	/* = 0 */
-  unsigned short StyleNameSize;
-  unsigned char *StyleName;	/* in UTF-16! */
-  unsigned short Padding3;	/* = 0 */
-  unsigned short VersionNameSize;
-  unsigned char *VersionName;	/* in UTF-16! */
-  unsigned short Padding4;	/* = 0 */
-  unsigned short FullNameSize;
-  unsigned char *FullName;	/* in UTF-16! */
-  unsigned short Padding5;	/* = 0 */
-  unsigned short RootStringSize;
-  unsigned char *RootString;	/* in UTF-16! */
-  unsigned long RootStringCheckSum;
-  unsigned long EUDCCodePage;
-  unsigned short Padding6;	/* = 0 */
-  unsigned short SignatureSize;
-  unsigned char *Signature;
-  unsigned long EUDCFlags;
-  unsigned long EUDCFontSize;
-  unsigned char *EUDCFontData;
-} EOT_header;
+  const char *manifest;		/* Or the collection, with --all-faces */
+  const font_source *source;	/* The collection, with --all-faces */
+  const options *opts;
+  batch_job *jobs;
+  job_queue *queues;		/* One per worker */
+  int nworkers;
+  mode_t mode;			/* For the EOT files */
+  pthread_mutex_t report_lock;	/* Protects stderr and the fields below */
+  unsigned long nfailed;
+  int status;			/* Exit status of the first failed job */
+} batch;
 
 typedef struct {
-  char tag[4];
-  unsigned long checkSum;
-  unsigned long offset;
-  unsigned long length;
-} sfnt_table_record;
+  batch *b;
+  int self;			/* Index of this worker's queue */
+} worker_arg;
 
-typedef struct {
-  unsigned long sfnt_version;
-  unsigned short numTables;
-  unsigned short searchRange;
-  unsigned short entrySelector;
-  unsigned short rangeShift;
-  sfnt_table_record *tables;
-} sfnt_offset_table;
 
-typedef struct {
-  unsigned short version; /* = 0x0004 */
-  short xAvgCharWidth;
-  unsigned short usWeightClass;
-  unsigned short usWidthClass;
-  unsigned short fsType;
-  short ySubscriptXSize;
-  short ySubscriptYSize;
-  short ySubscriptXOffset;
-  short ySubscriptYOffset;
-  short ySuperscriptXSize;
-  short ySuperscriptYSize;
-  short ySuperscriptXOffset;
-  short ySuperscriptYOffset;
-  short yStrikeoutSize;
-  short yStrikeoutPosition;
-  short sFamilyClass;
-  unsigned char panose[10];
-  unsigned long ulUnicodeRange1;
-  unsigned long ulUnicodeRange2;
-  unsigned long ulUnicodeRange3;
-  unsigned long ulUnicodeRange4;
-  char achVendID[4];
-  unsigned short fsSelection;
-  unsigned short usFirstCharIndex;
-  unsigned short usLastCharIndex;
-  short sTypoAscender;
-  short sTypoDescender;
-  short sTypoLineGap;
-  unsigned short usWinAscent;
-  unsigned short usWinDescent;
-  unsigned long ulCodePageRange1;
-  unsigned long ulCodePageRange2;
-  short sxHeight;
-  short sCapHeight;
-  unsigned short usDefaultChar;
-  unsigned short usBreakChar;
-  unsigned short usMaxContext;
-} OS2_table;
+/* write_eot -- write the serialized header and the font data to out
+ *
+ * Font data that is in memory goes out together with the header in a
+ * single writev. A font that is still in its file is copied by the
+ * kernel, after the header, and font data that must be obfuscated is
+ * XOR'ed while it is written.
+ */
+static bool write_eot(int out, unsigned char *buf, size_t len,
+		      const EOT_header *h, mapped_file src, bool xor)
+{
+  unsigned long long t = stats_clock();
+  struct iovec iov[2];
+  bool ok;
+
+  PROBE2(copy__entry, len, h->FontDataSize);
+  if (xor) {
+    ok = write_all(out, buf, len) &&
+      write_xor(out, h->FontData, h->FontDataSize);
+  } else if (h->FontData == src.data && src.mapped) {
+    ok = write_all(out, buf, len) && copy_range(src, 0, src.size, out);
+  } else {
+    iov[0].iov_base = buf;
+    iov[0].iov_len = len;
+    iov[1].iov_base = (void*)h->FontData;
+    iov[1].iov_len = h->FontDataSize;
+    ok = writev_all(out, iov, 2);
+  }
+  PROBE1(copy__return, ok);
+  stats_phase(STATS_COPY, t);
+  return ok;
+}
 
-typedef struct {
-  unsigned short length;
-  unsigned short offset;
-} LangTagRecord;
 
-typedef struct {
-  unsigned short platformID;
-  unsigned short encodingID;
-  unsigned short languageID;
-  unsigned short nameID;
-  unsigned short length;
-  unsigned short offset;
-} NameRecord;
+/* url_dir -- the length of the directory of a URL, 0 if it has none
+ *
+ * The directory is everything up to and including the last "/" before
+ * any query or fragment. The root of a host does not count, so that
+ * collapsing never grants a whole site: "http://a/b/c" is in
+ * "http://a/b/", but "http://a/b" is in none.
+ */
+static size_t url_dir(const char *url)
+{
+  const char *host = strstr(url, "://");
+  size_t root, end;
+
+  root = host ? host - url + 3 : 0;
+  root += strcspn(url + root, "/?#");
+  end = root + strcspn(url + root, "?#");
+  while (end > root && url[end-1] != '/') end--;
+  return end > root + 1 ? end : 0;
+}
 
-typedef struct {
-  unsigned short format;	/* = 0 or 1 */
-  unsigned short count;
-  unsigned short stringOffset;
-  NameRecord *nameRecord;
-  unsigned short langTagCount;
-  LangTagRecord *langTagRecord;
-  unsigned char **names;	/* UTF-16BE */
-  unsigned char **langtags;	/* UTF-16BE */
-} Name_table;
 
-typedef struct {
-  unsigned long Table_version_number; /* = 0x00010000 */
-  unsigned long fontRevision;
-  unsigned long checkSumAdjustment;
-  unsigned long magicNumber;	/* = 0x5F0F3CF5 */
-  unsigned short flags;
-  unsigned short unitsPerEm;
-  unsigned long long created;
-  unsigned long long modified;
-  short xMin;
-  short yMin;
-  short xMax;
-  short yMax;
-  unsigned short macStyle;
-  unsigned short lowestRecPPEM;
-  short fontDirectionHint;
-  short indexToLocFormat;
-  short glyphDataFormat;
-} Head_table;
-
-
-/* read_8be -- read a big endian unsigned 64-bit number */
-static bool read_8be(FILE *f, unsigned long long *x)
+/* cmp_str -- compare two strings, for qsort */
+static int cmp_str(const void *a, const void *b)
 {
-  unsigned char s[8];
-
-  if (fread(s, 1, 8, f) != 8) return false;
-  *x = ((unsigned long long)s[0] << 56) |
-    ((unsigned long long)s[1] << 48) |
-    ((unsigned long long)s[2] << 40) |
-    ((unsigned long long)s[3] << 32) |
-    ((unsigned long long)s[4] << 24) |
-    ((unsigned long long)s[5] << 16) |
-    ((unsigned long long)s[6] << 8) |
-    (unsigned long long)s[7];
-  return true;
+  return strcmp(*(const char *const*)a, *(const char *const*)b);
 }
 
 
-/* read_4be -- read a big endian unsigned long */
-static bool read_4be(FILE *f, unsigned long *x)
+/* cmp_dir -- compare the directories of two URLs, for qsort */
+static int cmp_dir(const void *a, const void *b)
 {
-  unsigned char s[4];
+  const char *u = *(const char *const*)a, *v = *(const char *const*)b;
+  size_t m = url_dir(u), n = url_dir(v);
+  int c = memcmp(u, v, m < n ? m : n);
 
-  if (fread(s, 1, 4, f) != 4) return false;
-  *x = (s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3];
-  return true;
+  return c ? c : (m > n) - (m < n);
 }
 
 
-/* write_4le -- write a little endian unsigned long */
-static bool write_4le(FILE *f, unsigned long x)
+/* collapse_urls -- replace URLs that share a directory by that directory
+ *
+ * Only one level is collapsed: two or more different URLs in
+ * "http://a/b/" become "http://a/b/", but are not merged further with
+ * URLs in "http://a/". The directories are copied into *arena, which
+ * the caller must free.
+ */
+static void collapse_urls(const char *urls[], int n, char **arena)
 {
-  unsigned char s[4];
-
-  s[0] = x & 0x000000ff;
-  s[1] = (x & 0x0000ff00) >> 8;
-  s[2] = (x & 0x00ff0000) >> 16;
-  s[3] = x >> 24;
-  return fwrite(s, 1, 4, f) == 4;
+  size_t total = 1, dir;
+  bool distinct;
+  char *p;
+  int i, j, k;
+
+  for (i = 0; i < n; i++) total += url_dir(urls[i]) + 1;
+  if (!(*arena = p = malloc(total))) err(EX_OSERR, NULL);
+  qsort(urls, n, sizeof(*urls), cmp_dir);
+  for (i = 0; i < n; i = j) {
+    dir = url_dir(urls[i]);
+    distinct = false;
+    for (j = i + 1; j < n && cmp_dir(&urls[i], &urls[j]) == 0; j++)
+      if (strcmp(urls[i], urls[j]) != 0) distinct = true;
+    if (dir == 0 || !distinct) continue;
+    memcpy(p, urls[i], dir);
+    p[dir] = '\0';
+    for (k = i; k < j; k++) urls[k] = p;
+    p += dir + 1;
+  }
 }
 
 
-/* read_2be -- read a big endian unsigned short */
-static bool read_2be(FILE *f, unsigned short *x)
+/* cover_urls -- leave out URLs that another URL is a prefix of
+ *
+ * Returns the number of URLs that remain, sorted, at the start of
+ * urls. After sorting, a URL's prefixes come before it and so do all
+ * URLs that fall between them, which start with the same prefix. So
+ * the kept URLs are those that the last kept URL is not a prefix of,
+ * the same minimal set that walking a trie of the URLs would give.
+ */
+static int cover_urls(const char *urls[], int n)
 {
-  unsigned char s[2];
+  int i, m = 0;
 
-  if (fread(s, 1, 2, f) != 2) return false;
-  *x = (s[0] << 8) + s[1];
-  return true;
+  qsort(urls, n, sizeof(*urls), cmp_str);
+  for (i = 0; i < n; i++)
+    if (m == 0 || strncmp(urls[m-1], urls[i], strlen(urls[m-1])) != 0)
+      urls[m++] = urls[i];
+  return m;
 }
 
 
-/* read_2be_signed -- read a big endian short */
-static bool read_2be_signed(FILE *f, short *x)
+/* list_urls -- the URLs and those of the options, without covered ones
+ *
+ * Returns the number of URLs in *all, which the caller must free, as
+ * well as *arena, which holds any collapsed directories.
+ */
+static int list_urls(const options *opts, int nurls, char *const urls[],
+		     const char ***all, char **arena)
 {
-  unsigned char s[2];
-  union {short s; unsigned short u;} h;
+  int n = nurls + opts->nurls;
+
+  *arena = NULL;
+  if (!(*all = malloc((n ? n : 1) * sizeof(**all)))) err(EX_OSERR, NULL);
+  if (nurls) memcpy(*all, urls, nurls * sizeof(**all));
+  if (opts->nurls)
+    memcpy(*all + nurls, opts->urls, opts->nurls * sizeof(**all));
+  if (opts->collapse) collapse_urls(*all, n, arena);
+  return cover_urls(*all, n);
+}
+
 
-  if (fread(s, 1, 2, f) != 2) return false;
-  h.u = (s[0] << 8) + s[1];
-  *x = h.s;
-  return true;
+/* make_key -- the key in the cache for a font file, its URLs and options
+ *
+ * The options that change the EOT file, the version of mkeot, the face
+ * and the sorted URLs are hashed together with the bytes of the file
+ * as it was read, so that a hit needs no WOFF decoding and no copying
+ * of a face out of a collection.
+ */
+static void make_key(const options *opts, mapped_file file, long face,
+		     const char *const urls[], int nurls,
+		     char key[CACHE_KEYLEN + 1])
+{
+  size_t len, i;
+  char *params;
+  FILE *f;
+  int j;
+
+  if (!(f = open_memstream(&params, &len))) err(EX_OSERR, NULL);
+  fprintf(f, "%s %s%c%ld%c%d%d%d%d%c", PACKAGE, VERSION, '\0',
+	  face < 0 ? 0 : face, '\0', opts->subset, opts->xor, opts->verify,
+	  opts->fix, '\0');
+  for (i = 0; i < opts->nranges; i++)
+    fprintf(f, "%lx-%lx,", opts->ranges[i].first, opts->ranges[i].last);
+  for (j = 0; j < nurls; j++) fprintf(f, "%c%s", '\0', urls[j]);
+  if (fclose(f) != 0) err(EX_OSERR, NULL);
+  cache_key(file.data, file.size, params, len, key);
+  free(params);
 }
 
 
-/* write_2le -- write a little endian unsigned short */
-static bool write_2le(FILE *f, unsigned short x)
+/* convert -- write an EOT file with the given font and URLs to out
+ *
+ * Returns 0 on success, or else a sysexits code, with *msg set to an
+ * error message, or to NULL if errno describes the error.
+ */
+static int convert(const options *opts, mapped_file src,
+		   const char *const urls[], int nurls, int out,
+		   const char **msg)
 {
-  unsigned char s[2];
+  EOT_header header;
+  unsigned char *buf = NULL, *fixed = NULL, *subset = NULL;
+  size_t len;
+  eot_status e;
+  int status = 0;
 
-  s[0] = x & 0x00ff;
-  s[1] = x >> 8;
-  return fwrite(s, 1, 2, f) == 2;
+  /* Fill the EOT header with data from the font and with URLs */
+  eot_init_header(&header);
+  if ((e = eot_read_font(&header, src.data, src.size)) == EOT_OK &&
+      (e = eot_check_embedding(&header)) == EOT_OK)
+    e = eot_add_rootstrings(&header, urls, nurls);
+  if (e == EOT_OK && opts->verify && !opts->fix)
+    e = eot_verify_font(header.FontData, header.FontDataSize);
+  if (e == EOT_OK && opts->fix) e = eot_fix_checksums(&header, &fixed);
+  if (e == EOT_OK && opts->subset)
+    e = eot_subset_font_data(&header, opts->ranges, opts->nranges, &subset);
+  if (opts->xor) header.Flags |= TTEMBED_XORENCRYPTDATA;
+
+  if (e != EOT_OK) {
+    *msg = eot_strerror(e);
+    status = e == EOT_ERR_NOMEM ? EX_OSERR : EX_DATAERR;
+  } else {
+    /* Serialize the header into one buffer, then write the EOT file */
+    len = header.EOTSize - header.FontDataSize;
+    if (opts->template) len += EOT_TEMPLATE_PREFIX;
+    if (!(buf = malloc(len))) err(EX_OSERR, NULL);
+    if (opts->template) e = eot_write_template(&header, buf, len, &len);
+    else e = eot_write_header(&header, buf, len, &len);
+    if (e != EOT_OK || !write_eot(out, buf, len, &header, src, opts->xor))
+      status = EX_IOERR;
+  }
+
+  free(buf);
+  free(fixed);
+  free(subset);
+  eot_free_header(&header);
+  return status;
 }
 
 
-/* write_1 -- write one byte to file f */
-static bool write_1(FILE *f, unsigned char x)
+/* font_status -- the sysexits code for a libeot error, see convert() */
+static int font_status(eot_status e, const char **msg)
 {
-  return fwrite(&x, 1, 1, f) == 1;
+  *msg = eot_strerror(e);
+  return e == EOT_ERR_NOMEM ? EX_OSERR : EX_DATAERR;
 }
 
 
-/* read_1 -- read one byte from file f */
-static bool read_1(FILE *f, unsigned char *x)
+/* decode_source -- decode a WOFF or WOFF 2.0 file in memory
+ *
+ * Sets src->sfnt to the decoded font, or to the file itself if it is
+ * not WOFF. Returns 0 or a sysexits code, as convert().
+ */
+static int decode_source(font_source *src, const char **msg)
 {
-  return fread(x, 1, 1, f) == 1;
+  eot_status e;
+  size_t len;
+
+  e = eot_decode_woff(src->file.data, src->file.size, &src->woff, &len);
+  if (e == EOT_OK)
+    src->sfnt = (mapped_file){.data = src->woff, .size = len,
+			      .mapped = false, .fd = -1};
+  else if (e == EOT_ERR_SFNT)	/* Not WOFF */
+    src->sfnt = src->file;
+  else
+    return font_status(e, msg);
+  return 0;
 }
 
 
-/* initialize_EOT_header -- fill an EOT struct with consistent values */
-static void initialize_EOT_header(EOT_header *h)
+/* select_face -- get the font at index face, if sfnt is a collection
+ *
+ * A font in a collection is copied out of it, *data is set to that
+ * copy, which the caller must free, and *font points to it. Otherwise
+ * *font is sfnt itself and *data is NULL. Returns 0 or a sysexits
+ * code, as convert().
+ */
+static int select_face(mapped_file sfnt, long face, mapped_file *font,
+		       unsigned char **data, const char **msg)
 {
-  h->EOTSize = 120;
-  h->FontDataSize = 0;
-  h->Version = 0x00020002;
-  h->Flags = 0;
-  memset(h->FontPANOSE, 0, 10);
-  h->Charset = 0;
-  h->Italic = 0;
-  h->Weight = 400;		/* "normal" */
-  h->fsType = 0x0;		/* "installable" */
-  h->MagicNumber = 0x504C;
-  h->UnicodeRange1 = 0;
-  h->UnicodeRange2 = 0;
-  h->UnicodeRange3 = 0;
-  h->UnicodeRange4 = 0;
-  h->CodePageRange1 = 0;
-  h->CodePageRange2 = 0;
-  h->CheckSumAdjustment = 0;
-  h->Reserved1 = 0;
-  h->Reserved2 = 0;
-  h->Reserved3 = 0;
-  h->Reserved4 = 0;
-  h->Padding1 = 0;
-  h->FamilyNameSize = 0;
-  h->FamilyName = NULL;
-  h->Padding2 = 0;
-  h->StyleNameSize = 0;
-  h->StyleName = NULL;
-  h->Padding3 = 0;
-  h->VersionNameSize = 0;
-  h->VersionName = NULL;
-  h->Padding4 = 0;
-  h->FullNameSize = 0;
-  h->FullName = NULL;
-  h->Padding5 = 0;
-  h->RootStringSize = 0;
-  h->RootString = NULL;
-  h->RootStringCheckSum = 0;
-  h->EUDCCodePage = 0;
-  h->Padding6 = 0;
-  h->SignatureSize = 0;
-  h->Signature = NULL;
-  h->EUDCFlags = 0;
-  h->EUDCFontSize = 0;
-  h->EUDCFontData = NULL;
+  unsigned long n;
+  eot_status e;
+  size_t len;
+
+  *data = NULL;
+  *font = sfnt;
+  e = eot_count_faces(sfnt.data, sfnt.size, &n);
+  if (e == EOT_ERR_SFNT)	/* Not a collection */
+    e = face > 0 ? EOT_ERR_FACE : EOT_OK;
+  else if (e == EOT_OK &&
+	   (e = eot_extract_face(sfnt.data, sfnt.size, face < 0 ? 0 : face,
+				 data, &len)) == EOT_OK)
+    *font = (mapped_file){.data = *data, .size = len, .mapped = false,
+			  .fd = -1};
+  return e == EOT_OK ? 0 : font_status(e, msg);
 }
 
 
-/* write_EOT_header -- write an EOT header to file f */
-static bool write_EOT_header(FILE *f, EOT_header h)
+/* convert_source -- write an EOT file with the given font and URLs to out
+ *
+ * If the font file is a TrueType Collection, the font at index face
+ * (or the first, if face is -1) is used. With a cache, an EOT file
+ * that is already in the cache is copied from there, before the font
+ * is even decoded, and a new one is written to the cache first and
+ * then copied. If no file can be created in the cache, out is written
+ * directly. A source whose sfnt has no data yet is decoded here, and
+ * not changed, so that threads can share a decoded source. Returns 0
+ * or a sysexits code, as convert().
+ */
+static int convert_source(const options *opts, const font_source *source,
+			  long face, int nurls, char *const urls[], int out,
+			  const char **msg)
 {
-  if (!write_4le(f, h.EOTSize) ||
-      !write_4le(f, h.FontDataSize) ||
-      !write_4le(f, h.Version) ||
-      !write_4le(f, h.Flags) ||
-      fwrite(h.FontPANOSE, 1, 10, f) != 10 ||
-      !write_1(f, h.Charset) ||
-      !write_1(f, h.Italic) ||
-      !write_4le(f, h.Weight) ||
-      !write_2le(f, h.fsType) ||
-      !write_2le(f, h.MagicNumber) ||
-      !write_4le(f, h.UnicodeRange1) ||
-      !write_4le(f, h.UnicodeRange2) ||
-      !write_4le(f, h.UnicodeRange3) ||
-      !write_4le(f, h.UnicodeRange4) ||
-      !write_4le(f, h.CodePageRange1) ||
-      !write_4le(f, h.CodePageRange2) ||
-      !write_4le(f, h.CheckSumAdjustment) ||
-      !write_4le(f, h.Reserved1) ||
-      !write_4le(f, h.Reserved2) ||
-      !write_4le(f, h.Reserved3) ||
-      !write_4le(f, h.Reserved4) ||
-      !write_2le(f, h.Padding1) ||
-      !write_2le(f, h.FamilyNameSize) ||
-      fwrite(h.FamilyName, 1, h.FamilyNameSize, f) != h.FamilyNameSize ||
-      !write_2le(f, h.Padding2) ||
-      !write_2le(f, h.StyleNameSize) ||
-      fwrite(h.StyleName, 1, h.StyleNameSize, f) != h.StyleNameSize ||
-      !write_2le(f, h.Padding3) ||
-      !write_2le(f, h.VersionNameSize) ||
-      fwrite(h.VersionName, 1, h.VersionNameSize, f) != h.VersionNameSize ||
-      !write_2le(f, h.Padding4) ||
-      !write_2le(f, h.FullNameSize) ||
-      fwrite(h.FullName, 1, h.FullNameSize, f) != h.FullNameSize)
-    return false;
-
-  switch (h.Version) {
-  case 0x0001000:
-    break;
-  case 0x00020001:
-    if (!write_2le(f, h.Padding5) ||
-	!write_2le(f, h.RootStringSize) ||
-	fwrite(h.RootString, 1, h.RootStringSize, f) != h.RootStringSize)
-      return false;
-    break;
-  case 0x00020002:
-    if (!write_2le(f, h.Padding5) ||
-	!write_2le(f, h.RootStringSize) ||
-	fwrite(h.RootString, 1, h.RootStringSize, f) != h.RootStringSize ||
-	!write_4le(f, h.RootStringCheckSum) ||
-	!write_4le(f, h.EUDCCodePage) ||
-	!write_2le(f, h.Padding6) ||
-	!write_2le(f, h.SignatureSize) ||
-	fwrite(h.Signature, 1, h.SignatureSize, f) != h.SignatureSize ||
-	!write_4le(f, h.EUDCFlags) ||
-	!write_4le(f, h.EUDCFontSize) ||
-	fwrite(h.EUDCFontData, 1, h.EUDCFontSize, f) != h.EUDCFontSize)
-      return false;
-    break;
-  default:
-    assert(!"Cannot happen!");
+  char key[CACHE_KEYLEN + 1], *arena, *tmp;
+  unsigned char *data = NULL;
+  font_source src = *source;
+  mapped_file font;
+  unsigned long long t;
+  const char **all;
+  bool hit = false;
+  int n, fd, status = 0;
+
+  *msg = NULL;
+  src.woff = NULL;		/* Only free what is decoded here */
+  n = list_urls(opts, nurls, urls, &all, &arena);
+
+  if (opts->cache) {
+    t = stats_clock();
+    make_key(opts, src.file, face, all, n, key);
+    if (!cache_get(opts->cache, key, out, &hit)) status = EX_IOERR;
+    stats_phase(STATS_CACHE, t);
   }
-  return true;
+  if (status == 0 && !hit && !src.sfnt.data)
+    status = decode_source(&src, msg);
+  if (status == 0 && !hit)
+    status = select_face(src.sfnt, face, &font, &data, msg);
+  if (status == 0 && !hit) {
+    if (opts->cache && (fd = cache_create(opts->cache, &tmp)) != -1) {
+      if ((status = convert(opts, font, all, n, fd, msg)) == 0) {
+	t = stats_clock();
+	if (!cache_insert(opts->cache, key, fd, tmp, out)) status = EX_IOERR;
+	stats_phase(STATS_CACHE, t);
+      } else {
+	(void) close(fd);
+	(void) unlink(tmp);
+	free(tmp);
+      }
+    } else {
+      status = convert(opts, font, all, n, out, msg);
+    }
+  }
+
+  free(all);
+  free(arena);
+  free(data);
+  free(src.woff);
+  return status;
 }
 
 
-/* read_sfnt_header -- get the directory of tables of an OpenType font */
-static bool read_sfnt_header(FILE *f, sfnt_offset_table *h)
+/* make_eot -- write an EOT file with the font in path and URLs to out
+ *
+ * Returns 0 or a sysexits code, as convert().
+ */
+static int make_eot(const options *opts, const char *path, long face,
+		    int nurls, char *const urls[], int out, const char **msg)
 {
-  unsigned short i;
-
-  rewind(f);
-  if (!read_4be(f, &h->sfnt_version) ||
-      !read_2be(f, &h->numTables) ||
-      !read_2be(f, &h->searchRange) ||
-      !read_2be(f, &h->entrySelector) ||
-      !read_2be(f, &h->rangeShift)) return false;
-  if (h->sfnt_version != SFNT_OTTO &&
-      h->sfnt_version != SFNT_TRUE &&
-      h->sfnt_version != SFNT_TYP1 &&
-      h->sfnt_version != SFNT_VERSION_1_0) return false;
-  if (!(h->tables = malloc(h->numTables * sizeof(h->tables[0]))))
-    err(EX_OSERR, NULL);
-  for (i = 0; i < h->numTables; i++)
-    if (fread(h->tables[i].tag, 1, 4, f) != 4 ||
-	!read_4be(f, &h->tables[i].checkSum) ||
-	!read_4be(f, &h->tables[i].offset) ||
-	!read_4be(f, &h->tables[i].length)) return false;
-  return true;
+  font_source src = {.sfnt = {.data = NULL}, .woff = NULL};
+  unsigned long long t = stats_clock();
+  int status;
+
+  *msg = NULL;
+  if (!map_file(path, &src.file)) return EX_NOINPUT;
+  stats_phase(STATS_MAP, t);
+  status = convert_source(opts, &src, face, nurls, urls, out, msg);
+  if (!unmap_file(&src.file) && status == 0) status = EX_IOERR;
+  return status;
 }
 
 
-/* read_name_table -- find and read the Name table in an OpenType file */
-static bool read_name_table(FILE *f, sfnt_offset_table sfnt, Name_table *t)
+/* from_template -- write an EOT file made from a template and URLs to out
+ *
+ * The template's header gets the RootString inserted, its font data is
+ * copied as is, so the font is not parsed. Returns 0 or a sysexits
+ * code, as convert().
+ */
+static int from_template(const options *opts, const char *path, int nurls,
+			 char *const urls[], int out, const char **msg)
 {
-  unsigned short i = 0, j, k;
-  long offset;
-
-  /* Find the name table in the sfnt table directory and seek to it */
-  while (i < sfnt.numTables && memcmp(sfnt.tables[i].tag, "name", 4)) i++;
-  if (i >= sfnt.numTables) return false;
-  if (fseek(f, sfnt.tables[i].offset, SEEK_SET) != 0) return false;
-
-  /* Read the table */
-  if (!read_2be(f, &t->format) ||
-      !read_2be(f, &t->count) ||
-      !read_2be(f, &t->stringOffset)) return false;
-  t->nameRecord = malloc(t->count * sizeof(t->nameRecord[0]));
-  if (!t->nameRecord) err(EX_OSERR, NULL);
-  for (j = 0; j < t->count; j++) {
-    if (!read_2be(f, &t->nameRecord[j].platformID) ||
-	!read_2be(f, &t->nameRecord[j].encodingID) ||
-	!read_2be(f, &t->nameRecord[j].languageID) ||
-	!read_2be(f, &t->nameRecord[j].nameID) ||
-	!read_2be(f, &t->nameRecord[j].length) ||
-	!read_2be(f, &t->nameRecord[j].offset)) return false;
+  unsigned long long start = stats_clock();
+  unsigned char *header = NULL;
+  const char **all;
+  mapped_file src;
+  eot_template t;
+  eot_status e;
+  char *arena;
+  size_t len;
+  int n, status = 0;
+
+  *msg = NULL;
+  if (!map_file(path, &src)) return EX_NOINPUT;
+  stats_phase(STATS_MAP, start);
+  n = list_urls(opts, nurls, urls, &all, &arena);
+  if ((e = eot_read_template(&t, src.data, src.size)) == EOT_OK)
+    e = eot_template_header(&t, all, n, &header, &len);
+  start = stats_clock();
+  if (e != EOT_OK) {
+    *msg = eot_strerror(e);
+    status = e == EOT_ERR_NOMEM ? EX_OSERR : EX_DATAERR;
+  } else if (!write_all(out, header, len) ||
+	     !copy_range(src, EOT_TEMPLATE_PREFIX + t.fontdata,
+			 t.size - t.fontdata, out)) {
+    status = EX_IOERR;
   }
-  switch (t->format) {
-  case 0:
-    t->langTagCount = 0;
-    break;
-  case 1:
-    if (!read_2be(f, &t->langTagCount)) return false;
-    t->langTagRecord = malloc(t->langTagCount * sizeof(t->langTagRecord[0]));
-    if (!t->langTagRecord) err(EX_OSERR, NULL);
-    for (j = 0; j < t->langTagCount; j++) {
-      if (!read_2be(f, &t->langTagRecord[j].length) ||
-	  !read_2be(f, &t->langTagRecord[j].offset)) return false;
+  stats_phase(STATS_COPY, start);
+
+  free(header);
+  free(all);
+  free(arena);
+  if (!unmap_file(&src) && status == 0) status = EX_IOERR;
+  return status;
+}
+
+
+/* read_manifest -- read a batch manifest, one job per non-empty line
+ *
+ * Each line holds a font file, an output file and zero or more URLs,
+ * separated by white space. Lines starting with "#" are comments.
+ */
+static size_t read_manifest(FILE *f, long face, batch_job **jobs)
+{
+  size_t n = 0, alloc = 0, linesize = 0;
+  unsigned long lineno = 0;
+  char *line = NULL, *p, *save;
+  batch_job *job;
+  int maxargs;
+
+  *jobs = NULL;
+  while (getline(&line, &linesize, f) != -1) {
+    lineno++;
+    p = line + strspn(line, " \t\r\n");
+    if (*p == '\0' || *p == '#') continue;
+    if (n == alloc) {
+      alloc = alloc ? 2 * alloc : 64;
+      if (!(*jobs = realloc(*jobs, alloc * sizeof(**jobs))))
+	err(EX_OSERR, NULL);
     }
-    break;
-  default:
-    return false;
+    job = &(*jobs)[n++];
+    job->lineno = lineno;
+    job->face = face;
+    job->argc = 0;
+    maxargs = strlen(p) / 2 + 1;
+    if (!(job->line = strdup(p))) err(EX_OSERR, NULL);
+    if (!(job->argv = malloc(maxargs * sizeof(job->argv[0]))))
+      err(EX_OSERR, NULL);
+    for (p = strtok_r(job->line, " \t\r\n", &save); p;
+	 p = strtok_r(NULL, " \t\r\n", &save))
+      job->argv[job->argc++] = p;
   }
-  /* TODO: read only names we actually need? */
-  offset = ftell(f);
-  t->names = malloc(t->count * sizeof(t->names[0]));
-  if (!t->names) err(EX_OSERR, NULL);
-  for (j = 0; j < t->count; j++) {
-    if (fseek(f, offset + t->nameRecord[j].offset, SEEK_SET) != 0) return false;
-    t->names[j] = malloc(t->nameRecord[j].length * sizeof(t->names[j][0]));
-    if (!t->names[j]) err(EX_OSERR, NULL);
-    for (k = 0; k < t->nameRecord[j].length; k++)
-      if (!read_1(f, &t->names[j][k])) return false;
+  free(line);
+  if (ferror(f)) err(EX_IOERR, NULL);
+  return n;
+}
+
+
+/* run_job -- convert one font of a batch, report any error
+ *
+ * With --stats, the job's cost is added to sum.
+ */
+static void run_job(batch *b, batch_job *job, stats_summary *sum)
+{
+  const char *msg = NULL;
+  char *tmp;
+  int status, fd, e = 0;
+  stats s;
+
+  if (sum) stats_start(&s);
+  if (job->argc < 2) {
+    msg = "Expected a font file and an output file";
+    status = EX_DATAERR;
+  } else {
+    if (asprintf(&tmp, "%s.XXXXXX", job->argv[1]) == -1) err(EX_OSERR, NULL);
+    io_count.syscalls++;
+    if ((fd = mkstemp(tmp)) == -1) {
+      status = EX_CANTCREAT;
+      e = errno;
+    } else {
+      (void) fchmod(fd, b->mode);
+      io_count.syscalls += 3;	/* fchmod, close and rename */
+      if (b->source)
+	status = convert_source(b->opts, b->source, job->face,
+				job->argc - 2, job->argv + 2, fd, &msg);
+      else
+	status = make_eot(b->opts, job->argv[0], job->face, job->argc - 2,
+			  job->argv + 2, fd, &msg);
+      e = errno;
+      if (close(fd) != 0 && status == 0) {status = EX_IOERR; e = errno;}
+      if (status == 0 && rename(tmp, job->argv[1]) == -1) {
+	status = EX_CANTCREAT;
+	e = errno;
+      }
+      if (status != 0) (void) unlink(tmp);
+    }
+    free(tmp);
+  }
+  if (sum) {
+    stats_stop(&s);
+    stats_add(sum, &s);
+  }
+
+  if (status != 0) {
+    pthread_mutex_lock(&b->report_lock);
+    b->nfailed++;
+    if (b->status == 0) b->status = status;
+    if (b->source && msg)
+      warnx("%s: face %ld: %s", b->manifest, job->face, msg);
+    else if (b->source)
+      warnx("%s: face %ld: %s: %s", b->manifest, job->face, job->argv[1],
+	    strerror(e));
+    else if (msg)
+      warnx("%s:%lu: %s: %s", b->manifest, job->lineno,
+	    job->argc > 0 ? job->argv[0] : "", msg);
+    else
+      warnx("%s:%lu: %s: %s", b->manifest, job->lineno,
+	    job->argc > 1 ? job->argv[status == EX_NOINPUT ? 0 : 1] : "",
+	    strerror(e));
+    pthread_mutex_unlock(&b->report_lock);
   }
-  /* TODO: read lang tags */
-  return true;
 }
 
 
-/* is_english -- check if NameRecord n holds an English name */
-static bool is_english(Name_table table, unsigned short n)
+/* next_job -- take a job from our own queue, or steal from another's */
+static bool next_job(batch *b, int self, size_t *job)
 {
-  switch (table.nameRecord[n].platformID) {
-  case 0:			/* Unicode */
-    return false;
-  case 1:			/* Macintosh */
-    if (table.nameRecord[n].languageID >= 0x8000)
-      errx(EX_DATAERR, "Unsupported Name Table format.");
-    if (table.nameRecord[n].encodingID != 0)
-      errx(EX_DATAERR, "Unsupported encoding in Name Table.");
-    return table.nameRecord[n].languageID == 0;
-  case 2:			/* ISO (deprecated) */
-    return false;
-  case 3:			/* Windows */
-    if (table.nameRecord[n].languageID >= 0x8000)
-      errx(EX_DATAERR, "Unsupported Name Table format.");
-    if (table.nameRecord[n].encodingID != 1)
-      errx(EX_DATAERR, "Unsupported encoding in Name Table.");
-    return table.nameRecord[n].languageID == 0x0409;
-  case 4:			/* Custom */
-    return false;
-  default:
-    errx(EX_DATAERR, "Invalid PlatformID in Name Table.");
+  job_queue *q = &b->queues[self], *victim;
+  size_t head, tail, n;
+  int i;
+
+  pthread_mutex_lock(&q->lock);
+  if (q->head < q->tail) {
+    *job = q->head++;
+    pthread_mutex_unlock(&q->lock);
+    return true;
+  }
+  pthread_mutex_unlock(&q->lock);
+
+  /* Our queue is empty: steal the last half of some other worker's */
+  for (i = 1; i < b->nworkers; i++) {
+    victim = &b->queues[(self + i) % b->nworkers];
+    pthread_mutex_lock(&victim->lock);
+    n = (victim->tail - victim->head + 1) / 2;
+    victim->tail -= n;
+    head = victim->tail;
+    tail = head + n;
+    pthread_mutex_unlock(&victim->lock);
+    if (n == 0) continue;
+    pthread_mutex_lock(&q->lock);
+    *job = head;
+    q->head = head + 1;
+    q->tail = tail;
+    pthread_mutex_unlock(&q->lock);
+    return true;
   }
+  return false;
 }
 
 
-/* find_name -- find the English name with given ID in the Name table */
-static void find_name(Name_table table, unsigned short id,
-		      unsigned short *size, unsigned char **name)
+/* worker -- thread body: run jobs until all queues are empty
+ *
+ * With --stats, the costs of the jobs are first collected in the
+ * worker's own summary, which is added to the batch's at the end.
+ */
+static void *worker(void *arg)
 {
-  unsigned short i = 0, j, k;
+  worker_arg *w = arg;
+  stats_summary *all = w->b->opts->stats, sum;
+  size_t job;
+
+  if (all) stats_begin_summary(&sum);
+  while (next_job(w->b, w->self, &job))
+    run_job(w->b, &w->b->jobs[job], all ? &sum : NULL);
+  if (all) {
+    pthread_mutex_lock(&w->b->report_lock);
+    stats_merge(all, &sum);
+    pthread_mutex_unlock(&w->b->report_lock);
+  }
+  return NULL;
+}
 
-  while (i < table.count &&
-	 (table.nameRecord[i].nameID != id || !is_english(table, i))) i++;
-  if (i >= table.count) {
-    *size = 0;			/* Not found */
-  } else {
-    switch (table.nameRecord[i].platformID) {
-    case 1:			/* Macintosh */
-      *size = 2 * table.nameRecord[i].length;
-      *name = malloc(*size);
-      if (!*name) err(EX_OSERR, NULL);
-      for (j = 0, k = 0; j < table.nameRecord[i].length; j++) {
-	(*name)[k++] = table.names[i][j];
-	(*name)[k++] = '\0'; /* Simplistic Roman -> UTF-16LE */
-      }
-      break;
-    case 3:			/* Windows */
-      *size = table.nameRecord[i].length;
-      *name = malloc(*size);
-      for (j = 0; j < table.nameRecord[i].length; j++)
-	(*name)[j] = table.names[i][j];
-      break;
-    default:
-      assert(!"Cannot happen!");
-    }
+
+/* run_jobs -- run jobs with a pool of threads, then free them
+ *
+ * Errors are reported with the name of the manifest and the job's
+ * line number, or, if the jobs share a source, the collection and the
+ * face.
+ */
+static int run_jobs(const options *opts, const char *manifest,
+		    const font_source *source, batch_job *jobs, size_t njobs,
+		    int nworkers)
+{
+  worker_arg *args;
+  pthread_t *threads;
+  mode_t mask;
+  size_t i;
+  batch b;
+  int j;
+
+  if (nworkers <= 0) nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+  if (nworkers <= 0) nworkers = 1;
+  if ((size_t)nworkers > njobs) nworkers = njobs ? njobs : 1;
+
+  b.manifest = manifest;
+  b.source = source;
+  b.jobs = jobs;
+  b.opts = opts;
+  mask = umask(0);
+  (void) umask(mask);
+  b.mode = 0666 & ~mask;
+  b.nworkers = nworkers;
+  b.nfailed = 0;
+  b.status = 0;
+  pthread_mutex_init(&b.report_lock, NULL);
+  if (!(b.queues = malloc(nworkers * sizeof(b.queues[0]))) ||
+      !(args = malloc(nworkers * sizeof(args[0]))) ||
+      !(threads = malloc(nworkers * sizeof(threads[0]))))
+    err(EX_OSERR, NULL);
+
+  /* Give each worker an equal, contiguous share of the jobs to start with */
+  for (j = 0; j < nworkers; j++) {
+    pthread_mutex_init(&b.queues[j].lock, NULL);
+    b.queues[j].head = njobs * j / nworkers;
+    b.queues[j].tail = njobs * (j + 1) / nworkers;
+    args[j].b = &b;
+    args[j].self = j;
   }
+  for (j = 1; j < nworkers; j++)
+    if ((errno = pthread_create(&threads[j], NULL, worker, &args[j])) != 0)
+      err(EX_OSERR, NULL);
+  (void) worker(&args[0]);
+  for (j = 1; j < nworkers; j++) pthread_join(threads[j], NULL);
+
+  if (b.nfailed != 0)
+    warnx("%lu of %lu fonts could not be converted", b.nfailed,
+	  (unsigned long)njobs);
+
+  for (i = 0; i < njobs; i++) {free(b.jobs[i].line); free(b.jobs[i].argv);}
+  for (j = 0; j < nworkers; j++) pthread_mutex_destroy(&b.queues[j].lock);
+  pthread_mutex_destroy(&b.report_lock);
+  free(b.jobs);
+  free(b.queues);
+  free(args);
+  free(threads);
+  return b.status;
 }
 
 
-/* read_OS2_table -- find and read the OS/2 table in an OpenType file */
-static bool read_OS2_table(FILE *f, sfnt_offset_table sfnt, OS2_table *t)
+/* run_batch -- convert all fonts listed in a manifest with a pool of threads */
+static int run_batch(const options *opts, const char *manifest, long face,
+		     int nworkers)
 {
-  unsigned short i = 0;
-
-  /* Find the OS/2 table in the sfnt table directory and seek to it */
-  while (i < sfnt.numTables && memcmp(sfnt.tables[i].tag, "OS/2", 4)) i++;
-  if (i >= sfnt.numTables) return false;
-  if (fseek(f, sfnt.tables[i].offset, SEEK_SET) != 0) return false;
-
-  /* Read the table */
-  return read_2be(f, &t->version) &&
-    t->version <= 0x0004 &&
-    read_2be_signed(f, &t->xAvgCharWidth) &&
-    read_2be(f, &t->usWeightClass) &&
-    read_2be(f, &t->usWidthClass) &&
-    read_2be(f, &t->fsType) &&
-    read_2be_signed(f, &t->ySubscriptXSize) &&
-    read_2be_signed(f, &t->ySubscriptYSize) &&
-    read_2be_signed(f, &t->ySubscriptXOffset) &&
-    read_2be_signed(f, &t->ySubscriptYOffset) &&
-    read_2be_signed(f, &t->ySuperscriptXSize) &&
-    read_2be_signed(f, &t->ySuperscriptYSize) &&
-    read_2be_signed(f, &t->ySuperscriptXOffset) &&
-    read_2be_signed(f, &t->ySuperscriptYOffset) &&
-    read_2be_signed(f, &t->yStrikeoutSize) &&
-    read_2be_signed(f, &t->yStrikeoutPosition) &&
-    read_2be_signed(f, &t->sFamilyClass) &&
-    fread(t->panose, 1, 10, f) == 10 &&
-    read_4be(f, &t->ulUnicodeRange1) &&
-    read_4be(f, &t->ulUnicodeRange2) &&
-    read_4be(f, &t->ulUnicodeRange3) &&
-    read_4be(f, &t->ulUnicodeRange4) &&
-    fread(t->achVendID, 1, 4, f) == 4 &&
-    read_2be(f, &t->fsSelection) &&
-    read_2be(f, &t->usFirstCharIndex) &&
-    read_2be(f, &t->usLastCharIndex) &&
-    read_2be_signed(f, &t->sTypoAscender) &&
-    read_2be_signed(f, &t->sTypoDescender) &&
-    read_2be_signed(f, &t->sTypoLineGap) &&
-    read_2be(f, &t->usWinAscent) &&
-    read_2be(f, &t->usWinDescent) &&
-    read_4be(f, &t->ulCodePageRange1) &&
-    read_4be(f, &t->ulCodePageRange2) &&
-    read_2be_signed(f, &t->sxHeight) &&
-    read_2be_signed(f, &t->sCapHeight) &&
-    read_2be(f, &t->usDefaultChar) &&
-    read_2be(f, &t->usBreakChar) &&
-    read_2be(f, &t->usMaxContext);
+  batch_job *jobs;
+  size_t njobs;
+  FILE *f;
+
+  if (strcmp(manifest, "-") == 0) f = stdin;
+  else if (!(f = fopen(manifest, "r"))) err(EX_NOINPUT, "%s", manifest);
+  njobs = read_manifest(f, face, &jobs);
+  if (f != stdin) (void) fclose(f);
+  return run_jobs(opts, manifest, NULL, jobs, njobs, nworkers);
 }
 
 
-/* read_head_table -- find and read the head table in an OpenType file */
-static bool read_head_table(FILE *f, sfnt_offset_table sfnt, Head_table *t)
+/* run_faces -- convert all fonts of a collection with a pool of threads
+ *
+ * Font i of, e.g., dir/name.ttc is written to name-i.eot in the
+ * current directory. The file is mapped and, if it is WOFF, decoded
+ * only once, and the workers share it.
+ */
+static int run_faces(const options *opts, const char *path, int nurls,
+		     char *const urls[], int nworkers)
 {
-  unsigned short i = 0;
-
-  /* Find the OS/2 table in the sfnt table directory and seek to it */
-  while (i < sfnt.numTables && memcmp(sfnt.tables[i].tag, "head", 4)) i++;
-  if (i >= sfnt.numTables) return false;
-  if (fseek(f, sfnt.tables[i].offset, SEEK_SET) != 0) return false;
-
-  /* Read the table */
-  return read_4be(f, &t->Table_version_number) &&
-    read_4be(f, &t->fontRevision) &&
-    read_4be(f, &t->checkSumAdjustment) &&
-    read_4be(f, &t->magicNumber) &&
-    read_2be(f, &t->flags) &&
-    read_2be(f, &t->unitsPerEm) &&
-    read_8be(f, &t->created) &&
-    read_8be(f, &t->modified) &&
-    read_2be_signed(f, &t->xMin) &&
-    read_2be_signed(f, &t->yMin) &&
-    read_2be_signed(f, &t->xMax) &&
-    read_2be_signed(f, &t->yMax) &&
-    read_2be(f, &t->macStyle) &&
-    read_2be(f, &t->lowestRecPPEM) &&
-    read_2be_signed(f, &t->fontDirectionHint) &&
-    read_2be_signed(f, &t->indexToLocFormat) &&
-    read_2be_signed(f, &t->glyphDataFormat);
+  font_source src = {.woff = NULL};
+  const char *base, *dot, *msg;
+  unsigned long n, i;
+  batch_job *jobs;
+  eot_status e;
+  int len, status;
+
+  if (!map_file(path, &src.file)) err(EX_NOINPUT, "%s", path);
+  if ((status = decode_source(&src, &msg)) != 0)
+    errx(status, "%s: %s.", path, msg);
+  e = eot_count_faces(src.sfnt.data, src.sfnt.size, &n);
+  if (e == EOT_ERR_SFNT)
+    errx(EX_DATAERR, "%s: Not a TrueType Collection.", path);
+  if (e != EOT_OK) errx(EX_DATAERR, "%s: %s.", path, eot_strerror(e));
+
+  base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  dot = strrchr(base, '.');
+  len = dot && dot != base ? dot - base : (int)strlen(base);
+  if (!(jobs = malloc(n * sizeof(*jobs)))) err(EX_OSERR, NULL);
+  for (i = 0; i < n; i++) {
+    jobs[i].lineno = 0;
+    jobs[i].face = i;
+    jobs[i].argc = nurls + 2;
+    if (asprintf(&jobs[i].line, "%.*s-%lu.eot", len, base, i) == -1 ||
+	!(jobs[i].argv = malloc(jobs[i].argc * sizeof(*jobs[i].argv))))
+      err(EX_OSERR, NULL);
+    jobs[i].argv[0] = (char*)path;
+    jobs[i].argv[1] = jobs[i].line;
+    if (nurls) memcpy(jobs[i].argv + 2, urls, nurls * sizeof(*urls));
+  }
+  status = run_jobs(opts, path, &src, jobs, n, nworkers);
+  free(src.woff);
+  if (!unmap_file(&src.file) && status == 0) status = EX_IOERR;
+  return status;
 }
 
 
-/* read_some_opentype_data -- get data from a font that is needed for EOT */
-static bool read_some_opentype_data(FILE *f, EOT_header *header)
+/* add_range -- add code points first..last to the ranges to keep */
+static void add_range(options *opts, unsigned long first, unsigned long last)
 {
-  long size;
-  sfnt_offset_table sfnt;
-  OS2_table os2;
-  Name_table name;
-  Head_table head;
-
-  if (!read_sfnt_header(f, &sfnt)) return false;
-  if (!read_OS2_table(f, sfnt, &os2)) return false;
-  if (!read_name_table(f, sfnt, &name)) return false;
-  if (!read_head_table(f, sfnt, &head)) return false;
-
-  memcpy(header->FontPANOSE, os2.panose, 10);
-  header->Italic = os2.fsSelection & 0x01;
-  header->Weight = os2.usWeightClass;
-  header->fsType = os2.fsType;
-  header->UnicodeRange1 = os2.ulUnicodeRange1;
-  header->UnicodeRange2 = os2.ulUnicodeRange2;
-  header->UnicodeRange3 = os2.ulUnicodeRange3;
-  header->UnicodeRange4 = os2.ulUnicodeRange4;
-  header->CodePageRange1 = os2.ulCodePageRange1;
-  header->CodePageRange2 = os2.ulCodePageRange2;
-  header->CheckSumAdjustment = head.checkSumAdjustment;
-  find_name(name, 1, &header->FamilyNameSize, &header->FamilyName);
-  header->EOTSize += header->FamilyNameSize;
-  find_name(name, 2, &header->StyleNameSize, &header->StyleName);
-  header->EOTSize += header->StyleNameSize;
-  find_name(name, 5, &header->VersionNameSize, &header->VersionName);
-  header->EOTSize += header->VersionNameSize;
-  find_name(name, 4, &header->FullNameSize, &header->FullName);
-  header->EOTSize += header->FullNameSize;
-
-  if (fseek(f, 0, SEEK_END) != 0) return false;
-  if ((size = ftell(f)) == -1) return false;
-  header->FontDataSize = size;
-  header->EOTSize += header->FontDataSize;
-  return true;
+  eot_unicode_range *p;
+
+  p = realloc(opts->ranges, (opts->nranges + 1) * sizeof(*p));
+  if (!p) err(EX_OSERR, NULL);
+  opts->ranges = p;
+  opts->ranges[opts->nranges].first = first;
+  opts->ranges[opts->nranges++].last = last;
 }
 
 
-/* get_byte_checksum -- calculate checksum over rootstrings */
-static unsigned long get_byte_checksum(unsigned char* s, unsigned short len)
+/* parse_ranges -- parse a list of code points, such as "U+20-7E,U+4??"
+ *
+ * Items are separated by commas or white space and have the syntax of
+ * CSS's unicode-range: a code point, a range, or a code point with
+ * trailing "?" wildcards, all in hexadecimal. The "U+" is optional.
+ * A "#" starts a comment until the end of the line.
+ */
+static bool parse_ranges(const char *s, options *opts)
 {
-  int i;
-  unsigned long sum;
+  unsigned long first, last;
+  char *end;
+  int n;
+
+  for (;;) {
+    while (*s == ',' || isspace((unsigned char)*s)) s++;
+    if (*s == '#') {s += strcspn(s, "\n"); continue;}
+    if (!*s) return true;
+    if ((s[0] == 'U' || s[0] == 'u') && s[1] == '+') s += 2;
+    if (!isxdigit((unsigned char)*s) && *s != '?') return false;
+    first = strtoul(s, &end, 16);
+    if (end == s) first = 0;
+    for (n = 0, last = first; *end == '?'; end++, n++) {
+      first = first << 4;
+      last = (last << 4) | 0xF;
+    }
+    if (n == 0 && *end == '-') {
+      s = end + 1;
+      if ((s[0] == 'U' || s[0] == 'u') && s[1] == '+') s += 2;
+      if (!isxdigit((unsigned char)*s)) return false;
+      last = strtoul(s, &end, 16);
+    }
+    if (end - s > 6 || first > last || last > 0x10FFFF) return false;
+    if (*end && *end != ',' && *end != '#' && !isspace((unsigned char)*end))
+      return false;
+    add_range(opts, first, last);
+    s = end;
+  }
+}
 
-  for (i = 0, sum = 0; i < len; i++) sum += s[i];
-  return sum ^ 0x50475342;
+
+/* read_ranges -- get the characters to keep from a file or the argument */
+static void read_ranges(const char *arg, options *opts)
+{
+  char *text = NULL;
+  size_t len = 0;
+  FILE *f;
+  bool ok;
+
+  opts->subset = true;
+  if (!(f = fopen(arg, "r"))) {
+    if (!parse_ranges(arg, opts))
+      errx(EX_USAGE, "%s: not a file or a list of code points", arg);
+    return;
+  }
+  if (getdelim(&text, &len, '\0', f) == -1 && ferror(f))
+    err(EX_IOERR, "%s", arg);
+  (void) fclose(f);
+  ok = !text || parse_ranges(text, opts);
+  free(text);
+  if (!ok) errx(EX_DATAERR, "%s: invalid list of code points", arg);
 }
 
 
-/* add_rootstring -- add a URL to the EOT header */
-static void add_rootstring(char *url, EOT_header *h)
+/* read_urls -- add the URLs in a file ("-" is stdin) to the options
+ *
+ * The file has one URL per line. Empty lines and lines that start
+ * with "#" are ignored, as is white space around the URLs.
+ */
+static void read_urls(const char *path, options *opts)
 {
-  unsigned long j, len;
+  size_t linesize = 0, n, alloc = opts->nurls;
+  char *line = NULL, *p, **q;
+  FILE *f;
+
+  if (strcmp(path, "-") == 0) f = stdin;
+  else if (!(f = fopen(path, "r"))) err(EX_NOINPUT, "%s", path);
+  while (getline(&line, &linesize, f) != -1) {
+    p = line + strspn(line, " \t\r\n");
+    for (n = strlen(p); n > 0 && strchr(" \t\r\n", p[n-1]); n--);
+    if (n == 0 || *p == '#') continue;
+    if ((size_t)opts->nurls == alloc) {
+      alloc = alloc ? 2 * alloc : 64;
+      if (!(q = realloc(opts->urls, alloc * sizeof(*q)))) err(EX_OSERR, NULL);
+      opts->urls = q;
+    }
+    if (!(opts->urls[opts->nurls++] = strndup(p, n))) err(EX_OSERR, NULL);
+  }
+  free(line);
+  if (ferror(f)) err(EX_IOERR, "%s", path);
+  if (f != stdin) (void) fclose(f);
+}
 
-  assert(url);
-  len = 2 * strlen(url) + 2;
-  if (!(h->RootString = realloc(h->RootString, h->RootStringSize + len)))
-    err(EX_OSERR, NULL);
 
-  j = h->RootStringSize;
-  while (*url) {		/* Simplistic conversion to UTF-16LE */
-    h->RootString[j++] = *url;
-    h->RootString[j++] = '\0';
-    url++;
+/* parse_size -- parse a size such as "500M" or "2G", false if invalid */
+static bool parse_size(const char *s, unsigned long long *n)
+{
+  char *end;
+
+  if (!isdigit((unsigned char)*s)) return false;
+  *n = strtoull(s, &end, 10);
+  switch (*end) {
+  case 'k': case 'K': *n <<= 10; end++; break;
+  case 'm': case 'M': *n <<= 20; end++; break;
+  case 'g': case 'G': *n <<= 30; end++; break;
   }
-  h->RootString[j++] = '\0';
-  h->RootString[j++] = '\0';
-  h->RootStringSize += len;
-  h->RootStringCheckSum = get_byte_checksum(h->RootString, h->RootStringSize);
-  h->EOTSize += len;
+  return *end == '\0';
+}
+
+
+/* free_options -- free the ranges and URLs of the options, close the cache */
+static void free_options(options *opts)
+{
+  int i;
+
+  for (i = 0; i < opts->nurls; i++) free(opts->urls[i]);
+  free(opts->urls);
+  free(opts->ranges);
+  if (opts->cache) cache_close(opts->cache);
 }
 
 
 /* usage -- print usage message and exit */
 static void usage(char *progname)
 {
-  fprintf(stderr, "%s OTF-file [URL [URL...]]\n", progname);
+  fprintf(stderr, "%s [options] OTF-file [URL [URL...]]\n", progname);
+  fprintf(stderr, "%s [options] [--jobs N] --batch manifest\n", progname);
+  fprintf(stderr, "%s [options] [--jobs N] --all-faces TTC-file [URL...]\n",
+	  progname);
+  fprintf(stderr, "%s [options] --template template OTF-file\n", progname);
+  fprintf(stderr, "%s [URL options] --from-template template [URL...]\n",
+	  progname);
+  fprintf(stderr, "Options: --subset code-points|file, --xor,\n");
+  fprintf(stderr, "         --face N,\n");
+  fprintf(stderr, "         --verify-font, --fix-checksums,\n");
+  fprintf(stderr, "         --urls-from file, --collapse-urls,\n");
+  fprintf(stderr, "         --cache dir, --cache-size size, --cache-stats,\n");
+  fprintf(stderr, "         --stats json, --stats-file file\n");
   exit(1);
 }
 
 
 int main(int argc, char *argv[])
 {
-  FILE *f;
-  EOT_header header;
-  int i, c;
-
-  if (argc < 2 || argv[1][0] == '-') usage(argv[0]);
-  if (!(f = fopen(argv[1], "r"))) err(EX_DATAERR, "%s", argv[1]);
+  static const struct option longopts[] = {
+    {"all-faces", no_argument, NULL, 'a'},
+    {"batch", required_argument, NULL, 'b'},
+    {"cache", required_argument, NULL, 'k'},
+    {"cache-size", required_argument, NULL, 'l'},
+    {"cache-stats", no_argument, NULL, 'S'},
+    {"collapse-urls", no_argument, NULL, 'd'},
+    {"face", required_argument, NULL, 'f'},
+    {"fix-checksums", no_argument, NULL, 'c'},
+    {"from-template", required_argument, NULL, 'F'},
+    {"jobs", required_argument, NULL, 'j'},
+    {"stats", required_argument, NULL, 'T'},
+    {"stats-file", required_argument, NULL, 'o'},
+    {"subset", required_argument, NULL, 's'},
+    {"template", required_argument, NULL, 't'},
+    {"urls-from", required_argument, NULL, 'u'},
+    {"verify-font", no_argument, NULL, 'v'},
+    {"xor", no_argument, NULL, 'x'},
+    {NULL, 0, NULL, 0}
+  };
+  options opts = {.subset = false, .xor = false, .verify = false,
+		  .fix = false, .collapse = false, .template = false,
+		  .ranges = NULL, .nranges = 0, .urls = NULL, .nurls = 0,
+		  .cache = NULL, .stats = NULL};
+  const char *msg, *manifest = NULL, *cache_dir = NULL, *name;
+  const char *template = NULL, *from = NULL, *stats_file = NULL;
+  unsigned long long cache_size = CACHE_SIZE;
+  bool cache_stats = false, all_faces = false, want_stats = false;
+  int c, fd, status, nworkers = 0;
+  stats_summary summary;
+  unsigned long jobs;
+  long face = -1;
+  char *end;
+  cache eot_cache;
+  stats run;
+
+  while ((c = getopt_long(argc, argv, "+ab:cdf:j:k:l:o:s:t:u:vxF:ST:",
+			  longopts, NULL)) != -1)
+    switch (c) {
+    case 'b': manifest = optarg; break;
+    case 'x': opts.xor = true; break;
+    case 'v': opts.verify = true; break;
+    case 'c': opts.fix = true; break;
+    case 'd': opts.collapse = true; break;
+    case 'j':
+      jobs = strtoul(optarg, &end, 10);
+      if (*end || !isdigit((unsigned char)*optarg) || jobs == 0 ||
+	  jobs > INT_MAX) usage(argv[0]);
+      nworkers = jobs;
+      break;
+    case 's': read_ranges(optarg, &opts); break;
+    case 'u': read_urls(optarg, &opts); break;
+    case 'k': cache_dir = optarg; break;
+    case 'l': if (!parse_size(optarg, &cache_size)) usage(argv[0]); break;
+    case 'S': cache_stats = true; break;
+    case 't': template = optarg; break;
+    case 'F': from = optarg; break;
+    case 'a': all_faces = true; break;
+    case 'T':
+      if (strcmp(optarg, "json") != 0) usage(argv[0]);
+      want_stats = true;
+      break;
+    case 'o': stats_file = optarg; want_stats = true; break;
+    case 'f':
+      face = strtol(optarg, &end, 10);
+      if (*end || !isdigit((unsigned char)*optarg)) usage(argv[0]);
+      break;
+    default: usage(argv[0]);
+    }
 
-  /* Fill the EOT header with data from the font and with URLs */
-  initialize_EOT_header(&header);
-  if (!read_some_opentype_data(f, &header))
-    errx(EX_DATAERR, "Could not read font file %s.", argv[1]);
-  for (i = 2; i < argc; i++) add_rootstring(argv[i], &header);
-
-  /* Write the EOT file, first write the header, then copy the font file */
-  if (!(header.fsType & FSTYPE_EDITABLE) &&
-      !(header.fsType & FSTYPE_PREVIEW) &&
-      header.fsType & FSTYPE_RESTRICTED)
-    errx(EX_DATAERR, "%s does not allow embedding.", argv[1]);
-  if (header.fsType & FSTYPE_BITMAP)
-    errx(EX_DATAERR, "Unsupported (%s requires bitmap embedding).", argv[1]);
-  if (!write_EOT_header(stdout, header))
-    err(EX_IOERR, "Could not write EOT file");
-
-  rewind(f);
-  while ((c = getc(f)) != EOF)
-    if (putchar(c) == EOF) err(EX_IOERR, NULL);
-  if (ferror(f)) err(EX_IOERR, "%s", argv[1]);
-  if (fclose(f) != 0) err(EX_IOERR, "%s", argv[1]);
+  /* A template has no URLs, making an EOT file from it needs no font */
+  if (template && (manifest || from || opts.nurls || optind != argc - 1))
+    usage(argv[0]);
+  if (all_faces && (manifest || template || from || face >= 0))
+    usage(argv[0]);
+  if (from && (manifest || face >= 0 || opts.subset || opts.xor ||
+	       opts.verify || opts.fix))
+    usage(argv[0]);
+  if (!from && (manifest ? optind != argc : optind >= argc)) usage(argv[0]);
+  if (cache_dir && !template && !from) {
+    if (!cache_open(&eot_cache, cache_dir, cache_size))
+      err(EX_CANTCREAT, "%s", cache_dir);
+    opts.cache = &eot_cache;
+  }
 
+  name = from ? from : argv[optind];
+  if (want_stats && (manifest || all_faces)) {
+    stats_begin_summary(&summary);
+    opts.stats = &summary;
+  } else if (want_stats) {
+    stats_start(&run);
+  }
+  if (manifest) {
+    status = run_batch(&opts, manifest, face, nworkers);
+  } else if (all_faces) {
+    status = run_faces(&opts, name, argc - optind - 1, argv + optind + 1,
+		       nworkers);
+  } else if (from) {
+    status = from_template(&opts, from, argc - optind, argv + optind,
+			   STDOUT_FILENO, &msg);
+  } else if (template) {
+    if ((fd = open(template, O_WRONLY | O_CREAT | O_TRUNC, 0666)) == -1)
+      err(EX_CANTCREAT, "%s", template);
+    opts.template = true;
+    status = make_eot(&opts, name, face, 0, NULL, fd, &msg);
+    if (close(fd) == -1 && status == 0) status = EX_IOERR;
+    io_count.syscalls += 2;
+  } else {
+    status = make_eot(&opts, name, face, argc - optind - 1,
+		      argv + optind + 1, STDOUT_FILENO, &msg);
+  }
+  if (want_stats && !opts.stats) stats_stop(&run);
+  if (want_stats && !stats_write(stats_file, "mkeot", &run, opts.stats))
+    err(EX_CANTCREAT, "%s", stats_file ? stats_file : "stats");
+  if (cache_stats && opts.cache)
+    warnx("cache: %lu hits, %lu misses, %lu evictions", eot_cache.hits,
+	  eot_cache.misses, eot_cache.evictions);
+  free_options(&opts);
+  if (manifest || all_faces) return status;
+  if (status == EX_NOINPUT) err(EX_DATAERR, "%s", name);
+  if (status != 0 && msg) errx(status, "%s: %s.", name, msg);
+  if (status != 0) err(status, "Could not write EOT file");
   return 0;
 }
@@ -0,0 +1,760 @@
+/* mkeotd -- a server that makes EOT files from fonts it keeps parsed
+ *
+ * mkeotd listens on a Unix domain socket. A request names a font in
+ * the font directory and lists URLs, the reply is the EOT file for
+ * that font and those URLs. A font is parsed (and obfuscated, with
+ * --xor) only once and kept, with its EOT header, in a cache of the
+ * most recently used fonts. A request for a font in the cache thus
+ * only converts the URLs, serializes the header and sends it, followed
+ * by the font data.
+ *
+ * A request is a line with the name of a font file, relative to the
+ * font directory, followed by lines with URLs (in UTF-8) and an empty
+ * line. The reply is a line "OK n" followed by the n bytes of the EOT
+ * file, or a line "ERR message". Lines end with LF, a CR before it is
+ * ignored. A client may send several requests on one connection, also
+ * without waiting for the replies.
+ *
+ * One thread serves all connections, with epoll. Fonts that are not in
+ * the cache are read and parsed by a second thread, so that other
+ * clients are served in the meantime; the client that asked for the
+ * font waits, and its later requests with it. The loader reports the
+ * fonts it is done with through an eventfd. A font whose file was
+ * changed or replaced (different inode, size or modification time) is
+ * parsed again.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sysexits.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include "eot.h"
+#include "mapfile.h"
+
+#define NFONTS 64			/* Default of --fonts */
+#define MAX_REQUEST (1024 * 1024)	/* Longest request line + URLs */
+#define READ_SIZE 65536			/* Bytes to read at a time */
+#define MAX_EVENTS 64			/* Events per epoll_wait */
+
+typedef struct font {		/* A parsed font, ready for URLs */
+  char *name;
+  struct font *next;		/* The next font in the same bucket */
+  struct font *newer, *older;	/* Neighbours in order of last use */
+  unsigned refs;		/* The cache + replies that are being sent */
+  struct stat st;		/* To see if the file has changed */
+  mapped_file file;		/* Only mapped if FontData points into it */
+  unsigned char *payload;	/* Obfuscated data, or NULL */
+  EOT_header header;		/* Without RootString */
+} font;
+
+typedef struct load {		/* A request that waits for a font */
+  struct load *next;
+  struct client *client;	/* NULL once the client is closed */
+  font *font;			/* The result, or NULL */
+  const char *msg;		/* Or the error */
+  int nurls;
+  const char **urls;		/* Copies, in the same allocation */
+  char name[];
+} load;
+
+typedef struct client {		/* A connection */
+  int fd;
+  struct client *prev, *next;
+  uint32_t events;		/* What epoll waits for */
+  bool eof;			/* No more requests will be handled */
+  char *in;			/* Received, but not yet handled */
+  size_t inlen, inalloc;
+  unsigned char *out;		/* Status line and EOT header to send */
+  size_t outlen, outpos, outalloc;
+  font *font;			/* Whose data follows out, or NULL */
+  size_t datapos;		/* How much of the data has been sent */
+  load *waiting;		/* The font being loaded for it, or NULL */
+} client;
+
+typedef struct {
+  bool xor;
+  int dir;			/* The font directory */
+  int sock, sig, epoll;
+  font **buckets;		/* Hash table of fonts, by name */
+  size_t nbuckets;		/* A power of 2 */
+  font *newest, *oldest;
+  size_t nfonts, maxfonts;
+  client *clients;
+  const char **urls;		/* The URLs of the current request */
+  int urlalloc;
+  int loaded;			/* eventfd, signals fonts in done */
+  load *todo, **todotail;	/* Queue for the loader */
+  load *done;			/* Loaded fonts, in any order */
+  pthread_mutex_t lock;		/* Protects todo and done */
+  pthread_cond_t more;		/* Signals a new load in todo */
+} server;
+
+
+/* hash -- FNV-1a hash of a string */
+static size_t hash(const char *s)
+{
+  size_t h = 2166136261U;
+
+  for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619U;
+  return h;
+}
+
+
+/* free_font -- unmap and free a font */
+static void free_font(font *f)
+{
+  eot_free_header(&f->header);
+  free(f->payload);
+  if (f->file.data) (void) unmap_file(&f->file);
+  free(f->name);
+  free(f);
+}
+
+
+/* release -- drop a reference to a font, free it if it was the last */
+static void release(font *f)
+{
+  if (--f->refs == 0) free_font(f);
+}
+
+
+/* detach -- remove a font from the list in order of use */
+static void detach(server *s, font *f)
+{
+  if (f->newer) f->newer->older = f->older; else s->newest = f->older;
+  if (f->older) f->older->newer = f->newer; else s->oldest = f->newer;
+}
+
+
+/* push -- put a font at the front of the list in order of use */
+static void push(server *s, font *f)
+{
+  f->newer = NULL;
+  f->older = s->newest;
+  if (s->newest) s->newest->newer = f; else s->oldest = f;
+  s->newest = f;
+}
+
+
+/* drop -- remove a font from the cache */
+static void drop(server *s, font *f)
+{
+  font **p = &s->buckets[hash(f->name) & (s->nbuckets - 1)];
+
+  while (*p != f) p = &(*p)->next;
+  *p = f->next;
+  detach(s, f);
+  s->nfonts--;
+  release(f);
+}
+
+
+/* valid_name -- check that a font name stays inside the font directory */
+static bool valid_name(const char *name)
+{
+  const char *p = name;
+
+  if (*name == '\0' || *name == '/') return false;
+  for (; *p; p += strcspn(p, "/"), p += *p == '/')
+    if (p[0] == '.' && p[1] == '.' && (p[2] == '/' || p[2] == '\0'))
+      return false;
+  return true;
+}
+
+
+/* load_font -- parse a font and make its EOT header
+ *
+ * Runs in the loader thread and only reads s->dir and s->xor. Returns
+ * NULL, or an error message if the font cannot be used.
+ */
+static const char *load_font(server *s, const char *name, font **result)
+{
+  const char *msg;
+  unsigned char *p;
+  eot_status e;
+  font *f;
+  int fd;
+
+  if ((fd = openat(s->dir, name, O_RDONLY | O_CLOEXEC)) == -1)
+    return strerror(errno);
+  if (!(f = calloc(1, sizeof(*f))) || !(f->name = strdup(name)))
+    err(EX_OSERR, NULL);
+  eot_init_header(&f->header);
+  if (fstat(fd, &f->st) == -1) msg = strerror(errno);
+  else if (!S_ISREG(f->st.st_mode)) msg = "not a regular file";
+  else if (!map_fd(fd, &f->file)) msg = strerror(errno);
+  else msg = NULL;
+  if (msg) {
+    (void) close(fd);
+    free_font(f);
+    return msg;
+  }
+
+  if ((e = eot_read_font(&f->header, f->file.data, f->file.size)) == EOT_OK)
+    e = eot_check_embedding(&f->header);
+  if (e == EOT_OK && s->xor) {
+    if (!(p = malloc(f->header.FontDataSize ? f->header.FontDataSize : 1)))
+      err(EX_OSERR, NULL);
+    eot_xor(p, f->header.FontData, f->header.FontDataSize);
+    f->payload = p;
+    f->header.FontData = p;
+    f->header.Flags |= TTEMBED_XORENCRYPTDATA;
+  }
+  if (e != EOT_OK) {
+    free_font(f);
+    return eot_strerror(e);
+  }
+  if (f->payload) {		/* The file is no longer needed */
+    (void) unmap_file(&f->file);
+    f->file.data = NULL;
+  }
+  f->refs = 1;
+  *result = f;
+  return NULL;
+}
+
+
+/* find_font -- get a font from the cache
+ *
+ * Sets *result to NULL if the font must be loaded first. Returns NULL,
+ * or an error message if the font cannot be used.
+ */
+static const char *find_font(server *s, const char *name, font **result)
+{
+  struct stat st;
+  font **b, *f;
+
+  if (!valid_name(name)) return "invalid font name";
+  if (fstatat(s->dir, name, &st, 0) == -1) return strerror(errno);
+  b = &s->buckets[hash(name) & (s->nbuckets - 1)];
+  for (f = *b; f && strcmp(f->name, name) != 0; f = f->next) ;
+
+  if (f && f->st.st_dev == st.st_dev && f->st.st_ino == st.st_ino &&
+      f->st.st_size == st.st_size &&
+      f->st.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+      f->st.st_mtim.tv_nsec == st.st_mtim.tv_nsec) {
+    detach(s, f);		/* Found, and still the same file */
+    push(s, f);
+    *result = f;
+    return NULL;
+  }
+  if (f) drop(s, f);		/* The file changed */
+  *result = NULL;
+  return NULL;
+}
+
+
+/* add_font -- put a loaded font in the cache, return the one to use
+ *
+ * If another request loaded the same file in the meantime, the font
+ * that is already in the cache is kept.
+ */
+static font *add_font(server *s, font *f)
+{
+  font **b = &s->buckets[hash(f->name) & (s->nbuckets - 1)], *g;
+
+  for (g = *b; g && strcmp(g->name, f->name) != 0; g = g->next) ;
+  if (g && g->st.st_dev == f->st.st_dev && g->st.st_ino == f->st.st_ino &&
+      g->st.st_size == f->st.st_size &&
+      g->st.st_mtim.tv_sec == f->st.st_mtim.tv_sec &&
+      g->st.st_mtim.tv_nsec == f->st.st_mtim.tv_nsec) {
+    release(f);
+    return g;
+  }
+  if (g) drop(s, g);
+  f->next = *b;
+  *b = f;
+  push(s, f);
+  if (++s->nfonts > s->maxfonts) drop(s, s->oldest);
+  return f;
+}
+
+
+/* loader -- thread that loads the fonts in the todo queue */
+static void *loader(void *arg)
+{
+  static const uint64_t one = 1;
+  server *s = arg;
+  load *l;
+
+  for (;;) {
+    pthread_mutex_lock(&s->lock);
+    while (!s->todo) pthread_cond_wait(&s->more, &s->lock);
+    l = s->todo;
+    if (!(s->todo = l->next)) s->todotail = &s->todo;
+    pthread_mutex_unlock(&s->lock);
+
+    l->font = NULL;
+    l->msg = load_font(s, l->name, &l->font);
+
+    pthread_mutex_lock(&s->lock);
+    l->next = s->done;
+    s->done = l;
+    pthread_mutex_unlock(&s->lock);
+    if (write(s->loaded, &one, sizeof(one)) == -1 && errno != EAGAIN)
+      err(EX_OSERR, "eventfd");
+  }
+  return NULL;
+}
+
+
+/* start_load -- let the loader load a font for a request of a client
+ *
+ * The name and the URLs are copied, because the client's input buffer
+ * may be reused before the font is loaded.
+ */
+static void start_load(server *s, client *c, const char *name,
+		       const char *const urls[], int n)
+{
+  size_t len = strlen(name) + 1, size = 0;
+  char *p;
+  load *l;
+  int i;
+
+  for (i = 0; i < n; i++) size += strlen(urls[i]) + 1;
+  if (!(l = malloc(sizeof(*l) + len + n * sizeof(*l->urls) + size)))
+    err(EX_OSERR, NULL);
+  memcpy(l->name, name, len);
+  l->urls = (const char **)(l->name + len);
+  p = (char *)(l->urls + n);
+  for (i = 0; i < n; i++) {
+    l->urls[i] = p;
+    p = stpcpy(p, urls[i]) + 1;
+  }
+  l->nurls = n;
+  l->client = c;
+  l->next = NULL;
+  c->waiting = l;
+  pthread_mutex_lock(&s->lock);
+  *s->todotail = l;
+  s->todotail = &l->next;
+  pthread_cond_signal(&s->more);
+  pthread_mutex_unlock(&s->lock);
+}
+
+
+/* reserve -- make sure the output buffer of a client can hold n bytes */
+static void reserve(client *c, size_t n)
+{
+  unsigned char *p;
+
+  if (n <= c->outalloc) return;
+  if (!(p = realloc(c->out, n))) err(EX_OSERR, NULL);
+  c->out = p;
+  c->outalloc = n;
+}
+
+
+/* reply_error -- queue an error message for a client */
+static void reply_error(client *c, const char *msg)
+{
+  reserve(c, strlen(msg) + 6);
+  c->outlen = sprintf((char*)c->out, "ERR %s\n", msg);
+  c->outpos = 0;
+}
+
+
+/* reply_font -- queue the EOT file for a font and URLs for a client
+ *
+ * The cached header is copied, so that only the RootString, its
+ * checksum and EOTSize change, and the copy is serialized after the
+ * status line. The font data is then sent from the cached font.
+ */
+static void reply_font(client *c, font *f, const char *const urls[], int n)
+{
+  EOT_header h;
+  eot_status e;
+  size_t len;
+
+  h = f->header;
+  if ((e = eot_add_rootstrings(&h, urls, n)) != EOT_OK) {
+    reply_error(c, eot_strerror(e));
+    return;
+  }
+  reserve(c, eot_header_size(&h) + 24);
+  c->outlen = sprintf((char*)c->out, "OK %lu\n", h.EOTSize);
+  e = eot_write_header(&h, c->out + c->outlen, c->outalloc - c->outlen,
+		       &len);
+  free(h.RootString);
+  if (e != EOT_OK) {
+    reply_error(c, eot_strerror(e));
+    return;
+  }
+  c->outlen += len;
+  c->outpos = 0;
+  c->font = f;
+  c->datapos = 0;
+  f->refs++;
+}
+
+
+/* reply -- queue the EOT file for a font and URLs, or start loading it */
+static void reply(server *s, client *c, const char *name,
+		  const char *const urls[], int n)
+{
+  const char *msg;
+  font *f = NULL;
+
+  if ((msg = find_font(s, name, &f))) reply_error(c, msg);
+  else if (f) reply_font(c, f, urls, n);
+  else start_load(s, c, name, urls, n);
+}
+
+
+/* next_request -- handle the first complete request a client sent
+ *
+ * Returns false if the input holds no complete request.
+ */
+static bool next_request(server *s, client *c)
+{
+  char *p, *q, *end = c->in + c->inlen, *name = NULL;
+  bool named = false;
+  size_t len;
+  int n = 0;
+
+  /* Find the empty line that ends the request before changing anything */
+  for (p = c->in; (q = memchr(p, '\n', end - p)); p = q + 1) {
+    len = q - p - (q > p && q[-1] == '\r');
+    if (len != 0) named = true;
+    else if (named) break;	/* Empty lines before the font are skipped */
+  }
+  if (!q) {
+    if (c->inlen < MAX_REQUEST) return false;
+    reply_error(c, "request too long");
+    c->inlen = 0;
+    c->eof = true;
+    return true;
+  }
+  end = q + 1;
+
+  /* Split it into lines, the first is the font, the rest are URLs */
+  for (p = c->in; p != end; p = q + 1) {
+    q = memchr(p, '\n', end - p);
+    *q = '\0';
+    if (q > p && q[-1] == '\r') q[-1] = '\0';
+    if (!*p) continue;
+    if (!name) {name = p; continue;}
+    if (n == s->urlalloc) {
+      s->urlalloc = s->urlalloc ? 2 * s->urlalloc : 64;
+      if (!(s->urls = realloc(s->urls, s->urlalloc * sizeof(*s->urls))))
+	err(EX_OSERR, NULL);
+    }
+    s->urls[n++] = p;
+  }
+  reply(s, c, name, s->urls, n);
+
+  c->inlen -= end - c->in;
+  memmove(c->in, end, c->inlen);
+  return true;
+}
+
+
+/* flush -- send as much of the reply as the socket takes
+ *
+ * Returns false if the connection failed.
+ */
+static bool flush(client *c)
+{
+  struct iovec iov[2];
+  size_t head;
+  ssize_t n;
+
+  while (c->outpos < c->outlen || c->font) {
+    head = c->outlen - c->outpos;
+    iov[0].iov_base = c->out + c->outpos;
+    iov[0].iov_len = head;
+    iov[1].iov_base = (void*)(c->font ? c->font->header.FontData + c->datapos
+			      : NULL);
+    iov[1].iov_len = c->font ? c->font->header.FontDataSize - c->datapos : 0;
+    if ((n = writev(c->fd, iov, 2)) == -1) {
+      if (errno == EINTR) continue;
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    if ((size_t)n < head) {
+      c->outpos += n;
+      continue;
+    }
+    c->outpos = c->outlen;
+    c->datapos += n - head;
+    if (c->font && c->datapos == c->font->header.FontDataSize) {
+      release(c->font);		/* All sent */
+      c->font = NULL;
+    }
+  }
+  return true;
+}
+
+
+/* watch -- tell epoll to wait for input or for room to send */
+static void watch(server *s, client *c, uint32_t events)
+{
+  struct epoll_event ev = {.events = events, .data.ptr = c};
+
+  if (c->events == events) return;
+  if (epoll_ctl(s->epoll, EPOLL_CTL_MOD, c->fd, &ev) == -1)
+    err(EX_OSERR, "epoll_ctl");
+  c->events = events;
+}
+
+
+/* close_client -- close a connection and free its buffers
+ *
+ * A font that is still being loaded for it is added to the cache
+ * when it is ready, but not sent.
+ */
+static void close_client(server *s, client *c)
+{
+  if (c->waiting) c->waiting->client = NULL;
+  (void) close(c->fd);
+  if (c->font) release(c->font);
+  if (c->prev) c->prev->next = c->next; else s->clients = c->next;
+  if (c->next) c->next->prev = c->prev;
+  free(c->in);
+  free(c->out);
+  free(c);
+}
+
+
+/* serve -- send replies to a client and handle its requests in turn
+ *
+ * While a font is loaded for the client, its connection is not
+ * watched (EPOLLET without events only reports a hang-up, once), so
+ * that neither its input nor a closed connection wake up epoll.
+ */
+static void serve(server *s, client *c)
+{
+  for (;;) {
+    if (!flush(c)) {close_client(s, c); return;}
+    if (c->outpos < c->outlen || c->font) {watch(s, c, EPOLLOUT); return;}
+    if (c->waiting) {watch(s, c, EPOLLET); return;}
+    if (!next_request(s, c)) break;
+  }
+  if (c->eof) close_client(s, c);
+  else watch(s, c, EPOLLIN);
+}
+
+
+/* receive -- read what a client sent, then serve it */
+static void receive(server *s, client *c)
+{
+  ssize_t n;
+  char *p;
+
+  while (!c->eof && c->inlen < MAX_REQUEST) {
+    if (c->inalloc - c->inlen < READ_SIZE) {
+      c->inalloc = c->inlen + READ_SIZE;
+      if (!(p = realloc(c->in, c->inalloc))) err(EX_OSERR, NULL);
+      c->in = p;
+    }
+    n = read(c->fd, c->in + c->inlen, c->inalloc - c->inlen);
+    if (n == -1 && errno == EINTR) continue;
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (n <= 0) c->eof = true;	/* End of file, or an error */
+    else c->inlen += n;
+  }
+  serve(s, c);
+}
+
+
+/* finish_loads -- reply to the clients whose fonts were loaded */
+static void finish_loads(server *s)
+{
+  uint64_t n;
+  load *l, *next;
+  client *c;
+  font *f;
+
+  if (read(s->loaded, &n, sizeof(n)) == -1 && errno != EAGAIN)
+    err(EX_OSERR, "eventfd");
+  pthread_mutex_lock(&s->lock);
+  l = s->done;
+  s->done = NULL;
+  pthread_mutex_unlock(&s->lock);
+
+  for (; l; l = next) {
+    next = l->next;
+    f = l->font ? add_font(s, l->font) : NULL;
+    if ((c = l->client)) {
+      c->waiting = NULL;
+      if (f) reply_font(c, f, l->urls, l->nurls);
+      else reply_error(c, l->msg);
+      serve(s, c);
+    }
+    free(l);
+  }
+}
+
+
+/* accept_clients -- accept all pending connections */
+static void accept_clients(server *s)
+{
+  struct epoll_event ev = {.events = EPOLLIN};
+  client *c;
+  int fd;
+
+  while ((fd = accept4(s->sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC))
+	 != -1) {
+    if (!(c = calloc(1, sizeof(*c)))) err(EX_OSERR, NULL);
+    c->fd = fd;
+    c->events = EPOLLIN;
+    ev.data.ptr = c;
+    if (epoll_ctl(s->epoll, EPOLL_CTL_ADD, fd, &ev) == -1)
+      err(EX_OSERR, "epoll_ctl");
+    if ((c->next = s->clients)) c->next->prev = c;
+    s->clients = c;
+  }
+  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+      errno != ECONNABORTED)
+    warn("accept");		/* E.g., too many open files: try later */
+}
+
+
+/* listen_on -- create a listening Unix domain socket at path */
+static int listen_on(const char *path)
+{
+  struct sockaddr_un addr = {.sun_family = AF_UNIX};
+  struct stat st;
+  int fd;
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+    errx(EX_USAGE, "%s: name too long", path);
+  strcpy(addr.sun_path, path);
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    (void) unlink(path);	/* Left by an earlier mkeotd */
+  if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0))
+      == -1 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+      listen(fd, SOMAXCONN) == -1)
+    err(EX_CANTCREAT, "%s", path);
+  return fd;
+}
+
+
+/* run -- serve clients until SIGINT or SIGTERM */
+static void run(server *s)
+{
+  struct epoll_event ev[MAX_EVENTS];
+  int i, n;
+
+  for (;;) {
+    if ((n = epoll_wait(s->epoll, ev, MAX_EVENTS, -1)) == -1) {
+      if (errno == EINTR) continue;
+      err(EX_OSERR, "epoll_wait");
+    }
+    for (i = 0; i < n; i++)
+      if (ev[i].data.ptr == &s->sig) return;
+      else if (ev[i].data.ptr == &s->sock) accept_clients(s);
+      else if (ev[i].data.ptr == &s->loaded) finish_loads(s);
+      else if (ev[i].events & EPOLLOUT) serve(s, ev[i].data.ptr);
+      else receive(s, ev[i].data.ptr);
+  }
+}
+
+
+/* usage -- print usage message and exit */
+static void usage(char *progname)
+{
+  fprintf(stderr, "%s [options] socket font-directory\n", progname);
+  fprintf(stderr, "Options: --xor, --fonts N\n");
+  exit(1);
+}
+
+
+int main(int argc, char *argv[])
+{
+  static const struct option longopts[] = {
+    {"fonts", required_argument, NULL, 'f'},
+    {"xor", no_argument, NULL, 'x'},
+    {NULL, 0, NULL, 0}
+  };
+  server s = {.xor = false, .maxfonts = NFONTS};
+  struct epoll_event ev = {.events = EPOLLIN};
+  pthread_t thread;
+  sigset_t sigs;
+  char *end;
+  int c;
+
+  while ((c = getopt_long(argc, argv, "f:x", longopts, NULL)) != -1)
+    switch (c) {
+    case 'f':
+      s.maxfonts = strtoul(optarg, &end, 10);
+      if (*end || !isdigit((unsigned char)*optarg) || s.maxfonts == 0)
+	usage(argv[0]);
+      break;
+    case 'x': s.xor = true; break;
+    default: usage(argv[0]);
+    }
+  if (optind != argc - 2) usage(argv[0]);
+
+  for (s.nbuckets = 16; s.nbuckets < 2 * s.maxfonts; s.nbuckets *= 2) ;
+  if (!(s.buckets = calloc(s.nbuckets, sizeof(*s.buckets))))
+    err(EX_OSERR, NULL);
+  if ((s.dir = open(argv[optind + 1], O_RDONLY | O_DIRECTORY | O_CLOEXEC))
+      == -1)
+    err(EX_NOINPUT, "%s", argv[optind + 1]);
+
+  /* SIGINT and SIGTERM arrive through epoll; writes to a closed socket
+   * return EPIPE instead of killing the server */
+  (void) signal(SIGPIPE, SIG_IGN);
+  sigemptyset(&sigs);
+  sigaddset(&sigs, SIGINT);
+  sigaddset(&sigs, SIGTERM);
+  if (sigprocmask(SIG_BLOCK, &sigs, NULL) == -1 ||
+      (s.sig = signalfd(-1, &sigs, SFD_CLOEXEC)) == -1)
+    err(EX_OSERR, "signalfd");
+
+  s.sock = listen_on(argv[optind]);
+  if ((s.epoll = epoll_create1(EPOLL_CLOEXEC)) == -1)
+    err(EX_OSERR, "epoll_create1");
+  ev.data.ptr = &s.sock;
+  if (epoll_ctl(s.epoll, EPOLL_CTL_ADD, s.sock, &ev) == -1)
+    err(EX_OSERR, "epoll_ctl");
+  ev.data.ptr = &s.sig;
+  if (epoll_ctl(s.epoll, EPOLL_CTL_ADD, s.sig, &ev) == -1)
+    err(EX_OSERR, "epoll_ctl");
+  if ((s.loaded = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+    err(EX_OSERR, "eventfd");
+  ev.data.ptr = &s.loaded;
+  if (epoll_ctl(s.epoll, EPOLL_CTL_ADD, s.loaded, &ev) == -1)
+    err(EX_OSERR, "epoll_ctl");
+
+  /* The loader is started after the signals are blocked, so that they
+   * arrive through the signalfd and not in the loader */
+  s.todotail = &s.todo;
+  pthread_mutex_init(&s.lock, NULL);
+  pthread_cond_init(&s.more, NULL);
+  if ((errno = pthread_create(&thread, NULL, loader, &s)) != 0)
+    err(EX_OSERR, NULL);
+
+  run(&s);
+
+  (void) unlink(argv[optind]);
+  while (s.clients) close_client(&s, s.clients);
+  while (s.oldest) drop(&s, s.oldest);
+  free(s.buckets);
+  free(s.urls);
+  return 0;
+}
@@ -0,0 +1,395 @@
+/* mtx -- MicroType Express decompression of TrueType fonts
+ *
+ * A compressed font was first transformed into the Compact Table
+ * Format (CTF), which splits it into three streams: the font itself,
+ * in which the glyf table holds glyphs with compactly encoded points
+ * and no instructions and the loca table is empty; the push stream,
+ * for the data that instructions push on the stack; and the code
+ * stream, with the TrueType instructions. Each stream was then
+ * compressed with LZCOMP. The data starts with a 10 byte header:
+ *
+ *   byte     version (= 3)
+ *   3 bytes  copy limit (size of the largest uncompressed stream)
+ *   3 bytes  offset of the compressed push stream
+ *   3 bytes  offset of the compressed code stream
+ *
+ * The values that the push instructions at the start of a glyph's
+ * instructions push are in the push stream; the decoder turns them
+ * back into push instructions. The cvt table is stored as deltas. The
+ * hdmx and VDMX tables have compressed forms too, which are not
+ * supported: fonts with them are rejected rather than decoded without
+ * them.
+ *
+ * Fonts without glyf table (CFF) are not transformed, but compressed
+ * as is.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include "mtx.h"
+#include "glyf.h"
+#include "lzcomp.h"
+#include "alloc.h"
+
+#define MTX_HEADER_SIZE 10
+
+#define NEGATIVE_CODE 250	/* 255Short: minus the number that follows */
+#define HOP3_CODE 251		/* Push stream: x1, x2, x1 */
+#define HOP4_CODE 252		/* Push stream: x1, x2, x1, x3, x1 */
+
+#define NPUSHB 0x40		/* TrueType push instructions */
+#define NPUSHW 0x41
+#define PUSHB_1 0xB0
+#define PUSHW_1 0xB8
+
+#define CVT_BASE 238		/* cvt: deltas below this are one byte */
+#define CVT_WORD_CODE 238	/* A 16 bit delta follows */
+#define CVT_NEG0 239		/* 239 + k: -(CVT_BASE * k + next byte) */
+#define CVT_POS1 248		/* 247 + k: CVT_BASE * k + next byte */
+
+
+/* table_data -- the data of a buffer, never NULL, so the table is kept */
+static const unsigned char *table_data(const buffer *b)
+{
+  return b->data ? b->data : (const unsigned char*)"";
+}
+
+
+/* rebuild_font -- write a font with new glyf, loca and cvt tables */
+static eot_status rebuild_font(sfnt_offset_table sfnt, const buffer *glyf,
+			       const buffer *loca, const buffer *cvt,
+			       buffer *out)
+{
+  sfnt_table changes[3] = {
+    {"glyf", table_data(glyf), glyf->length},
+    {"loca", table_data(loca), loca->length},
+    {"cvt ", table_data(cvt), cvt->length}
+  };
+
+  return rebuild_sfnt(sfnt, 3, changes, out);
+}
+
+
+/* decode_cvt -- read a cvt table coded as its size and deltas
+ *
+ * Each value is coded as the difference with the one before. Deltas
+ * from 0 to CVT_BASE - 1 take a byte, others up to 9 * CVT_BASE - 1
+ * either way a code for the multiple of CVT_BASE and a byte for the
+ * rest, and larger ones CVT_WORD_CODE and 16 bits.
+ */
+static bool decode_cvt(view *v, buffer *out)
+{
+  unsigned short i, n, value = 0, w;
+  unsigned char code, b;
+
+  if (!get_2be(v, &n)) return false;
+  for (i = 0; i < n; i++) {
+    if (!get_1(v, &code)) return false;
+    if (code < CVT_WORD_CODE) {
+      value += code;
+    } else if (code == CVT_WORD_CODE) {
+      if (!get_2be(v, &w)) return false;
+      value += w;
+    } else {
+      if (!get_1(v, &b)) return false;
+      if (code >= CVT_POS1) value += CVT_BASE * (code - CVT_POS1 + 1) + b;
+      else value -= CVT_BASE * (code - CVT_NEG0) + b;
+    }
+    buf_put_2be(out, value);
+  }
+  return true;
+}
+
+
+/* put_pushes -- append instructions that push n values
+ *
+ * Runs of values that fit in a byte are pushed with PUSHB or NPUSHB,
+ * other runs with PUSHW or NPUSHW.
+ */
+static void put_pushes(buffer *b, unsigned short n, const short *values)
+{
+  unsigned short i, j, k;
+  bool bytes;
+
+  for (i = 0; i < n; i += k) {
+    bytes = values[i] >= 0 && values[i] <= 255;
+    for (k = 1; i + k < n && k < 255 &&
+	   (values[i + k] >= 0 && values[i + k] <= 255) == bytes; k++);
+    if (k <= 8) {
+      buf_put_1(b, (bytes ? PUSHB_1 : PUSHW_1) + k - 1);
+    } else {
+      buf_put_1(b, bytes ? NPUSHB : NPUSHW);
+      buf_put_1(b, k);
+    }
+    for (j = i; j < i + k; j++)
+      if (bytes) buf_put_1(b, values[j]);
+      else buf_put_2be(b, values[j]);
+  }
+}
+
+
+/* get_255short -- read a signed number in 255Short format */
+static bool get_255short(view *v, short *x)
+{
+  unsigned char code;
+  unsigned short n;
+  bool negative;
+
+  if (v->pos >= v->length) return false;
+  code = v->data[v->pos];
+  if ((negative = code == NEGATIVE_CODE)) v->pos++;
+  if (v->pos >= v->length) return false;
+  code = v->data[v->pos];
+  if (code == NEGATIVE_CODE || code == HOP3_CODE || code == HOP4_CODE ||
+      !get_255ushort(v, &n)) return false;
+  *x = negative ? -(short)n : (short)n;
+  return true;
+}
+
+
+/* get_pushes -- read n values from the push stream, undoing hop codes */
+static bool get_pushes(view *push, unsigned short n, short *values)
+{
+  unsigned short i = 0;
+  unsigned char code;
+
+  while (i < n) {
+    if (push->pos >= push->length) return false;
+    code = push->data[push->pos];
+    if (code == HOP3_CODE) {
+      push->pos++;
+      if (i == 0 || n - i < 2 || !get_255short(push, &values[i])) return false;
+      values[i + 1] = values[i - 1];
+      i += 2;
+    } else if (code == HOP4_CODE) {
+      push->pos++;
+      if (i == 0 || n - i < 4 || !get_255short(push, &values[i]) ||
+	  !get_255short(push, &values[i + 2])) return false;
+      values[i + 1] = values[i + 3] = values[i - 1];
+      i += 4;
+    } else if (!get_255short(push, &values[i++])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* get_instructions -- read the instructions of a glyph into instr
+ *
+ * The glyph stream gives the number of values from the push stream
+ * and the number of bytes from the code stream. The values become
+ * push instructions in front of the code.
+ */
+static eot_status get_instructions(view *s, view *push, view *code,
+				   buffer *instr)
+{
+  unsigned short npush, ncode;
+  short *values;
+
+  if (!get_255ushort(s, &npush) || !get_255ushort(s, &ncode) ||
+      code->length - code->pos < ncode) return EOT_ERR_MTX;
+  instr->length = 0;
+  if (npush) {
+    if (!(values = counted_malloc(npush * sizeof(*values))))
+      return EOT_ERR_NOMEM;
+    if (!get_pushes(push, npush, values)) {free(values); return EOT_ERR_MTX;}
+    put_pushes(instr, npush, values);
+    free(values);
+  }
+  buf_put_bytes(instr, code->data + code->pos, ncode);
+  code->pos += ncode;
+  if (instr->failed) return EOT_ERR_NOMEM;
+  return instr->length > 0xFFFF ? EOT_ERR_MTX : EOT_OK;
+}
+
+
+/* decode_simple -- read a simple glyph from the CTF glyph stream */
+static eot_status decode_simple(view *s, short ncontours, view *push,
+				view *code, buffer *instr, buffer *glyf)
+{
+  unsigned short i, n;
+  unsigned long npoints = 0;
+  size_t start = s->pos;
+  simple_glyph g;
+  int x, y, dx, dy;
+  eot_status e;
+  view flags;
+
+  /* First count the points, then read them */
+  for (i = 0; i < ncontours; i++) {
+    if (!get_255ushort(s, &n) || n == 0) return EOT_ERR_MTX;
+    npoints += n;
+  }
+  if (npoints > 0xFFFF) return EOT_ERR_MTX;
+  if ((e = alloc_simple_glyph(&g, ncontours, npoints)) != EOT_OK) return e;
+  s->pos = start;
+  for (i = 0, npoints = 0; i < ncontours; i++) {
+    (void) get_255ushort(s, &n);
+    npoints += n;
+    g.endPtsOfContours[i] = npoints - 1;
+  }
+
+  e = EOT_ERR_MTX;
+  if (!make_view(s->data, s->length, s->pos, g.numPoints, &flags)) goto done;
+  s->pos += g.numPoints;
+  for (i = 0, x = y = 0; i < g.numPoints; i++) {
+    if (!get_triplet(flags.data[i], s, &dx, &dy)) goto done;
+    g.points[i].x = x += dx;
+    g.points[i].y = y += dy;
+    g.points[i].on_curve = !(flags.data[i] & 0x80);
+  }
+  if ((e = get_instructions(s, push, code, instr)) != EOT_OK) goto done;
+  g.instructionLength = instr->length;
+  g.instructions = instr->data;
+  compute_bbox(&g);
+  write_simple_glyph(glyf, &g);
+  e = EOT_OK;
+
+ done:
+  free_simple_glyph(&g);
+  return e;
+}
+
+
+/* decode_composite -- read a composite glyph from the CTF glyph stream */
+static eot_status decode_composite(view *s, view *push, view *code,
+				   buffer *instr, buffer *glyf)
+{
+  unsigned short flags, glyphIndex;
+  size_t start = s->pos;
+  bool has_instructions = false;
+  eot_status e;
+
+  if (s->length - s->pos < 8) return EOT_ERR_MTX; /* bbox */
+  s->pos += 8;
+  do {
+    if (!next_component(s, &flags, &glyphIndex)) return EOT_ERR_MTX;
+    if (flags & GLYF_WE_HAVE_INSTRUCTIONS) has_instructions = true;
+  } while (flags & GLYF_MORE_COMPONENTS);
+  buf_put_2be(glyf, 0xFFFF);
+  buf_put_bytes(glyf, s->data + start, s->pos - start);
+  if (has_instructions) {
+    if ((e = get_instructions(s, push, code, instr)) != EOT_OK) return e;
+    buf_put_2be(glyf, instr->length);
+    buf_put_bytes(glyf, instr->data, instr->length);
+  }
+  return EOT_OK;
+}
+
+
+/* ctf_decode -- rebuild a font from the three CTF streams */
+static eot_status ctf_decode(view main, view push, view code, buffer *out)
+{
+  sfnt_offset_table sfnt;
+  buffer glyf, loca, instr, cvt;
+  unsigned short i, nglyphs;
+  bool long_format;
+  short ncontours;
+  eot_status e;
+  view s, cvtv, dmx;
+
+  if ((e = read_sfnt_header(main.data, main.length, &sfnt)) != EOT_OK)
+    goto done;
+  if (!find_table(sfnt, "glyf", &s)) {
+    buf_put_bytes(out, main.data, main.length); /* Was not transformed */
+    e = out->failed ? EOT_ERR_NOMEM : EOT_OK;
+    goto done;
+  }
+  if (!get_glyf_info(sfnt, &nglyphs, &long_format)) {
+    e = EOT_ERR_MTX;
+    goto done;
+  }
+  if (find_table(sfnt, "hdmx", &dmx) || find_table(sfnt, "VDMX", &dmx)) {
+    e = EOT_ERR_MTX_TABLE;
+    goto done;
+  }
+
+  buf_init(&glyf);
+  buf_init(&loca);
+  buf_init(&instr);
+  buf_init(&cvt);
+  if (find_table(sfnt, "cvt ", &cvtv) && !decode_cvt(&cvtv, &cvt))
+    e = EOT_ERR_MTX;
+  for (i = 0; i < nglyphs && e == EOT_OK; i++) {
+    if (long_format) buf_put_4be(&loca, glyf.length);
+    else buf_put_2be(&loca, glyf.length / 2);
+    if (!get_2be_signed(&s, &ncontours)) e = EOT_ERR_MTX;
+    else if (ncontours > 0)
+      e = decode_simple(&s, ncontours, &push, &code, &instr, &glyf);
+    else if (ncontours == -1)
+      e = decode_composite(&s, &push, &code, &instr, &glyf);
+    else if (ncontours != 0) e = EOT_ERR_MTX;
+    while (glyf.length % (long_format ? 4 : 2)) buf_put_1(&glyf, 0);
+  }
+  if (long_format) buf_put_4be(&loca, glyf.length);
+  else buf_put_2be(&loca, glyf.length / 2);
+  if (e == EOT_OK && !long_format && glyf.length / 2 > 0xFFFF)
+    e = EOT_ERR_MTX;
+  if (e == EOT_OK && (glyf.failed || loca.failed || cvt.failed))
+    e = EOT_ERR_NOMEM;
+  if (e == EOT_OK) e = rebuild_font(sfnt, &glyf, &loca, &cvt, out);
+  free(glyf.data);
+  free(loca.data);
+  free(instr.data);
+  free(cvt.data);
+
+ done:
+  free_sfnt_header(&sfnt);
+  return e;
+}
+
+
+/* get_3be -- read a 24 bit big endian number */
+static bool get_3be(view *v, unsigned long *x)
+{
+  unsigned char b[3];
+
+  if (!get_bytes(v, b, 3)) return false;
+  *x = ((unsigned long)b[0] << 16) | (b[1] << 8) | b[2];
+  return true;
+}
+
+
+/* mtx_decompress -- decompress MTX data and append the font to out */
+eot_status mtx_decompress(const unsigned char *mtx, size_t size, buffer *out)
+{
+  unsigned long limit, offset2, offset3;
+  buffer main, push, code;
+  unsigned char version;
+  view v, block;
+  eot_status e;
+
+  if (!make_view(mtx, size, 0, size, &v) ||
+      !get_1(&v, &version) || version != MTX_VERSION ||
+      !get_3be(&v, &limit) || !get_3be(&v, &offset2) ||
+      !get_3be(&v, &offset3) || offset2 < MTX_HEADER_SIZE ||
+      offset3 < offset2 || offset3 > size) return EOT_ERR_MTX;
+
+  buf_init(&main);
+  buf_init(&push);
+  buf_init(&code);
+  (void) make_view(mtx, offset2, MTX_HEADER_SIZE, offset2 - MTX_HEADER_SIZE,
+		   &block);
+  if ((e = lzcomp_decompress(&block, &main)) != EOT_OK) goto done;
+  (void) make_view(mtx, offset3, offset2, offset3 - offset2, &block);
+  if ((e = lzcomp_decompress(&block, &push)) != EOT_OK) goto done;
+  (void) make_view(mtx, size, offset3, size - offset3, &block);
+  if ((e = lzcomp_decompress(&block, &code)) != EOT_OK) goto done;
+  if (main.length > limit || code.length > limit) {e = EOT_ERR_MTX; goto done;}
+  e = ctf_decode((view){main.data, main.length, 0},
+		 (view){push.data, push.length, 0},
+		 (view){code.data, code.length, 0}, out);
+
+ done:
+  free(main.data);
+  free(push.data);
+  free(code.data);
+  return e;
+}
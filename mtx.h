@@ -0,0 +1,17 @@
+/* mtx.h -- MicroType Express decompression of fonts (internal to libeot)
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef MTX_H
+#define MTX_H
+
+#include "sfnt.h"
+
+#define MTX_VERSION 3
+
+extern eot_status mtx_decompress(const unsigned char *mtx, size_t size,
+				 buffer *out);
+
+#endif /* MTX_H */
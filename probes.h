@@ -0,0 +1,28 @@
+/* probes.h -- static tracepoints (USDT) for perf, bpftrace or SystemTap
+ *
+ * If configure finds SystemTap's <sys/sdt.h>, each probe is a single
+ * nop in the code plus a note in the ELF file, which a tracer turns
+ * into a breakpoint only while it is attached. Without it, the probes
+ * compile to nothing. All probes are in the provider "eot", e.g.:
+ *
+ *   bpftrace -e 'usdt:./.libs/libeot.so:eot:table__entry { ... }'
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef PROBES_H
+#define PROBES_H
+
+#ifdef HAVE_SYS_SDT_H
+# include <sys/sdt.h>
+# define PROBE1(name, a) DTRACE_PROBE1(eot, name, a)
+# define PROBE2(name, a, b) DTRACE_PROBE2(eot, name, a, b)
+# define PROBE3(name, a, b, c) DTRACE_PROBE3(eot, name, a, b, c)
+#else
+# define PROBE1(name, a) do {} while (0)
+# define PROBE2(name, a, b) do {} while (0)
+# define PROBE3(name, a, b, c) do {} while (0)
+#endif
+
+#endif /* PROBES_H */
@@ -0,0 +1,833 @@
+/* sfnt -- read the tables of OpenType/TrueType fonts that EOT needs
+ *
+ * Author: Bert Bos <bert@w3.org>
+ * Created: 24 January 2010
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sfnt.h"
+#include "probes.h"
+#include "alloc.h"
+
+
+/* make_view -- make a view of len bytes at offset in data, if they exist */
+bool make_view(const unsigned char *data, size_t size,
+	       unsigned long offset, unsigned long len, view *v)
+{
+  if (offset > size || len > size - offset) return false;
+  v->data = data + offset;
+  v->length = len;
+  v->pos = 0;
+  return true;
+}
+
+
+/* get_8be -- read a big endian unsigned 64-bit number from a view */
+bool get_8be(view *v, unsigned long long *x)
+{
+  const unsigned char *s = v->data + v->pos;
+
+  if (v->length - v->pos < 8) return false;
+  *x = ((unsigned long long)s[0] << 56) |
+    ((unsigned long long)s[1] << 48) |
+    ((unsigned long long)s[2] << 40) |
+    ((unsigned long long)s[3] << 32) |
+    ((unsigned long long)s[4] << 24) |
+    ((unsigned long long)s[5] << 16) |
+    ((unsigned long long)s[6] << 8) |
+    (unsigned long long)s[7];
+  v->pos += 8;
+  return true;
+}
+
+
+/* get_4be -- read a big endian unsigned long from a view */
+bool get_4be(view *v, unsigned long *x)
+{
+  const unsigned char *s = v->data + v->pos;
+
+  if (v->length - v->pos < 4) return false;
+  *x = ((unsigned long)s[0] << 24) | (s[1] << 16) | (s[2] << 8) | s[3];
+  v->pos += 4;
+  return true;
+}
+
+
+/* get_2be -- read a big endian unsigned short from a view */
+bool get_2be(view *v, unsigned short *x)
+{
+  const unsigned char *s = v->data + v->pos;
+
+  if (v->length - v->pos < 2) return false;
+  *x = (s[0] << 8) + s[1];
+  v->pos += 2;
+  return true;
+}
+
+
+/* get_2be_signed -- read a big endian short from a view */
+bool get_2be_signed(view *v, short *x)
+{
+  union {short s; unsigned short u;} h;
+
+  if (!get_2be(v, &h.u)) return false;
+  *x = h.s;
+  return true;
+}
+
+
+/* get_4le -- read a little endian unsigned long from a view */
+bool get_4le(view *v, unsigned long *x)
+{
+  const unsigned char *s = v->data + v->pos;
+
+  if (v->length - v->pos < 4) return false;
+  *x = ((unsigned long)s[3] << 24) | (s[2] << 16) | (s[1] << 8) | s[0];
+  v->pos += 4;
+  return true;
+}
+
+
+/* get_2le -- read a little endian unsigned short from a view */
+bool get_2le(view *v, unsigned short *x)
+{
+  const unsigned char *s = v->data + v->pos;
+
+  if (v->length - v->pos < 2) return false;
+  *x = (s[1] << 8) + s[0];
+  v->pos += 2;
+  return true;
+}
+
+
+/* get_1 -- read one byte from a view */
+bool get_1(view *v, unsigned char *x)
+{
+  if (v->pos >= v->length) return false;
+  *x = v->data[v->pos++];
+  return true;
+}
+
+
+/* get_bytes -- copy n bytes from a view */
+bool get_bytes(view *v, void *x, size_t n)
+{
+  if (v->length - v->pos < n) return false;
+  memcpy(x, v->data + v->pos, n);
+  v->pos += n;
+  return true;
+}
+
+
+/* buf_init -- make an empty buffer */
+void buf_init(buffer *b)
+{
+  b->data = NULL;
+  b->length = b->alloc = 0;
+  b->failed = false;
+}
+
+
+/* buf_reserve -- make room for n more bytes, set failed if there is none */
+bool buf_reserve(buffer *b, size_t n)
+{
+  unsigned char *p;
+  size_t alloc;
+
+  if (b->failed) return false;
+  if (b->alloc - b->length >= n) return true;
+  alloc = b->alloc ? b->alloc : 4096;
+  while (alloc - b->length < n) alloc *= 2;
+  if (!(p = counted_realloc(b->data, alloc))) {b->failed = true; return false;}
+  b->data = p;
+  b->alloc = alloc;
+  return true;
+}
+
+
+/* buf_put_1 -- append one byte to a buffer */
+void buf_put_1(buffer *b, unsigned char x)
+{
+  if (buf_reserve(b, 1)) b->data[b->length++] = x;
+}
+
+
+/* buf_put_2be -- append a big endian unsigned short to a buffer */
+void buf_put_2be(buffer *b, unsigned short x)
+{
+  if (!buf_reserve(b, 2)) return;
+  b->data[b->length++] = x >> 8;
+  b->data[b->length++] = x & 0xff;
+}
+
+
+/* buf_put_4be -- append a big endian unsigned long to a buffer */
+void buf_put_4be(buffer *b, unsigned long x)
+{
+  if (!buf_reserve(b, 4)) return;
+  b->data[b->length++] = (x >> 24) & 0xff;
+  b->data[b->length++] = (x >> 16) & 0xff;
+  b->data[b->length++] = (x >> 8) & 0xff;
+  b->data[b->length++] = x & 0xff;
+}
+
+
+/* buf_put_bytes -- append n bytes to a buffer */
+void buf_put_bytes(buffer *b, const void *s, size_t n)
+{
+  if (n == 0 || !buf_reserve(b, n)) return;
+  memcpy(b->data + b->length, s, n);
+  b->length += n;
+}
+
+
+/* get_255ushort -- read a number in 255UShort format from a view */
+bool get_255ushort(view *v, unsigned short *x)
+{
+  unsigned char code, b;
+
+  if (!get_1(v, &code)) return false;
+  switch (code) {
+  case 253: return get_2be(v, x);
+  case 254: if (!get_1(v, &b)) return false; *x = b + 506; return true;
+  case 255: if (!get_1(v, &b)) return false; *x = b + 253; return true;
+  default: *x = code; return true;
+  }
+}
+
+
+/* set_4be -- store a big endian unsigned long at p */
+void set_4be(unsigned char *p, unsigned long x)
+{
+  p[0] = (x >> 24) & 0xff;
+  p[1] = (x >> 16) & 0xff;
+  p[2] = (x >> 8) & 0xff;
+  p[3] = x & 0xff;
+}
+
+
+/* compare_tags -- compare two sfnt_tables by tag, for qsort */
+static int compare_tags(const void *a, const void *b)
+{
+  return memcmp(((const sfnt_table*)a)->tag, ((const sfnt_table*)b)->tag, 4);
+}
+
+
+/* build_sfnt -- make a font from a list of tables
+ *
+ * The tables are sorted, padded to a multiple of 4 bytes and given
+ * new checksums, and head.checkSumAdjustment is recomputed.
+ */
+eot_status build_sfnt(unsigned long sfnt_version, int ntables,
+		      const sfnt_table tables[], buffer *out)
+{
+  unsigned short searchRange = 1, entrySelector = 0;
+  unsigned long offset, sum;
+  size_t start = out->length, head = 0;
+  sfnt_table *sorted;
+  int i;
+
+  if (!(sorted = counted_malloc(ntables * sizeof(sorted[0]))))
+    return EOT_ERR_NOMEM;
+  memcpy(sorted, tables, ntables * sizeof(sorted[0]));
+  qsort(sorted, ntables, sizeof(sorted[0]), compare_tags);
+
+  while (2 * searchRange <= ntables) {searchRange *= 2; entrySelector++;}
+  buf_put_4be(out, sfnt_version);
+  buf_put_2be(out, ntables);
+  buf_put_2be(out, 16 * searchRange);
+  buf_put_2be(out, entrySelector);
+  buf_put_2be(out, 16 * ntables - 16 * searchRange);
+
+  /* The checksum of head is computed with checkSumAdjustment set to 0 */
+  offset = 12 + 16 * ntables;
+  for (i = 0; i < ntables; i++) {
+    sum = table_checksum(sorted[i].data, sorted[i].length);
+    if (memcmp(sorted[i].tag, "head", 4) == 0 && sorted[i].length >= 12)
+      sum -= table_checksum(sorted[i].data + 8, 4);
+    buf_put_bytes(out, sorted[i].tag, 4);
+    buf_put_4be(out, sum & 0xFFFFFFFF);
+    buf_put_4be(out, offset);
+    buf_put_4be(out, sorted[i].length);
+    offset += (sorted[i].length + 3) & ~3UL;
+  }
+  for (i = 0; i < ntables; i++) {
+    if (memcmp(sorted[i].tag, "head", 4) == 0) head = out->length;
+    buf_put_bytes(out, sorted[i].data, sorted[i].length);
+    while ((out->length - start) % 4) buf_put_1(out, 0);
+  }
+  free(sorted);
+  if (out->failed) return EOT_ERR_NOMEM;
+
+  /* Set checkSumAdjustment so that the whole font sums to 0xB1B0AFBA */
+  if (head && out->length >= head + 12) {
+    memset(out->data + head + 8, 0, 4);
+    sum = 0xB1B0AFBA - table_checksum(out->data + start, out->length - start);
+    set_4be(out->data + head + 8, sum);
+  }
+  return EOT_OK;
+}
+
+
+/* rebuild_sfnt -- copy a font to out, with some tables replaced or removed
+ *
+ * A table of the font that has the same tag as one of the n tables in
+ * changes is replaced by it, or left out if its data is NULL.
+ */
+eot_status rebuild_sfnt(sfnt_offset_table sfnt, int n,
+			const sfnt_table changes[], buffer *out)
+{
+  sfnt_table *tables;
+  int i, j, ntables = 0;
+  unsigned long tag;
+  eot_status e = EOT_OK;
+  view v;
+
+  if (!(tables = counted_malloc((sfnt.numTables + 1) * sizeof(tables[0]))))
+    return EOT_ERR_NOMEM;
+  for (i = 0; i < sfnt.numTables && e == EOT_OK; i++) {
+    tag = sfnt.tables[i].tag;
+    for (j = 0; j < n && pack_tag(changes[j].tag) != tag; j++);
+    if (j < n) {
+      if (changes[j].data) tables[ntables++] = changes[j];
+    } else if (make_view(sfnt.font, sfnt.size, sfnt.tables[i].offset,
+			 sfnt.tables[i].length, &v)) {
+      tables[ntables].tag[0] = tag >> 24;
+      tables[ntables].tag[1] = (tag >> 16) & 0xFF;
+      tables[ntables].tag[2] = (tag >> 8) & 0xFF;
+      tables[ntables].tag[3] = tag & 0xFF;
+      tables[ntables].data = v.data;
+      tables[ntables++].length = v.length;
+    } else {
+      e = EOT_ERR_TRUNCATED;
+    }
+  }
+  if (e == EOT_OK) e = build_sfnt(sfnt.sfnt_version, ntables, tables, out);
+  free(tables);
+  return e;
+}
+
+
+/* compare_records -- compare two table records by tag, for qsort */
+static int compare_records(const void *a, const void *b)
+{
+  unsigned long s = ((const sfnt_table_record*)a)->tag;
+  unsigned long t = ((const sfnt_table_record*)b)->tag;
+
+  return s < t ? -1 : s > t;
+}
+
+
+/* verify_sfnt -- check the table checksums and checkSumAdjustment
+ *
+ * The checksum of head is computed as if its checkSumAdjustment was 0.
+ */
+eot_status verify_sfnt(sfnt_offset_table sfnt)
+{
+  unsigned long sum, adjustment = 0;
+  const sfnt_table_record *r;
+  unsigned short i;
+  bool head = false;
+  view v;
+
+  for (i = 0; i < sfnt.numTables; i++) {
+    r = &sfnt.tables[i];
+    if (!make_view(sfnt.font, sfnt.size, r->offset, r->length, &v))
+      return EOT_ERR_TRUNCATED;
+    sum = table_checksum(v.data, v.length);
+    if (r->tag == pack_tag("head") && v.length >= 12) {
+      adjustment = table_checksum(v.data + 8, 4);
+      sum = (sum - adjustment) & 0xFFFFFFFF;
+      head = true;
+    }
+    if (sum != r->checkSum) return EOT_ERR_TABLE_CHECKSUM;
+  }
+  if (head && table_checksum(sfnt.font, sfnt.size) != 0xB1B0AFBA)
+    return EOT_ERR_FONT_CHECKSUM;
+  return EOT_OK;
+}
+
+
+/* fix_sfnt_checksums -- recompute the checksums of a font in place
+ *
+ * Sets the checkSum of every table in the table directory and then
+ * head.checkSumAdjustment. Nothing else is changed.
+ */
+eot_status fix_sfnt_checksums(unsigned char *font, size_t size)
+{
+  unsigned long tag, offset, length, sum;
+  unsigned short numTables, i;
+  size_t head = 0;
+  view v, t;
+
+  if (!make_view(font, size, 4, 2, &v) || !get_2be(&v, &numTables))
+    return EOT_ERR_SFNT;
+  if (!make_view(font, size, 12, 16UL * numTables, &v))
+    return EOT_ERR_TRUNCATED;
+  for (i = 0; i < numTables; i++) {
+    (void) get_4be(&v, &tag);
+    v.pos += 4;
+    (void) get_4be(&v, &offset);
+    (void) get_4be(&v, &length);
+    if (!make_view(font, size, offset, length, &t)) return EOT_ERR_TRUNCATED;
+    if (tag == pack_tag("head") && length >= 12) {
+      head = offset;
+      memset(font + offset + 8, 0, 4);
+    }
+    sum = table_checksum(t.data, t.length);
+    set_4be(font + 12 + 16 * i + 4, sum);
+  }
+  if (head) set_4be(font + head + 8, 0xB1B0AFBA - table_checksum(font, size));
+  return EOT_OK;
+}
+
+
+/* read_sfnt_directory -- get the directory of tables at offset in a file
+ *
+ * The directory is read in one pass into an index sorted by tag, for
+ * lookup_table(). Fonts are supposed to have their tables sorted
+ * already, so it only needs sorting if the font is wrong. The tables
+ * themselves are not read until they are looked up. The offsets of
+ * the tables are from the start of the file, also in a collection.
+ */
+eot_status read_sfnt_directory(const unsigned char *font, size_t size,
+			       unsigned long offset, sfnt_offset_table *h)
+{
+  bool sorted = true;
+  unsigned short i;
+  view v;
+
+  h->font = font;
+  h->size = size;
+  h->tables = NULL;
+  if (!make_view(font, size, offset, 12, &v) ||
+      !get_4be(&v, &h->sfnt_version) ||
+      !get_2be(&v, &h->numTables) ||
+      !get_2be(&v, &h->searchRange) ||
+      !get_2be(&v, &h->entrySelector) ||
+      !get_2be(&v, &h->rangeShift)) return EOT_ERR_SFNT;
+  if (h->sfnt_version != SFNT_OTTO &&
+      h->sfnt_version != SFNT_TRUE &&
+      h->sfnt_version != SFNT_TYP1 &&
+      h->sfnt_version != SFNT_VERSION_1_0) return EOT_ERR_SFNT;
+  if (!make_view(font, size, offset + 12, 16UL * h->numTables, &v))
+    return EOT_ERR_TRUNCATED;
+  if (!(h->tables = counted_malloc(h->numTables * sizeof(h->tables[0]))))
+    return EOT_ERR_NOMEM;
+  for (i = 0; i < h->numTables; i++) {
+    (void) get_4be(&v, &h->tables[i].tag);
+    (void) get_4be(&v, &h->tables[i].checkSum);
+    (void) get_4be(&v, &h->tables[i].offset);
+    (void) get_4be(&v, &h->tables[i].length);
+    if (i > 0 && h->tables[i].tag < h->tables[i-1].tag) sorted = false;
+  }
+  if (!sorted)
+    qsort(h->tables, h->numTables, sizeof(h->tables[0]), compare_records);
+  return EOT_OK;
+}
+
+
+/* read_sfnt_header -- get the directory of tables of an OpenType font */
+eot_status read_sfnt_header(const unsigned char *font, size_t size,
+			    sfnt_offset_table *h)
+{
+  eot_status e;
+
+  PROBE1(sfnt_header__entry, size);
+  e = read_sfnt_directory(font, size, 0, h);
+  PROBE2(sfnt_header__return, e, e == EOT_OK ? h->numTables : 0);
+  return e;
+}
+
+
+/* read_ttc_header -- get the number and offsets of the fonts in a TTC
+ *
+ * Returns EOT_ERR_SFNT if the file is not a TrueType Collection. The
+ * view is set to the array of n offsets (big endian unsigned longs).
+ */
+eot_status read_ttc_header(const unsigned char *font, size_t size,
+			   unsigned long *n, view *offsets)
+{
+  unsigned long tag, version;
+  view v;
+
+  if (!make_view(font, size, 0, 12, &v) || !get_4be(&v, &tag) ||
+      tag != SFNT_TTCF) return EOT_ERR_SFNT;
+  (void) get_4be(&v, &version);
+  (void) get_4be(&v, n);
+  if (*n == 0 || !make_view(font, size, 12, 4 * *n, offsets))
+    return EOT_ERR_TRUNCATED;
+  return EOT_OK;
+}
+
+
+/* extract_face -- copy the font at offset in a TTC to out, standalone
+ *
+ * The tables are copied and given new offsets. Their checksums are
+ * taken from the collection's directory, rather than computed, so the
+ * tables that several fonts share are only read to copy them. The sum
+ * of the new font is then the sum of its directory plus those of its
+ * tables, which gives head.checkSumAdjustment without reading it
+ * again.
+ */
+eot_status extract_face(const unsigned char *font, size_t size,
+			unsigned long offset, buffer *out)
+{
+  unsigned short searchRange = 1, entrySelector = 0, i;
+  unsigned long sum = 0, pos;
+  size_t start = out->length, head = 0, total;
+  sfnt_offset_table sfnt;
+  const sfnt_table_record *r;
+  eot_status e;
+
+  if ((e = read_sfnt_directory(font, size, offset, &sfnt)) != EOT_OK) {
+    free_sfnt_header(&sfnt);
+    return e;
+  }
+  total = pos = 12 + 16UL * sfnt.numTables;
+  for (i = 0; i < sfnt.numTables; i++) {
+    r = &sfnt.tables[i];
+    if (r->offset > size || r->length > size - r->offset) {
+      free_sfnt_header(&sfnt);
+      return EOT_ERR_TRUNCATED;
+    }
+    total += (r->length + 3) & ~3UL;
+  }
+  if (!buf_reserve(out, total)) {
+    free_sfnt_header(&sfnt);
+    return EOT_ERR_NOMEM;
+  }
+
+  while (2 * searchRange <= sfnt.numTables) {
+    searchRange *= 2;
+    entrySelector++;
+  }
+  buf_put_4be(out, sfnt.sfnt_version);
+  buf_put_2be(out, sfnt.numTables);
+  buf_put_2be(out, 16 * searchRange);
+  buf_put_2be(out, entrySelector);
+  buf_put_2be(out, 16 * sfnt.numTables - 16 * searchRange);
+  for (i = 0; i < sfnt.numTables; i++) {
+    r = &sfnt.tables[i];
+    buf_put_4be(out, r->tag);
+    buf_put_4be(out, r->checkSum);
+    buf_put_4be(out, pos);
+    buf_put_4be(out, r->length);
+    pos += (r->length + 3) & ~3UL;
+    sum += r->checkSum;
+  }
+  sum += table_checksum(out->data + start, out->length - start);
+  for (i = 0; i < sfnt.numTables; i++) {
+    r = &sfnt.tables[i];
+    if (r->tag == pack_tag("head") && r->length >= 12) head = out->length;
+    buf_put_bytes(out, font + r->offset, r->length);
+    while ((out->length - start) % 4) buf_put_1(out, 0);
+  }
+  free_sfnt_header(&sfnt);
+
+  /* The directory's checksum of head assumes checkSumAdjustment is 0 */
+  if (head) set_4be(out->data + head + 8, (0xB1B0AFBA - sum) & 0xFFFFFFFF);
+  return EOT_OK;
+}
+
+
+/* free_sfnt_header -- free the memory allocated by read_sfnt_header */
+void free_sfnt_header(sfnt_offset_table *h)
+{
+  free(h->tables);
+  h->tables = NULL;
+}
+
+
+/* pack_tag -- turn a four-character tag into a number, e.g., for lookup */
+unsigned long pack_tag(const char *tag)
+{
+  return ((unsigned long)(unsigned char)tag[0] << 24) |
+    ((unsigned char)tag[1] << 16) | ((unsigned char)tag[2] << 8) |
+    (unsigned char)tag[3];
+}
+
+
+/* lookup_table -- find the record of a table by binary search, or NULL */
+const sfnt_table_record *lookup_table(sfnt_offset_table sfnt,
+				      unsigned long tag)
+{
+  unsigned short lo = 0, hi = sfnt.numTables, mid;
+
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (sfnt.tables[mid].tag < tag) lo = mid + 1;
+    else if (sfnt.tables[mid].tag > tag) hi = mid;
+    else return &sfnt.tables[mid];
+  }
+  return NULL;
+}
+
+
+/* find_table -- make a view of the table with the given tag, if it exists */
+bool find_table(sfnt_offset_table sfnt, const char *tag, view *v)
+{
+  const sfnt_table_record *r;
+
+  if (!(r = lookup_table(sfnt, pack_tag(tag)))) return false;
+  return make_view(sfnt.font, sfnt.size, r->offset, r->length, v);
+}
+
+
+/* The characters 0x80 to 0xFF of Mac OS Roman, in Unicode */
+static const unsigned short mac_roman[128] = {
+  0x00C4, 0x00C5, 0x00C7, 0x00C9, 0x00D1, 0x00D6, 0x00DC, 0x00E1,
+  0x00E0, 0x00E2, 0x00E4, 0x00E3, 0x00E5, 0x00E7, 0x00E9, 0x00E8,
+  0x00EA, 0x00EB, 0x00ED, 0x00EC, 0x00EE, 0x00EF, 0x00F1, 0x00F3,
+  0x00F2, 0x00F4, 0x00F6, 0x00F5, 0x00FA, 0x00F9, 0x00FB, 0x00FC,
+  0x2020, 0x00B0, 0x00A2, 0x00A3, 0x00A7, 0x2022, 0x00B6, 0x00DF,
+  0x00AE, 0x00A9, 0x2122, 0x00B4, 0x00A8, 0x2260, 0x00C6, 0x00D8,
+  0x221E, 0x00B1, 0x2264, 0x2265, 0x00A5, 0x00B5, 0x2202, 0x2211,
+  0x220F, 0x03C0, 0x222B, 0x00AA, 0x00BA, 0x03A9, 0x00E6, 0x00F8,
+  0x00BF, 0x00A1, 0x00AC, 0x221A, 0x0192, 0x2248, 0x2206, 0x00AB,
+  0x00BB, 0x2026, 0x00A0, 0x00C0, 0x00C3, 0x00D5, 0x0152, 0x0153,
+  0x2013, 0x2014, 0x201C, 0x201D, 0x2018, 0x2019, 0x00F7, 0x25CA,
+  0x00FF, 0x0178, 0x2044, 0x20AC, 0x2039, 0x203A, 0xFB01, 0xFB02,
+  0x2021, 0x00B7, 0x201A, 0x201E, 0x2030, 0x00C2, 0x00CA, 0x00C1,
+  0x00CB, 0x00C8, 0x00CD, 0x00CE, 0x00CF, 0x00CC, 0x00D3, 0x00D4,
+  0xF8FF, 0x00D2, 0x00DA, 0x00DB, 0x00D9, 0x0131, 0x02C6, 0x02DC,
+  0x00AF, 0x02D8, 0x02D9, 0x02DA, 0x00B8, 0x02DD, 0x02DB, 0x02C7
+};
+
+
+/* is_english -- check if a name record holds an English name
+ *
+ * Fails if the record is in an encoding or format we cannot handle.
+ */
+static eot_status is_english(unsigned short platformID,
+			     unsigned short encodingID,
+			     unsigned short languageID, bool *english)
+{
+  *english = false;
+  switch (platformID) {
+  case 0:			/* Unicode */
+    return EOT_OK;
+  case 1:			/* Macintosh */
+    if (languageID >= 0x8000) return EOT_ERR_NAME_FORMAT;
+    if (encodingID != 0) return EOT_ERR_NAME_ENCODING;
+    *english = languageID == 0;
+    return EOT_OK;
+  case 2:			/* ISO (deprecated) */
+    return EOT_OK;
+  case 3:			/* Windows */
+    if (languageID >= 0x8000) return EOT_ERR_NAME_FORMAT;
+    if (encodingID != 1) return EOT_ERR_NAME_ENCODING;
+    *english = languageID == 0x0409;
+    return EOT_OK;
+  case 4:			/* Custom */
+    return EOT_OK;
+  default:
+    return EOT_ERR_PLATFORM;
+  }
+}
+
+
+/* transcode_name -- copy a Mac Roman or UTF-16BE name as UTF-16LE */
+static eot_status transcode_name(unsigned short platformID,
+				 const unsigned char *s, unsigned short len,
+				 font_name *n)
+{
+  unsigned short c, i;
+
+  if (platformID == 1) {	/* Macintosh, one byte per character */
+    if (len > 0xFFFF / 2) return EOT_ERR_NAME_FORMAT;
+    n->size = 2 * len;
+  } else {			/* Windows, UTF-16BE */
+    n->size = len & ~1;
+  }
+  if (!(n->name = counted_malloc(n->size ? n->size : 1))) return EOT_ERR_NOMEM;
+  if (platformID == 1) {
+    for (i = 0; i < len; i++) {
+      c = s[i] < 0x80 ? s[i] : mac_roman[s[i] - 0x80];
+      n->name[2 * i] = c & 0xFF;
+      n->name[2 * i + 1] = c >> 8;
+    }
+  } else {
+    for (i = 0; i < n->size; i += 2) {
+      n->name[i] = s[i + 1];
+      n->name[i + 1] = s[i];
+    }
+  }
+  return EOT_OK;
+}
+
+
+/* parse_names -- get the English names with the given IDs from a name table
+ *
+ * The records of the name table are scanned once, straight from the
+ * font, for the first English Macintosh or Windows name with each of
+ * the nameIDs in names[], and only those names are decoded. On
+ * failure, nothing remains allocated.
+ */
+static eot_status parse_names(view v, int n, font_name names[])
+{
+  unsigned short format, count, stringOffset, i;
+  unsigned short platformID, encodingID, languageID, nameID, length, offset;
+  bool english;
+  eot_status e = EOT_OK;
+  view s;
+  int j, todo = n;
+
+  if (!get_2be(&v, &format) ||
+      !get_2be(&v, &count) ||
+      !get_2be(&v, &stringOffset)) return EOT_ERR_TRUNCATED;
+  if (format > 1) return EOT_ERR_NAME_FORMAT;
+
+  for (i = 0; i < count && todo > 0 && e == EOT_OK; i++) {
+    if (!get_2be(&v, &platformID) ||
+	!get_2be(&v, &encodingID) ||
+	!get_2be(&v, &languageID) ||
+	!get_2be(&v, &nameID) ||
+	!get_2be(&v, &length) ||
+	!get_2be(&v, &offset)) e = EOT_ERR_TRUNCATED;
+    for (j = 0; j < n && e == EOT_OK; j++) {
+      if (names[j].nameID != nameID || names[j].name) continue;
+      if ((e = is_english(platformID, encodingID, languageID, &english))
+	  != EOT_OK || !english) continue;
+      if (!make_view(v.data, v.length, (unsigned long)stringOffset + offset,
+		     length, &s)) e = EOT_ERR_TRUNCATED;
+      else e = transcode_name(platformID, s.data, length, &names[j]);
+      todo--;
+    }
+  }
+  if (e != EOT_OK)
+    for (j = 0; j < n; j++) {free(names[j].name); names[j].name = NULL;}
+  return e;
+}
+
+
+/* read_names -- get the English names with the given IDs from the font
+ *
+ * A name that does not exist gets size 0 and a NULL pointer.
+ */
+eot_status read_names(sfnt_offset_table sfnt, int n, font_name names[])
+{
+  eot_status e;
+  view v;
+  int j;
+
+  for (j = 0; j < n; j++) {names[j].size = 0; names[j].name = NULL;}
+  if (!find_table(sfnt, "name", &v)) return EOT_ERR_MISSING_TABLE;
+  PROBE2(table__entry, pack_tag("name"), v.length);
+  e = parse_names(v, n, names);
+  PROBE2(table__return, pack_tag("name"), e);
+  return e;
+}
+
+
+/* parse_OS2 -- read the fields of an OS/2 table */
+static eot_status parse_OS2(view v, OS2_table *t)
+{
+  /* Read the fields that all versions have */
+  if (!get_2be(&v, &t->version)) return EOT_ERR_TRUNCATED;
+  if (t->version > 0x0004) return EOT_ERR_OS2_VERSION;
+  if (!(get_2be_signed(&v, &t->xAvgCharWidth) &&
+	get_2be(&v, &t->usWeightClass) &&
+	get_2be(&v, &t->usWidthClass) &&
+	get_2be(&v, &t->fsType) &&
+	get_2be_signed(&v, &t->ySubscriptXSize) &&
+	get_2be_signed(&v, &t->ySubscriptYSize) &&
+	get_2be_signed(&v, &t->ySubscriptXOffset) &&
+	get_2be_signed(&v, &t->ySubscriptYOffset) &&
+	get_2be_signed(&v, &t->ySuperscriptXSize) &&
+	get_2be_signed(&v, &t->ySuperscriptYSize) &&
+	get_2be_signed(&v, &t->ySuperscriptXOffset) &&
+	get_2be_signed(&v, &t->ySuperscriptYOffset) &&
+	get_2be_signed(&v, &t->yStrikeoutSize) &&
+	get_2be_signed(&v, &t->yStrikeoutPosition) &&
+	get_2be_signed(&v, &t->sFamilyClass) &&
+	get_bytes(&v, t->panose, 10) &&
+	get_4be(&v, &t->ulUnicodeRange1) &&
+	get_4be(&v, &t->ulUnicodeRange2) &&
+	get_4be(&v, &t->ulUnicodeRange3) &&
+	get_4be(&v, &t->ulUnicodeRange4) &&
+	get_bytes(&v, t->achVendID, 4) &&
+	get_2be(&v, &t->fsSelection) &&
+	get_2be(&v, &t->usFirstCharIndex) &&
+	get_2be(&v, &t->usLastCharIndex) &&
+	get_2be_signed(&v, &t->sTypoAscender) &&
+	get_2be_signed(&v, &t->sTypoDescender) &&
+	get_2be_signed(&v, &t->sTypoLineGap) &&
+	get_2be(&v, &t->usWinAscent) &&
+	get_2be(&v, &t->usWinDescent))) return EOT_ERR_TRUNCATED;
+
+  /* Version 0 stops here, version 1 adds code pages, 2 and up the rest */
+  t->ulCodePageRange1 = t->ulCodePageRange2 = 0;
+  t->sxHeight = t->sCapHeight = 0;
+  t->usDefaultChar = t->usBreakChar = t->usMaxContext = 0;
+  if (t->version < 1) return EOT_OK;
+  if (!get_4be(&v, &t->ulCodePageRange1) ||
+      !get_4be(&v, &t->ulCodePageRange2)) return EOT_ERR_TRUNCATED;
+  if (t->version < 2) return EOT_OK;
+  if (!get_2be_signed(&v, &t->sxHeight) ||
+      !get_2be_signed(&v, &t->sCapHeight) ||
+      !get_2be(&v, &t->usDefaultChar) ||
+      !get_2be(&v, &t->usBreakChar) ||
+      !get_2be(&v, &t->usMaxContext)) return EOT_ERR_TRUNCATED;
+  return EOT_OK;
+}
+
+
+/* read_OS2_table -- find and read the OS/2 table in an OpenType file */
+eot_status read_OS2_table(sfnt_offset_table sfnt, OS2_table *t)
+{
+  eot_status e;
+  view v;
+
+  if (!find_table(sfnt, "OS/2", &v)) return EOT_ERR_MISSING_TABLE;
+  PROBE2(table__entry, pack_tag("OS/2"), v.length);
+  e = parse_OS2(v, t);
+  PROBE2(table__return, pack_tag("OS/2"), e);
+  return e;
+}
+
+
+/* parse_head -- read the fields of a head table */
+static eot_status parse_head(view v, Head_table *t)
+{
+  if (!get_4be(&v, &t->Table_version_number) ||
+      !get_4be(&v, &t->fontRevision) ||
+      !get_4be(&v, &t->checkSumAdjustment) ||
+      !get_4be(&v, &t->magicNumber) ||
+      !get_2be(&v, &t->flags) ||
+      !get_2be(&v, &t->unitsPerEm) ||
+      !get_8be(&v, &t->created) ||
+      !get_8be(&v, &t->modified) ||
+      !get_2be_signed(&v, &t->xMin) ||
+      !get_2be_signed(&v, &t->yMin) ||
+      !get_2be_signed(&v, &t->xMax) ||
+      !get_2be_signed(&v, &t->yMax) ||
+      !get_2be(&v, &t->macStyle) ||
+      !get_2be(&v, &t->lowestRecPPEM) ||
+      !get_2be_signed(&v, &t->fontDirectionHint) ||
+      !get_2be_signed(&v, &t->indexToLocFormat) ||
+      !get_2be_signed(&v, &t->glyphDataFormat)) return EOT_ERR_TRUNCATED;
+  return EOT_OK;
+}
+
+
+/* read_head_table -- find and read the head table in an OpenType file */
+eot_status read_head_table(sfnt_offset_table sfnt, Head_table *t)
+{
+  eot_status e;
+  view v;
+
+  if (!find_table(sfnt, "head", &v)) return EOT_ERR_MISSING_TABLE;
+  PROBE2(table__entry, pack_tag("head"), v.length);
+  e = parse_head(v, t);
+  PROBE2(table__return, pack_tag("head"), e);
+  return e;
+}
@@ -0,0 +1,175 @@
+/* sfnt.h -- read the tables of OpenType/TrueType fonts (internal to libeot)
+ *
+ * All readers decode directly from the font in memory, through views
+ * that check every access against the bounds of the table.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef SFNT_H
+#define SFNT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "eot.h"
+
+/* sfnt version numbers for OpenType/TrueType */
+#define SFNT_OTTO (('O' << 24) | ('T' << 16) | ('T' << 8) | 'O')
+#define SFNT_TRUE (('t' << 24) | ('r' << 16) | ('u' << 8) | 'e')
+#define SFNT_TYP1 (('t' << 24) | ('y' << 16) | ('p' << 8) | '1')
+#define SFNT_VERSION_1_0 0x00010000
+#define SFNT_TTCF (('t' << 24) | ('t' << 16) | ('c' << 8) | 'f')
+
+typedef struct {		/* A bounds-checked window on a font */
+  const unsigned char *data;
+  size_t length;
+  size_t pos;			/* Read position, 0 <= pos <= length */
+} view;
+
+typedef struct {		/* Output that grows as needed */
+  unsigned char *data;
+  size_t length;
+  size_t alloc;
+  bool failed;			/* Set if memory ran out */
+} buffer;
+
+typedef struct {		/* A table for build_sfnt */
+  char tag[4];
+  const unsigned char *data;
+  size_t length;
+} sfnt_table;
+
+typedef struct {
+  unsigned long tag;		/* The four characters, packed big endian */
+  unsigned long checkSum;
+  unsigned long offset;
+  unsigned long length;
+} sfnt_table_record;
+
+typedef struct {
+  const unsigned char *font;	/* The whole font */
+  size_t size;
+  unsigned long sfnt_version;
+  unsigned short numTables;
+  unsigned short searchRange;
+  unsigned short entrySelector;
+  unsigned short rangeShift;
+  sfnt_table_record *tables;	/* Sorted by tag */
+} sfnt_offset_table;
+
+typedef struct {
+  unsigned short version; /* = 0x0004 */
+  short xAvgCharWidth;
+  unsigned short usWeightClass;
+  unsigned short usWidthClass;
+  unsigned short fsType;
+  short ySubscriptXSize;
+  short ySubscriptYSize;
+  short ySubscriptXOffset;
+  short ySubscriptYOffset;
+  short ySuperscriptXSize;
+  short ySuperscriptYSize;
+  short ySuperscriptXOffset;
+  short ySuperscriptYOffset;
+  short yStrikeoutSize;
+  short yStrikeoutPosition;
+  short sFamilyClass;
+  unsigned char panose[10];
+  unsigned long ulUnicodeRange1;
+  unsigned long ulUnicodeRange2;
+  unsigned long ulUnicodeRange3;
+  unsigned long ulUnicodeRange4;
+  char achVendID[4];
+  unsigned short fsSelection;
+  unsigned short usFirstCharIndex;
+  unsigned short usLastCharIndex;
+  short sTypoAscender;
+  short sTypoDescender;
+  short sTypoLineGap;
+  unsigned short usWinAscent;
+  unsigned short usWinDescent;
+  unsigned long ulCodePageRange1;
+  unsigned long ulCodePageRange2;
+  short sxHeight;
+  short sCapHeight;
+  unsigned short usDefaultChar;
+  unsigned short usBreakChar;
+  unsigned short usMaxContext;
+} OS2_table;
+
+typedef struct {		/* A name for read_names to get */
+  unsigned short nameID;
+  unsigned short size;		/* In bytes, 0 if the font lacks the name */
+  unsigned char *name;		/* UTF-16LE, allocated */
+} font_name;
+
+typedef struct {
+  unsigned long Table_version_number; /* = 0x00010000 */
+  unsigned long fontRevision;
+  unsigned long checkSumAdjustment;
+  unsigned long magicNumber;	/* = 0x5F0F3CF5 */
+  unsigned short flags;
+  unsigned short unitsPerEm;
+  unsigned long long created;
+  unsigned long long modified;
+  short xMin;
+  short yMin;
+  short xMax;
+  short yMax;
+  unsigned short macStyle;
+  unsigned short lowestRecPPEM;
+  short fontDirectionHint;
+  short indexToLocFormat;
+  short glyphDataFormat;
+} Head_table;
+
+extern bool make_view(const unsigned char *data, size_t size,
+		      unsigned long offset, unsigned long len, view *v);
+extern bool get_8be(view *v, unsigned long long *x);
+extern bool get_4be(view *v, unsigned long *x);
+extern bool get_2be(view *v, unsigned short *x);
+extern bool get_2be_signed(view *v, short *x);
+extern bool get_4le(view *v, unsigned long *x);
+extern bool get_2le(view *v, unsigned short *x);
+extern bool get_1(view *v, unsigned char *x);
+extern bool get_bytes(view *v, void *x, size_t n);
+
+extern void buf_init(buffer *b);
+extern bool buf_reserve(buffer *b, size_t n);
+extern void buf_put_1(buffer *b, unsigned char x);
+extern void buf_put_2be(buffer *b, unsigned short x);
+extern void buf_put_4be(buffer *b, unsigned long x);
+extern void buf_put_bytes(buffer *b, const void *s, size_t n);
+extern bool get_255ushort(view *v, unsigned short *x);
+extern void set_4be(unsigned char *p, unsigned long x);
+
+extern unsigned long table_checksum(const unsigned char *data, size_t len);
+extern unsigned long byte_sum(const unsigned char *data, size_t len);
+extern eot_status build_sfnt(unsigned long sfnt_version, int ntables,
+			     const sfnt_table tables[], buffer *out);
+extern eot_status rebuild_sfnt(sfnt_offset_table sfnt, int n,
+			       const sfnt_table changes[], buffer *out);
+extern eot_status verify_sfnt(sfnt_offset_table sfnt);
+extern eot_status fix_sfnt_checksums(unsigned char *font, size_t size);
+
+extern eot_status read_sfnt_directory(const unsigned char *font, size_t size,
+				      unsigned long offset,
+				      sfnt_offset_table *h);
+extern eot_status read_sfnt_header(const unsigned char *font, size_t size,
+				   sfnt_offset_table *h);
+extern eot_status read_ttc_header(const unsigned char *font, size_t size,
+				  unsigned long *n, view *offsets);
+extern eot_status extract_face(const unsigned char *font, size_t size,
+			       unsigned long offset, buffer *out);
+extern void free_sfnt_header(sfnt_offset_table *h);
+extern unsigned long pack_tag(const char *tag);
+extern const sfnt_table_record *lookup_table(sfnt_offset_table sfnt,
+					     unsigned long tag);
+extern bool find_table(sfnt_offset_table sfnt, const char *tag, view *v);
+extern eot_status read_names(sfnt_offset_table sfnt, int n,
+			     font_name names[]);
+extern eot_status read_OS2_table(sfnt_offset_table sfnt, OS2_table *t);
+extern eot_status read_head_table(sfnt_offset_table sfnt, Head_table *t);
+
+#endif /* SFNT_H */
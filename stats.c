@@ -0,0 +1,240 @@
+/* stats -- time the phases of mkeot and eotinfo and count their I/O
+ *
+ * With --stats, the programs time their own phases (mapping the
+ * input, the cache, copying the font data) and let libeot time its
+ * phases (the table directory, the names, the header...), all with
+ * the monotonic clock. They also count the bytes they read and
+ * write, their I/O system calls and the allocations libeot makes.
+ * The C library's malloc is not replaced, so the allocations of the
+ * programs themselves are not counted. All counters are per thread,
+ * so the jobs of a batch, which each run in a single thread, can be
+ * measured separately and summarized in histograms.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "eot.h"
+#include "mapfile.h"
+#include "stats.h"
+
+static const char *const phase_names[STATS_NPHASES] = {
+  "map", "cache", "copy", "output"
+};
+
+static __thread stats *current;		/* The stats being counted */
+
+
+/* now -- nanoseconds since some fixed time, by the monotonic clock */
+static unsigned long long now(void)
+{
+  struct timespec t;
+
+  (void) clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+
+
+/* stats_start -- start counting the cost of the current thread's work
+ *
+ * Until stats_stop(), s->io holds the counters as they were at the
+ * start.
+ */
+void stats_start(stats *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->io = io_count;
+  current = s;
+  eot_time_phases(&s->lib);
+  s->start = now();
+}
+
+
+/* stats_stop -- stop counting, the totals are then in s */
+void stats_stop(stats *s)
+{
+  s->total = now() - s->start;
+  s->io.read = io_count.read - s->io.read;
+  s->io.written = io_count.written - s->io.written;
+  s->io.syscalls = io_count.syscalls - s->io.syscalls;
+  s->allocs = s->lib.allocs;
+  eot_time_phases(NULL);
+  current = NULL;
+}
+
+
+/* stats_clock -- the start of a phase, or 0 if the thread isn't counting */
+unsigned long long stats_clock(void)
+{
+  return current ? now() : 0;
+}
+
+
+/* stats_phase -- add the time since start (from stats_clock) to phase p */
+void stats_phase(tool_phase p, unsigned long long start)
+{
+  if (start == 0 || !current) return;
+  current->ns[p] += now() - start;
+  current->calls[p]++;
+}
+
+
+/* stats_begin_summary -- empty a summary and start its clock */
+void stats_begin_summary(stats_summary *sum)
+{
+  memset(sum, 0, sizeof(*sum));
+  sum->start = now();
+}
+
+
+/* add_value -- add a value to a histogram */
+static void add_value(histogram *h, unsigned long long x)
+{
+  if (h->n == 0 || x < h->min) h->min = x;
+  if (x > h->max) h->max = x;
+  h->n++;
+  h->sum += x;
+  h->bucket[x < 2 ? 0 : 63 - __builtin_clzll(x)]++;
+}
+
+
+/* merge -- add the values of histogram b to histogram a */
+static void merge(histogram *a, const histogram *b)
+{
+  int i;
+
+  if (b->n == 0) return;
+  if (a->n == 0 || b->min < a->min) a->min = b->min;
+  if (b->max > a->max) a->max = b->max;
+  a->n += b->n;
+  a->sum += b->sum;
+  for (i = 0; i < STATS_BUCKETS; i++) a->bucket[i] += b->bucket[i];
+}
+
+
+/* stats_add -- add the cost of one job to the histograms */
+void stats_add(stats_summary *sum, const stats *s)
+{
+  int i;
+
+  add_value(&sum->total, s->total);
+  for (i = 0; i < EOT_NPHASES; i++)
+    if (s->lib.calls[i]) add_value(&sum->lib[i], s->lib.ns[i]);
+  for (i = 0; i < STATS_NPHASES; i++)
+    if (s->calls[i]) add_value(&sum->ns[i], s->ns[i]);
+  add_value(&sum->read, s->io.read);
+  add_value(&sum->written, s->io.written);
+  add_value(&sum->syscalls, s->io.syscalls);
+  add_value(&sum->allocs, s->allocs);
+}
+
+
+/* stats_merge -- add the histograms of one summary to those of another */
+void stats_merge(stats_summary *sum, const stats_summary *other)
+{
+  int i;
+
+  merge(&sum->total, &other->total);
+  for (i = 0; i < EOT_NPHASES; i++) merge(&sum->lib[i], &other->lib[i]);
+  for (i = 0; i < STATS_NPHASES; i++) merge(&sum->ns[i], &other->ns[i]);
+  merge(&sum->read, &other->read);
+  merge(&sum->written, &other->written);
+  merge(&sum->syscalls, &other->syscalls);
+  merge(&sum->allocs, &other->allocs);
+}
+
+
+/* put_histogram -- write a histogram as a JSON object
+ *
+ * Only the non-empty buckets are written, as pairs of the bucket's
+ * lower bound and the number of values in it.
+ */
+static void put_histogram(FILE *f, const histogram *h)
+{
+  const char *sep = "";
+  int i;
+
+  fprintf(f, "{\"count\":%llu,\"sum\":%llu,\"min\":%llu,\"max\":%llu,"
+	  "\"buckets\":[", h->n, h->sum, h->min, h->max);
+  for (i = 0; i < STATS_BUCKETS; i++)
+    if (h->bucket[i]) {
+      fprintf(f, "%s[%llu,%llu]", sep, i ? 1ULL << i : 0ULL, h->bucket[i]);
+      sep = ",";
+    }
+  fputs("]}", f);
+}
+
+
+/* put_run -- write the cost of a single run as JSON members */
+static void put_run(FILE *f, const stats *s)
+{
+  int i;
+
+  fprintf(f, "\"total_ns\":%llu,\"phases\":{", s->total);
+  for (i = 0; i < STATS_NPHASES; i++)
+    fprintf(f, "\"%s\":{\"ns\":%llu,\"calls\":%lu},", phase_names[i],
+	    s->ns[i], s->calls[i]);
+  for (i = 0; i < EOT_NPHASES; i++)
+    fprintf(f, "%s\"%s\":{\"ns\":%llu,\"calls\":%lu}", i ? "," : "",
+	    eot_phase_name(i), s->lib.ns[i], s->lib.calls[i]);
+  fprintf(f, "},\"bytes_read\":%llu,\"bytes_written\":%llu,"
+	  "\"syscalls\":%llu,", s->io.read, s->io.written, s->io.syscalls);
+  fprintf(f, "\"allocations\":%llu", s->allocs);
+}
+
+
+/* put_summary -- write histograms of the costs of jobs as JSON members */
+static void put_summary(FILE *f, const stats_summary *sum)
+{
+  int i;
+
+  fprintf(f, "\"jobs\":%llu,\"total_ns\":%llu,\"per_job\":{\"total_ns\":",
+	  sum->total.n, now() - sum->start);
+  put_histogram(f, &sum->total);
+  fputs(",\"phases\":{", f);
+  for (i = 0; i < STATS_NPHASES; i++) {
+    fprintf(f, "\"%s\":", phase_names[i]);
+    put_histogram(f, &sum->ns[i]);
+    fputs(",", f);
+  }
+  for (i = 0; i < EOT_NPHASES; i++) {
+    fprintf(f, "%s\"%s\":", i ? "," : "", eot_phase_name(i));
+    put_histogram(f, &sum->lib[i]);
+  }
+  fputs("},\"bytes_read\":", f);
+  put_histogram(f, &sum->read);
+  fputs(",\"bytes_written\":", f);
+  put_histogram(f, &sum->written);
+  fputs(",\"syscalls\":", f);
+  put_histogram(f, &sum->syscalls);
+  fputs(",\"allocations\":", f);
+  put_histogram(f, &sum->allocs);
+  fputs("}", f);
+}
+
+
+/* stats_write -- write a run's cost, or a summary of jobs, as JSON */
+bool stats_write(const char *path, const char *program, const stats *s,
+		 const stats_summary *sum)
+{
+  FILE *f = stderr;
+  bool ok;
+
+  if (path && !(f = fopen(path, "w"))) return false;
+  fprintf(f, "{\"program\":\"%s\",", program);
+  if (sum) put_summary(f, sum);
+  else put_run(f, s);
+  fputs("}\n", f);
+  ok = !ferror(f);
+  if (path && fclose(f) != 0) ok = false;
+  else if (!path && fflush(f) != 0) ok = false;
+  return ok;
+}
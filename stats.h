@@ -0,0 +1,77 @@
+/* stats.h -- time the phases of mkeot and eotinfo and count their I/O
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "eot.h"
+#include "mapfile.h"
+
+#define STATS_BUCKETS 64	/* Histogram buckets, one per power of 2 */
+
+typedef enum {			/* Phases of the programs themselves */
+  STATS_MAP,			/* Mapping or reading the input */
+  STATS_CACHE,			/* Hashing the font, looking in the cache */
+  STATS_COPY,			/* Writing the header and the font data */
+  STATS_OUTPUT,			/* Formatting and writing eotinfo's output */
+  STATS_NPHASES
+} tool_phase;
+
+typedef struct {		/* The cost of a run, or of one job */
+  unsigned long long start;	/* Clock at stats_start() */
+  unsigned long long total;	/* Nanoseconds from start to stats_stop() */
+  eot_timings lib;		/* The phases in libeot */
+  unsigned long long ns[STATS_NPHASES];
+  unsigned long calls[STATS_NPHASES];
+  io_counters io;
+  unsigned long long allocs;	/* Allocations by libeot */
+} stats;
+
+typedef struct {		/* The distribution of a value over jobs */
+  unsigned long long n, sum, min, max;
+  unsigned long long bucket[STATS_BUCKETS]; /* Values in [2^i, 2^(i+1)) */
+} histogram;
+
+typedef struct {		/* Histograms of the costs of many jobs */
+  unsigned long long start;	/* Clock at stats_begin_summary() */
+  histogram total;
+  histogram lib[EOT_NPHASES];	/* Only over the jobs with that phase */
+  histogram ns[STATS_NPHASES];
+  histogram read, written, syscalls, allocs;
+} stats_summary;
+
+/* stats_start -- start counting the cost of the current thread's work */
+extern void stats_start(stats *s);
+
+/* stats_stop -- stop counting, the totals are then in s */
+extern void stats_stop(stats *s);
+
+/* stats_clock -- the start of a phase, or 0 if the thread isn't counting */
+extern unsigned long long stats_clock(void);
+
+/* stats_phase -- add the time since start (from stats_clock) to phase p */
+extern void stats_phase(tool_phase p, unsigned long long start);
+
+/* stats_begin_summary -- empty a summary and start its clock */
+extern void stats_begin_summary(stats_summary *sum);
+
+/* stats_add -- add the cost of one job to the histograms */
+extern void stats_add(stats_summary *sum, const stats *s);
+
+/* stats_merge -- add the histograms of one summary to those of another */
+extern void stats_merge(stats_summary *sum, const stats_summary *other);
+
+/* stats_write -- write a run's cost, or a summary of jobs, as JSON
+ *
+ * Exactly one of s and sum is not NULL. path is the file to write,
+ * or NULL for stderr. Returns false if the file could not be written.
+ */
+extern bool stats_write(const char *path, const char *program,
+			const stats *s, const stats_summary *sum);
+
+#endif /* STATS_H */
@@ -0,0 +1,725 @@
+/* subset -- reduce a TrueType font to the glyphs for some characters
+ *
+ * The glyphs that are kept are those that the Unicode cmap maps the
+ * requested characters to, plus glyph 0 (.notdef), the components of
+ * composite glyphs, and the glyphs that GSUB can substitute for kept
+ * glyphs (ignoring any context, so possibly a few too many). The other
+ * glyphs are emptied, but keep their index, so that kern, GPOS, etc.
+ * remain valid without being rewritten. The cmap is replaced by one
+ * that only maps the requested characters, except in symbol fonts,
+ * and DSIG is removed, since the signature no longer applies.
+ *
+ * Glyphs after the last kept one are removed altogether: numGlyphs in
+ * maxp is lowered and loca, hmtx, vmtx, hdmx, LTSH and the glyph names
+ * in post are cut to match. kern, GDEF, GSUB and GPOS may still refer
+ * to the removed glyphs, but only in entries for glyphs that no
+ * character maps to. Symbol fonts, whose cmap is kept, are not cut.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "subset.h"
+#include "glyf.h"
+#include "alloc.h"
+
+#define LOOKUP_EXTENSION 7	/* GSUB lookup that wraps another type */
+#define NTRIMMED 8		/* Tables that trim_glyphs() may change */
+#define POST_NAMES 0x00020000	/* post table version with glyph names */
+#define POST_STANDARD_NAMES 258	/* Name indexes below this are standard */
+
+typedef struct {
+  unsigned long cp;		/* Unicode code point */
+  unsigned short gid;
+} cmap_entry;
+
+typedef struct {
+  cmap_entry *entries;
+  size_t n, alloc;
+} cmap_list;
+
+typedef struct {		/* The glyphs to keep */
+  unsigned char *keep;
+  unsigned short nglyphs;
+  bool changed;			/* Set when a glyph is added */
+} glyph_set;
+
+
+/* add_entry -- add a mapping to a list of cmap entries */
+static bool add_entry(cmap_list *l, unsigned long cp, unsigned short gid)
+{
+  cmap_entry *p;
+
+  if (l->n == l->alloc) {
+    l->alloc = l->alloc ? 2 * l->alloc : 256;
+    if (!(p = counted_realloc(l->entries, l->alloc * sizeof(*p)))) return false;
+    l->entries = p;
+  }
+  l->entries[l->n].cp = cp;
+  l->entries[l->n++].gid = gid;
+  return true;
+}
+
+
+/* get_2_at -- read an unsigned short at a given position in a table */
+static bool get_2_at(view t, size_t pos, unsigned short *x)
+{
+  t.pos = pos;
+  return pos <= t.length && get_2be(&t, x);
+}
+
+
+/* get_4_at -- read an unsigned long at a given position in a table */
+static bool get_4_at(view t, size_t pos, unsigned long *x)
+{
+  t.pos = pos;
+  return pos <= t.length && get_4be(&t, x);
+}
+
+
+/* read_format4 -- list the mappings of a format 4 cmap subtable */
+static eot_status read_format4(view t, cmap_list *l)
+{
+  unsigned short segx2, i, end, start, delta, range, g;
+  unsigned long c, ranges;
+
+  if (!get_2_at(t, 6, &segx2) || t.length < 16 + 4 * (size_t)segx2)
+    return EOT_ERR_TRUNCATED;
+  for (i = 0; i < segx2; i += 2) {
+    (void) get_2_at(t, 14 + i, &end);
+    (void) get_2_at(t, 16 + segx2 + i, &start);
+    (void) get_2_at(t, 16 + 2 * segx2 + i, &delta);
+    ranges = 16 + 3 * segx2 + i;	/* Position of idRangeOffset[i] */
+    (void) get_2_at(t, ranges, &range);
+    for (c = start; c <= end && c != 0xFFFF; c++) {
+      if (range == 0) g = (c + delta) & 0xFFFF;
+      else if (!get_2_at(t, ranges + range + 2 * (c - start), &g)) continue;
+      else if (g != 0) g = (g + delta) & 0xFFFF;
+      if (g != 0 && !add_entry(l, c, g)) return EOT_ERR_NOMEM;
+    }
+  }
+  return EOT_OK;
+}
+
+
+/* read_format12 -- list the mappings of a format 12 cmap subtable */
+static eot_status read_format12(view t, cmap_list *l)
+{
+  unsigned long ngroups, i, start, end, g, c;
+
+  if (!get_4_at(t, 12, &ngroups) || (t.length - 16) / 12 < ngroups)
+    return EOT_ERR_TRUNCATED;
+  for (i = 0; i < ngroups; i++) {
+    (void) get_4_at(t, 16 + 12 * i, &start);
+    (void) get_4_at(t, 20 + 12 * i, &end);
+    (void) get_4_at(t, 24 + 12 * i, &g);
+    if (end > 0x10FFFF || start > end) return EOT_ERR_CMAP;
+    for (c = start; c <= end && g + (c - start) <= 0xFFFF; c++)
+      if (!add_entry(l, c, g + (c - start))) return EOT_ERR_NOMEM;
+  }
+  return EOT_OK;
+}
+
+
+/* read_cmap -- list the mappings of the best Unicode subtable of cmap
+ *
+ * *symbol is set if the only usable subtable is the Windows symbol
+ * encoding.
+ */
+static eot_status read_cmap(sfnt_offset_table sfnt, cmap_list *l,
+			    bool *symbol)
+{
+  static const unsigned short prefs[][2] = { /* Platform and encoding */
+    {3, 10}, {0, 6}, {0, 4}, {3, 1}, {0, 3}, {0, 2}, {0, 1}, {0, 0}, {3, 0}};
+  const size_t nprefs = sizeof(prefs) / sizeof(prefs[0]);
+  unsigned short n, i, platform, encoding, format, len2;
+  unsigned long offset, bestoffset = 0, len;
+  size_t j, best = nprefs;
+  view cmap, t;
+
+  if (!find_table(sfnt, "cmap", &cmap)) return EOT_ERR_CMAP;
+  if (!get_2_at(cmap, 2, &n)) return EOT_ERR_TRUNCATED;
+  for (i = 0; i < n; i++) {
+    if (!get_2_at(cmap, 4 + 8 * i, &platform) ||
+	!get_2_at(cmap, 6 + 8 * i, &encoding) ||
+	!get_4_at(cmap, 8 + 8 * i, &offset)) return EOT_ERR_TRUNCATED;
+    if (!get_2_at(cmap, offset, &format) || (format != 4 && format != 12))
+      continue;
+    for (j = 0; j < best; j++)
+      if (prefs[j][0] == platform && prefs[j][1] == encoding) {
+	best = j;
+	bestoffset = offset;
+      }
+  }
+  if (best == nprefs) return EOT_ERR_CMAP;
+  *symbol = prefs[best][0] == 3 && prefs[best][1] == 0;
+
+  (void) get_2_at(cmap, bestoffset, &format);
+  if (format == 4) {
+    if (!get_2_at(cmap, bestoffset + 2, &len2)) return EOT_ERR_TRUNCATED;
+    len = len2;
+  } else if (!get_4_at(cmap, bestoffset + 4, &len)) {
+    return EOT_ERR_TRUNCATED;
+  }
+  if (!make_view(cmap.data, cmap.length, bestoffset, len, &t))
+    return EOT_ERR_TRUNCATED;
+  return format == 4 ? read_format4(t, l) : read_format12(t, l);
+}
+
+
+/* in_ranges -- check if a code point is in one of the ranges */
+static bool in_ranges(unsigned long cp, const eot_unicode_range ranges[],
+		      size_t nranges)
+{
+  size_t i;
+
+  for (i = 0; i < nranges; i++)
+    if (ranges[i].first <= cp && cp <= ranges[i].last) return true;
+  return false;
+}
+
+
+/* is_kept -- check if a glyph is in the set */
+static bool is_kept(const glyph_set *s, unsigned short g)
+{
+  return g < s->nglyphs && s->keep[g];
+}
+
+
+/* keep -- add a glyph to the set */
+static void keep(glyph_set *s, unsigned short g)
+{
+  if (g < s->nglyphs && !s->keep[g]) {s->keep[g] = 1; s->changed = true;}
+}
+
+
+/* close_composites -- add the components of kept composite glyphs */
+static void close_composites(view glyf, view loca, bool long_format,
+			     glyph_set *s)
+{
+  unsigned short i, flags, component;
+  short ncontours;
+  view g;
+
+  for (i = 0; i < s->nglyphs; i++)
+    if (s->keep[i] && get_glyph(glyf, loca, long_format, i, &g) &&
+	get_2be_signed(&g, &ncontours) && ncontours == -1) {
+      g.pos = 10;
+      do {
+	if (!next_component(&g, &flags, &component)) break;
+	keep(s, component);
+      } while (flags & GLYF_MORE_COMPONENTS);
+    }
+}
+
+
+/* get_coverage -- list the glyphs of a Coverage table in index order */
+static eot_status get_coverage(view t, size_t pos, unsigned short **glyphs,
+			       unsigned long *n)
+{
+  unsigned short format, count, i, start, end;
+  unsigned long k, total = 0;
+
+  *glyphs = NULL;
+  if (!get_2_at(t, pos, &format) || !get_2_at(t, pos + 2, &count))
+    return EOT_ERR_TRUNCATED;
+  if (format == 1) {
+    total = count;
+  } else if (format == 2) {
+    for (i = 0; i < count; i++) {
+      if (!get_2_at(t, pos + 4 + 6 * i, &start) ||
+	  !get_2_at(t, pos + 6 + 6 * i, &end) || end < start)
+	return EOT_ERR_TRUNCATED;
+      total += end - start + 1;
+    }
+  } else {
+    return EOT_ERR_TRUNCATED;
+  }
+  if (!(*glyphs = counted_malloc((total ? total : 1) * sizeof(**glyphs))))
+    return EOT_ERR_NOMEM;
+  if (format == 1) {
+    for (i = 0; i < count; i++)
+      if (!get_2_at(t, pos + 4 + 2 * i, &(*glyphs)[i])) {
+	free(*glyphs);
+	return EOT_ERR_TRUNCATED;
+      }
+  } else {
+    for (i = 0, k = 0; i < count; i++) {
+      (void) get_2_at(t, pos + 4 + 6 * i, &start);
+      (void) get_2_at(t, pos + 6 + 6 * i, &end);
+      while (start <= end && k < total) {
+	(*glyphs)[k++] = start;
+	if (start++ == 0xFFFF) break;
+      }
+    }
+  }
+  *n = total;
+  return EOT_OK;
+}
+
+
+/* close_subtable -- add the glyphs a GSUB subtable substitutes for kept ones
+ *
+ * Handles single, multiple, alternate and ligature substitutions.
+ * Malformed subtables are skipped.
+ */
+static eot_status close_subtable(view t, size_t sub, unsigned short type,
+				 glyph_set *s)
+{
+  unsigned short format, coverage, x, count, off, n, lig, ncomp, comp;
+  unsigned short *cov;
+  unsigned long ncov, i, j, k;
+  eot_status e;
+  bool all;
+
+  if (!get_2_at(t, sub, &format) ||
+      (format != 1 && !(type == 1 && format == 2)) ||
+      !get_2_at(t, sub + 2, &coverage) || !get_2_at(t, sub + 4, &x))
+    return EOT_OK;
+  if ((e = get_coverage(t, sub + coverage, &cov, &ncov)) != EOT_OK)
+    return e == EOT_ERR_NOMEM ? e : EOT_OK;
+  count = x;
+
+  for (i = 0; i < ncov; i++) {
+    if (!is_kept(s, cov[i])) continue;
+    switch (type) {
+    case 1:			/* Single: x is a delta or a count */
+      if (format == 1) keep(s, (cov[i] + x) & 0xFFFF);
+      else if (i < count && get_2_at(t, sub + 6 + 2 * i, &x)) keep(s, x);
+      break;
+    case 2:			/* Multiple */
+    case 3:			/* Alternate */
+      if (i < count && get_2_at(t, sub + 6 + 2 * i, &off) &&
+	  get_2_at(t, sub + off, &n))
+	for (j = 0; j < n; j++)
+	  if (get_2_at(t, sub + off + 2 + 2 * j, &x)) keep(s, x);
+      break;
+    case 4:			/* Ligature, if all components are kept */
+      if (i < count && get_2_at(t, sub + 6 + 2 * i, &off) &&
+	  get_2_at(t, sub + off, &n))
+	for (j = 0; j < n; j++) {
+	  if (!get_2_at(t, sub + off + 2 + 2 * j, &lig) ||
+	      !get_2_at(t, sub + off + lig, &x) ||
+	      !get_2_at(t, sub + off + lig + 2, &ncomp)) continue;
+	  for (k = 1, all = true; k < ncomp && all; k++)
+	    all = get_2_at(t, sub + off + lig + 2 + 2 * k, &comp) &&
+	      is_kept(s, comp);
+	  if (all) keep(s, x);
+	}
+      break;
+    }
+  }
+  free(cov);
+  return EOT_OK;
+}
+
+
+/* close_gsub -- add the glyphs that GSUB can substitute for kept glyphs */
+static eot_status close_gsub(sfnt_offset_table sfnt, glyph_set *s)
+{
+  unsigned short lookups, nlookups, off, type, nsub, suboff, exttype;
+  unsigned long i, j, extoff;
+  size_t lookup, sub;
+  eot_status e;
+  view t;
+
+  if (!find_table(sfnt, "GSUB", &t)) return EOT_OK;
+  if (!get_2_at(t, 8, &lookups) || !get_2_at(t, lookups, &nlookups))
+    return EOT_OK;
+  for (i = 0; i < nlookups; i++) {
+    if (!get_2_at(t, lookups + 2 + 2 * i, &off) ||
+	!get_2_at(t, lookups + off, &type) ||
+	!get_2_at(t, lookups + off + 4, &nsub)) continue;
+    lookup = lookups + off;
+    for (j = 0; j < nsub; j++) {
+      if (!get_2_at(t, lookup + 6 + 2 * j, &suboff)) continue;
+      sub = lookup + suboff;
+      if (type == LOOKUP_EXTENSION) {
+	if (!get_2_at(t, sub + 2, &exttype) || !get_4_at(t, sub + 4, &extoff))
+	  continue;
+	sub += extoff;
+      } else {
+	exttype = type;
+      }
+      if (exttype >= 1 && exttype <= 4 &&
+	  (e = close_subtable(t, sub, exttype, s)) != EOT_OK) return e;
+    }
+  }
+  return EOT_OK;
+}
+
+
+/* compare_entries -- order cmap entries by code point, for qsort */
+static int compare_entries(const void *a, const void *b)
+{
+  const cmap_entry *x = a, *y = b;
+
+  return x->cp < y->cp ? -1 : x->cp > y->cp;
+}
+
+
+/* put_format4 -- write a format 4 cmap subtable for the BMP entries
+ *
+ * Each segment is a run of consecutive characters and glyphs, coded
+ * with idDelta. Returns false if the subtable would be too large.
+ */
+static bool put_format4(buffer *b, const cmap_entry *e, size_t n)
+{
+  unsigned short *start, *end, *delta, searchRange = 1, entrySelector = 0;
+  size_t i, nsegs = 0;
+  bool ok;
+
+  if (!(start = counted_malloc(3 * (n + 1) * sizeof(*start)))) {
+    b->failed = true;
+    return false;
+  }
+  end = start + n + 1;
+  delta = end + n + 1;
+  for (i = 0; i < n && e[i].cp < 0xFFFF; i++) {
+    if (nsegs > 0 && e[i].cp == end[nsegs-1] + 1UL &&
+	((e[i].gid - e[i].cp) & 0xFFFF) == delta[nsegs-1]) {
+      end[nsegs-1]++;
+    } else {
+      start[nsegs] = end[nsegs] = e[i].cp;
+      delta[nsegs++] = (e[i].gid - e[i].cp) & 0xFFFF;
+    }
+  }
+  start[nsegs] = end[nsegs] = 0xFFFF;	/* Required last segment */
+  delta[nsegs++] = 1;
+
+  if ((ok = 16 + 8 * nsegs <= 0xFFFF)) {
+    while (2 * searchRange <= nsegs) {searchRange *= 2; entrySelector++;}
+    buf_put_2be(b, 4);		/* format */
+    buf_put_2be(b, 16 + 8 * nsegs);
+    buf_put_2be(b, 0);		/* language */
+    buf_put_2be(b, 2 * nsegs);
+    buf_put_2be(b, 2 * searchRange);
+    buf_put_2be(b, entrySelector);
+    buf_put_2be(b, 2 * nsegs - 2 * searchRange);
+    for (i = 0; i < nsegs; i++) buf_put_2be(b, end[i]);
+    buf_put_2be(b, 0);		/* reservedPad */
+    for (i = 0; i < nsegs; i++) buf_put_2be(b, start[i]);
+    for (i = 0; i < nsegs; i++) buf_put_2be(b, delta[i]);
+    for (i = 0; i < nsegs; i++) buf_put_2be(b, 0); /* idRangeOffset */
+  }
+  free(start);
+  return ok;
+}
+
+
+/* put_format12 -- write a format 12 cmap subtable for all entries */
+static void put_format12(buffer *b, const cmap_entry *e, size_t n)
+{
+  size_t i, j, ngroups = 0;
+
+  for (i = 0; i < n; i++)
+    if (i == 0 || e[i].cp != e[i-1].cp + 1 || e[i].gid != e[i-1].gid + 1)
+      ngroups++;
+  buf_put_2be(b, 12);		/* format */
+  buf_put_2be(b, 0);		/* reserved */
+  buf_put_4be(b, 16 + 12 * ngroups);
+  buf_put_4be(b, 0);		/* language */
+  buf_put_4be(b, ngroups);
+  for (i = 0; i < n; i = j) {
+    for (j = i + 1; j < n && e[j].cp == e[j-1].cp + 1 &&
+	   e[j].gid == e[j-1].gid + 1; j++);
+    buf_put_4be(b, e[i].cp);
+    buf_put_4be(b, e[j-1].cp);
+    buf_put_4be(b, e[i].gid);
+  }
+}
+
+
+/* build_cmap -- make a cmap table for the given entries
+ *
+ * Writes a Windows Unicode BMP subtable and, if there are characters
+ * outside the BMP, a Windows Unicode full repertoire subtable.
+ */
+static bool build_cmap(cmap_entry *e, size_t n, buffer *b)
+{
+  bool full = n > 0 && e[n-1].cp > 0xFFFF;
+  size_t start = b->length, offset;
+
+  buf_put_2be(b, 0);		/* version */
+  buf_put_2be(b, full ? 2 : 1);
+  buf_put_2be(b, 3);		/* Windows */
+  buf_put_2be(b, 1);		/* Unicode BMP */
+  buf_put_4be(b, full ? 20 : 12);
+  if (full) {
+    buf_put_2be(b, 3);		/* Windows */
+    buf_put_2be(b, 10);		/* Unicode full repertoire */
+    buf_put_4be(b, 0);		/* Filled in below */
+  }
+  if (!put_format4(b, e, n)) return false;
+  if (full) {
+    offset = b->length - start;
+    if (!b->failed) {
+      b->data[start + 16] = (offset >> 24) & 0xff;
+      b->data[start + 17] = (offset >> 16) & 0xff;
+      b->data[start + 18] = (offset >> 8) & 0xff;
+      b->data[start + 19] = offset & 0xff;
+    }
+    put_format12(b, e, n);
+  }
+  return true;
+}
+
+
+/* add_change -- add a table made in a buffer to a list of changes */
+static void add_change(sfnt_table changes[], size_t *n, const char *tag,
+		       const buffer *b)
+{
+  memcpy(changes[*n].tag, tag, 4);
+  changes[*n].data = b->data ? b->data : (const unsigned char*)"";
+  changes[(*n)++].length = b->length;
+}
+
+
+/* trim_maxp -- copy maxp with numGlyphs set to n */
+static eot_status trim_maxp(sfnt_offset_table sfnt, unsigned short n,
+			    buffer *maxp)
+{
+  view t;
+
+  if (!find_table(sfnt, "maxp", &t) || t.length < 6)
+    return EOT_ERR_MISSING_TABLE;
+  buf_put_bytes(maxp, t.data, 4);
+  buf_put_2be(maxp, n);
+  buf_put_bytes(maxp, t.data + 6, t.length - 6);
+  return EOT_OK;
+}
+
+
+/* trim_metrics -- cut hmtx or vmtx to n glyphs and adjust hhea or vhea
+ *
+ * Both tables are left empty if the font does not have them.
+ */
+static eot_status trim_metrics(sfnt_offset_table sfnt, const char *heatag,
+			       const char *mtxtag, unsigned short n,
+			       buffer *hea, buffer *mtx)
+{
+  unsigned short nmetrics;
+  view h, m;
+
+  if (!find_table(sfnt, heatag, &h) || !find_table(sfnt, mtxtag, &m))
+    return EOT_OK;
+  if (!get_2_at(h, 34, &nmetrics)) return EOT_ERR_TRUNCATED;
+  if (nmetrics > n) nmetrics = n;
+  if (m.length < 4 * (size_t)nmetrics + 2 * (size_t)(n - nmetrics))
+    return EOT_ERR_TRUNCATED;
+  buf_put_bytes(hea, h.data, 34);
+  buf_put_2be(hea, nmetrics);
+  buf_put_bytes(hea, h.data + 36, h.length - 36);
+  buf_put_bytes(mtx, m.data, 4 * nmetrics + 2 * (n - nmetrics));
+  return EOT_OK;
+}
+
+
+/* trim_post -- cut the glyph names of a version 2 post table to n glyphs
+ *
+ * Names that only the removed glyphs used are removed, too. *post is
+ * left empty if the table has no glyph names.
+ */
+static eot_status trim_post(sfnt_offset_table sfnt, unsigned short n,
+			    buffer *post)
+{
+  unsigned short oldn, i, index, nnames = 0;
+  unsigned long version;
+  unsigned char len;
+  view t;
+
+  if (!find_table(sfnt, "post", &t) || !get_4_at(t, 0, &version) ||
+      version != POST_NAMES)
+    return EOT_OK;
+  if (!get_2_at(t, 32, &oldn) || oldn < n ||
+      t.length < 34 + 2 * (size_t)oldn) return EOT_ERR_TRUNCATED;
+  for (i = 0; i < n; i++) {
+    (void) get_2_at(t, 34 + 2 * i, &index);
+    if (index >= POST_STANDARD_NAMES && index - 257 > nnames)
+      nnames = index - 257;
+  }
+  /* The names are Pascal strings, in the order of their indexes */
+  t.pos = 34 + 2 * oldn;
+  for (i = 0; i < nnames; i++)
+    if (!get_1(&t, &len) || t.length - t.pos < len) return EOT_ERR_TRUNCATED;
+    else t.pos += len;
+  buf_put_bytes(post, t.data, 32);
+  buf_put_2be(post, n);
+  buf_put_bytes(post, t.data + 34, 2 * n);
+  buf_put_bytes(post, t.data + 34 + 2 * oldn, t.pos - (34 + 2 * oldn));
+  return EOT_OK;
+}
+
+
+/* trim_hdmx -- cut the device records of hdmx to n glyphs */
+static eot_status trim_hdmx(sfnt_offset_table sfnt, unsigned short n,
+			    buffer *hdmx)
+{
+  unsigned long oldsize, newsize = (n + 2 + 3) & ~3UL;
+  unsigned short nrecords, i;
+  view t;
+
+  if (!find_table(sfnt, "hdmx", &t)) return EOT_OK;
+  if (!get_2_at(t, 2, &nrecords) || !get_4_at(t, 4, &oldsize) ||
+      oldsize < n + 2UL || (t.length - 8) / oldsize < nrecords)
+    return EOT_ERR_TRUNCATED;
+  buf_put_bytes(hdmx, t.data, 4);
+  buf_put_4be(hdmx, newsize);
+  for (i = 0; i < nrecords; i++) {
+    buf_put_bytes(hdmx, t.data + 8 + i * oldsize, n + 2);
+    while (hdmx->length % 4) buf_put_1(hdmx, 0);
+  }
+  return EOT_OK;
+}
+
+
+/* trim_ltsh -- cut the yPels of LTSH to n glyphs */
+static eot_status trim_ltsh(sfnt_offset_table sfnt, unsigned short n,
+			    buffer *ltsh)
+{
+  view t;
+
+  if (!find_table(sfnt, "LTSH", &t)) return EOT_OK;
+  if (t.length < 4 + (size_t)n) return EOT_ERR_TRUNCATED;
+  buf_put_bytes(ltsh, t.data, 2);
+  buf_put_2be(ltsh, n);
+  buf_put_bytes(ltsh, t.data + 4, n);
+  return EOT_OK;
+}
+
+
+/* trim_glyphs -- cut the tables that are indexed by glyph to n glyphs
+ *
+ * The tables are made in tables[] and added to changes.
+ */
+static eot_status trim_glyphs(sfnt_offset_table sfnt, unsigned short n,
+			      buffer tables[NTRIMMED], sfnt_table changes[],
+			      size_t *nchanges)
+{
+  static const char tags[NTRIMMED][5] = {
+    "maxp", "hhea", "hmtx", "vhea", "vmtx", "post", "hdmx", "LTSH"};
+  eot_status e;
+  int i;
+
+  if ((e = trim_maxp(sfnt, n, &tables[0])) != EOT_OK) return e;
+  if ((e = trim_metrics(sfnt, "hhea", "hmtx", n, &tables[1], &tables[2]))
+      != EOT_OK) return e;
+  if ((e = trim_metrics(sfnt, "vhea", "vmtx", n, &tables[3], &tables[4]))
+      != EOT_OK) return e;
+  if ((e = trim_post(sfnt, n, &tables[5])) != EOT_OK) return e;
+  if ((e = trim_hdmx(sfnt, n, &tables[6])) != EOT_OK) return e;
+  if ((e = trim_ltsh(sfnt, n, &tables[7])) != EOT_OK) return e;
+  for (i = 0; i < NTRIMMED; i++)
+    if (tables[i].length) add_change(changes, nchanges, tags[i], &tables[i]);
+  return EOT_OK;
+}
+
+
+/* subset_font -- write a font with only the glyphs for some characters */
+eot_status subset_font(const unsigned char *font, size_t size,
+		       const eot_unicode_range ranges[], size_t nranges,
+		       buffer *out)
+{
+  sfnt_offset_table sfnt;
+  cmap_list cmap = {NULL, 0, 0};
+  glyph_set set = {NULL, 0, false};
+  buffer glyf, loca, newcmap, trimmed[NTRIMMED];
+  sfnt_table changes[4 + NTRIMMED];
+  bool long_format, symbol, failed, remap;
+  view glyfv, locav, g;
+  size_t i, n, nchanges;
+  unsigned short nglyphs;
+  eot_status e;
+
+  buf_init(&glyf);
+  buf_init(&loca);
+  buf_init(&newcmap);
+  for (i = 0; i < NTRIMMED; i++) buf_init(&trimmed[i]);
+  if ((e = read_sfnt_header(font, size, &sfnt)) != EOT_OK) goto done;
+  if (!find_table(sfnt, "glyf", &glyfv) ||
+      !find_table(sfnt, "loca", &locav)) {
+    e = EOT_ERR_OUTLINES;
+    goto done;
+  }
+  if (!get_glyf_info(sfnt, &set.nglyphs, &long_format)) {
+    e = EOT_ERR_MISSING_TABLE;
+    goto done;
+  }
+  if ((e = read_cmap(sfnt, &cmap, &symbol)) != EOT_OK) goto done;
+
+  /* Select the glyphs of the characters, symbol fonts at U+F0xx */
+  if (!(set.keep = counted_calloc(set.nglyphs ? set.nglyphs : 1, 1))) {
+    e = EOT_ERR_NOMEM;
+    goto done;
+  }
+  keep(&set, 0);
+  for (i = 0, n = 0; i < cmap.n; i++)
+    if (in_ranges(cmap.entries[i].cp, ranges, nranges) ||
+	(symbol && cmap.entries[i].cp >= 0xF000 &&
+	 cmap.entries[i].cp <= 0xF0FF &&
+	 in_ranges(cmap.entries[i].cp - 0xF000, ranges, nranges))) {
+      keep(&set, cmap.entries[i].gid);
+      cmap.entries[n++] = cmap.entries[i];
+    }
+  cmap.n = n;
+
+  /* Add components and substitutions until nothing changes */
+  do {
+    set.changed = false;
+    close_composites(glyfv, locav, long_format, &set);
+    if ((e = close_gsub(sfnt, &set)) != EOT_OK) goto done;
+  } while (set.changed);
+
+  /* A new cmap only maps to kept glyphs, so those after them can go */
+  qsort(cmap.entries, cmap.n, sizeof(cmap.entries[0]), compare_entries);
+  remap = !symbol && build_cmap(cmap.entries, cmap.n, &newcmap);
+  nglyphs = set.nglyphs;
+  if (remap) while (nglyphs > 1 && !set.keep[nglyphs - 1]) nglyphs--;
+
+  /* Copy the kept glyphs, leave the others empty */
+  for (i = 0; i < nglyphs; i++) {
+    if (long_format) buf_put_4be(&loca, glyf.length);
+    else buf_put_2be(&loca, glyf.length / 2);
+    if (!set.keep[i]) continue;
+    if (!get_glyph(glyfv, locav, long_format, i, &g)) {
+      e = EOT_ERR_TRUNCATED;
+      goto done;
+    }
+    buf_put_bytes(&glyf, g.data, g.length);
+    while (glyf.length % (long_format ? 4 : 2)) buf_put_1(&glyf, 0);
+  }
+  if (long_format) buf_put_4be(&loca, glyf.length);
+  else buf_put_2be(&loca, glyf.length / 2);
+
+  nchanges = 0;
+  add_change(changes, &nchanges, "glyf", &glyf);
+  add_change(changes, &nchanges, "loca", &loca);
+  memcpy(changes[nchanges].tag, "DSIG", 4);
+  changes[nchanges].data = NULL;
+  changes[nchanges++].length = 0;
+  if (remap) add_change(changes, &nchanges, "cmap", &newcmap);
+  if (nglyphs < set.nglyphs &&
+      (e = trim_glyphs(sfnt, nglyphs, trimmed, changes, &nchanges)) != EOT_OK)
+    goto done;
+  for (i = 0, failed = false; i < NTRIMMED; i++)
+    failed = failed || trimmed[i].failed;
+  if (failed || glyf.failed || loca.failed || newcmap.failed)
+    e = EOT_ERR_NOMEM;
+  else e = rebuild_sfnt(sfnt, nchanges, changes, out);
+
+ done:
+  free_sfnt_header(&sfnt);
+  free(cmap.entries);
+  free(set.keep);
+  free(glyf.data);
+  free(loca.data);
+  free(newcmap.data);
+  for (i = 0; i < NTRIMMED; i++) free(trimmed[i].data);
+  return e;
+}
@@ -0,0 +1,17 @@
+/* subset.h -- reduce a TrueType font to the glyphs for some characters
+ * (internal to libeot)
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef SUBSET_H
+#define SUBSET_H
+
+#include "sfnt.h"
+
+extern eot_status subset_font(const unsigned char *font, size_t size,
+			      const eot_unicode_range ranges[], size_t nranges,
+			      buffer *out);
+
+#endif /* SUBSET_H */
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+# make-fonts.py -- write the test fonts in this directory
+#
+# Needs fontTools (with brotli, for WOFF 2.0). The fonts are committed,
+# so "make check" does not need it; run this only to change them.
+#
+#   test.ttf        a small TrueType font: simple and composite glyphs,
+#                   hinting instructions, cvt, fpgm and prep, and the
+#                   tables indexed by glyph that --subset cuts
+#   test.woff       test.ttf as WOFF
+#   test.woff2      test.ttf as WOFF 2.0, with the glyf transform
+
+import array
+import os
+from fontTools.fontBuilder import FontBuilder
+from fontTools.pens.ttGlyphPen import TTGlyphPen
+from fontTools.ttLib import TTFont, newTable
+from fontTools.ttLib.tables import ttProgram
+from fontTools.ttLib.tables._g_l_y_f import GlyphComponent
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+
+def program(asm):
+    p = ttProgram.Program()
+    p.fromAssembly(asm)
+    return p
+
+
+def rect(pen, x0, y0, x1, y1):
+    pen.moveTo((x0, y0))
+    pen.lineTo((x0, y1))
+    pen.lineTo((x1, y1))
+    pen.lineTo((x1, y0))
+    pen.closePath()
+
+
+def glyphs():
+    g = {}
+    pen = TTGlyphPen(None)
+    rect(pen, 50, 0, 450, 700)
+    rect(pen, 100, 50, 400, 650)
+    g[".notdef"] = pen.glyph()
+    g["space"] = TTGlyphPen(None).glyph()
+    pen = TTGlyphPen(None)
+    pen.moveTo((20, 0))
+    pen.lineTo((250, 700))
+    pen.lineTo((480, 0))
+    pen.lineTo((380, 0))
+    pen.qCurveTo((300, 200), (250, 200), (200, 200))
+    pen.lineTo((120, 0))
+    pen.closePath()
+    g["A"] = pen.glyph()
+    pen = TTGlyphPen(None)
+    pen.moveTo((80, 0))
+    pen.lineTo((80, 700))
+    pen.qCurveTo((460, 700), (460, 360))
+    pen.qCurveTo((460, 0), (80, 0))
+    pen.closePath()
+    rect(pen, 160, 80, 300, 620)
+    g["B"] = pen.glyph()
+    return g
+
+
+def main():
+    fb = FontBuilder(1000, isTTF=True)
+    order = [".notdef", "space", "A", "B", "Aacute", "acute"]
+    fb.setupGlyphOrder(order)
+    fb.setupCharacterMap({0x20: "space", 0x41: "A", 0x42: "B",
+                          0xB4: "acute", 0xC1: "Aacute"})
+    g = glyphs()
+    pen = TTGlyphPen(None)
+    pen.moveTo((200, 750))
+    pen.lineTo((300, 900))
+    pen.lineTo((360, 900))
+    pen.lineTo((240, 750))
+    pen.closePath()
+    g["acute"] = pen.glyph()
+    g["Aacute"] = TTGlyphPen(None).glyph()
+    fb.setupGlyf(g)
+    glyf = fb.font["glyf"]
+    composite = glyf["Aacute"]
+    composite.numberOfContours = -1
+    composite.components = []
+    for name, dx in (("A", 0), ("acute", 10)):
+        c = GlyphComponent()
+        c.glyphName, c.x, c.y, c.flags = name, dx, 0, 0x4
+        composite.components.append(c)
+    composite.program = program("PUSHB[ ] 1 0\nMDAP[1]\nPOP[ ]")
+    glyf["A"].program = program(
+        "PUSHB[ ] 0 1\nMIAP[1]\nPUSHW[ ] 300 -2 1000\nPOP[ ]\nPOP[ ]\nPOP[ ]")
+    glyf["B"].program = program(
+        "NPUSHB[ ] 9 1 2 3 4 5 6 7 8 9\nSVTCA[0]\n"
+        "POP[ ]\nPOP[ ]\nPOP[ ]\nPOP[ ]\nPOP[ ]\nPOP[ ]\nPOP[ ]\nPOP[ ]\nPOP[ ]")
+    fb.setupHorizontalMetrics({".notdef": (500, 50), "space": (250, 0),
+                               "A": (500, 20), "B": (500, 80),
+                               "Aacute": (500, 20), "acute": (500, 200)})
+    fb.setupHorizontalHeader(ascent=900, descent=-200)
+    fb.setupNameTable({"familyName": "EOT Test", "styleName": "Regular",
+                       "uniqueFontIdentifier": "EOT Test Regular 1.0",
+                       "fullName": "EOT Test Regular",
+                       "version": "Version 1.0", "psName": "EOTTest-Regular"})
+    fb.setupOS2(fsType=0, usWinAscent=900, usWinDescent=200,
+                sTypoAscender=800, sTypoDescender=-200)
+    fb.setupPost()
+    fb.setupMaxp()
+    fb.font["cvt "] = newTable("cvt ")
+    fb.font["cvt "].values = array.array("h", [0, 20, -20, 700, 750, 900,
+                                                  -200, 3000])
+    fb.font["fpgm"] = newTable("fpgm")
+    fb.font["fpgm"].program = program("PUSHB[ ] 0\nFDEF[ ]\nPOP[ ]\nENDF[ ]")
+    fb.font["prep"] = newTable("prep")
+    fb.font["prep"].program = program("PUSHB[ ] 1\nPOP[ ]")
+    fb.setupVerticalMetrics({name: (1000, 100) for name in order})
+    fb.setupVerticalHeader(ascent=500, descent=-500)
+    fb.font["hdmx"] = newTable("hdmx")
+    fb.font["hdmx"].hdmx = {ppem: {name: (ppem * 500 + 999) // 1000
+                                   for name in order} for ppem in (12, 16)}
+    fb.font["LTSH"] = newTable("LTSH")
+    fb.font["LTSH"].yPels = {name: 1 for name in order}
+    fb.font["maxp"].maxFunctionDefs = 1
+    fb.font["maxp"].maxStackElements = 16
+    fb.save(os.path.join(here, "test.ttf"))
+
+    for flavor in ("woff", "woff2"):
+        f = TTFont(os.path.join(here, "test.ttf"))
+        f.flavor = flavor
+        f.save(os.path.join(here, "test." + flavor))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,28 @@
+#!/bin/sh
+# roundtrip.sh -- make EOT files, verify them and extract the font again
+#
+# Without --subset, the extracted font must be the original, byte for
+# byte; with --subset, the EOT file must at least pass --verify.
+
+font=$srcdir/tests/test.ttf
+tmp=tests/roundtrip.tmp
+rm -rf $tmp && mkdir $tmp || exit 99
+trap 'rm -rf $tmp' 0
+
+for opts in "" "--xor" "--fix-checksums" "--verify-font --xor"; do
+  ./mkeot $opts $font http://example.org/ http://example.com/a/ \
+    >$tmp/t.eot || { echo "FAIL: mkeot $opts"; exit 1; }
+  ./eotinfo --verify $tmp/t.eot || { echo "FAIL: verify $opts"; exit 1; }
+  ./eotinfo --extract $tmp/t.ttf $tmp/t.eot >/dev/null ||
+    { echo "FAIL: extract $opts"; exit 1; }
+  cmp $font $tmp/t.ttf || { echo "FAIL: extracted $opts"; exit 1; }
+done
+
+for opts in "--subset U+41" "--subset U+20-7E --xor"; do
+  ./mkeot $opts $font http://example.org/ >$tmp/t.eot ||
+    { echo "FAIL: mkeot $opts"; exit 1; }
+  ./eotinfo --verify $tmp/t.eot || { echo "FAIL: verify $opts"; exit 1; }
+  ./eotinfo --extract $tmp/t.ttf $tmp/t.eot >/dev/null ||
+    { echo "FAIL: extract $opts"; exit 1; }
+done
+exit 0
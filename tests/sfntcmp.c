@@ -0,0 +1,248 @@
+/* sfntcmp -- compare the tables of two OpenType fonts
+ *
+ * Usage: sfntcmp font1 font2. Exits 0 if both fonts have the same
+ * tables with the same contents, 1 if not, 2 on errors. The order of
+ * the tables in the files does not matter. Differences that decoding
+ * a WOFF file may legitimately make are ignored: the checkSumAdjustment
+ * and bit 11 of the flags in the head table, the padding between the
+ * glyphs in the glyf table (and so the loca table) and whether runs of
+ * flags in a simple glyph use the repeat flag.
+ *
+ * This parses the fonts itself, rather than with libeot, so that it
+ * does not share the bugs it is meant to find.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
+#include <stdbool.h>
+#include <string.h>
+
+#define REPEAT 0x08		/* Simple glyph flag: repeat the flag */
+
+typedef struct {
+  const char *path;
+  unsigned char *data;
+  size_t size;
+  unsigned ntables;
+} font;
+
+typedef struct {
+  const unsigned char *data;
+  size_t size;
+} span;
+
+
+/* get2 -- read an unsigned 16-bit big-endian number */
+static unsigned get2(const unsigned char *p)
+{
+  return p[0] << 8 | p[1];
+}
+
+
+/* get4 -- read an unsigned 32-bit big-endian number */
+static unsigned long get4(const unsigned char *p)
+{
+  return (unsigned long)get2(p) << 16 | get2(p + 2);
+}
+
+
+/* load -- read a font and check its table directory */
+static void load(const char *path, font *f)
+{
+  FILE *fp;
+  size_t n = 0, max = 0;
+  unsigned i;
+
+  if (!(fp = fopen(path, "rb"))) err(2, "%s", path);
+  f->data = NULL;
+  do {
+    if (n == max && !(f->data = realloc(f->data, max += 65536)))
+      err(2, NULL);
+    n += fread(f->data + n, 1, max - n, fp);
+  } while (!feof(fp) && !ferror(fp));
+  if (ferror(fp)) err(2, "%s", path);
+  fclose(fp);
+  f->path = path;
+  f->size = n;
+  if (n < 12) errx(2, "%s: not an OpenType font", path);
+  f->ntables = get2(f->data + 4);
+  if (n < 12 + 16 * f->ntables) errx(2, "%s: truncated directory", path);
+  for (i = 0; i < f->ntables; i++) {
+    const unsigned char *e = f->data + 12 + 16 * i;
+    if (get4(e + 8) > n || get4(e + 12) > n - get4(e + 8))
+      errx(2, "%s: table %.4s is out of bounds", path, (const char *)e);
+  }
+}
+
+
+/* table -- find a table by its tag */
+static bool table(const font *f, const char *tag, span *s)
+{
+  unsigned i;
+
+  for (i = 0; i < f->ntables; i++) {
+    const unsigned char *e = f->data + 12 + 16 * i;
+    if (memcmp(e, tag, 4) == 0) {
+      s->data = f->data + get4(e + 8);
+      s->size = get4(e + 12);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+/* glyph -- find glyph i with the loca table, false if out of bounds */
+static bool glyph(const font *f, unsigned i, span *g)
+{
+  span head, loca, glyf;
+  unsigned long start, end;
+
+  if (!table(f, "head", &head) || head.size < 54 ||
+      !table(f, "loca", &loca) || !table(f, "glyf", &glyf))
+    return false;
+  if (get2(head.data + 50) == 0) {
+    if (loca.size < 2 * (i + 2)) return false;
+    start = 2 * get2(loca.data + 2 * i);
+    end = 2 * get2(loca.data + 2 * i + 2);
+  } else {
+    if (loca.size < 4 * (i + 2)) return false;
+    start = get4(loca.data + 4 * i);
+    end = get4(loca.data + 4 * i + 4);
+  }
+  if (start > end || end > glyf.size) return false;
+  g->data = glyf.data + start;
+  g->size = end - start;
+  return true;
+}
+
+
+/* same_glyph -- compare two glyphs, expanding the flags of simple ones */
+static bool same_glyph(span a, span b)
+{
+  const unsigned char *p, *q, *pend, *qend;
+  unsigned long npoints, n;
+  int ncontours;
+
+  if (a.size < 10 || b.size < 10) return a.size == b.size;
+  ncontours = (short)get2(a.data);
+  if (ncontours < 0) {		/* Composite: all but the padding */
+    while (a.size > b.size && a.data[a.size - 1] == 0) a.size--;
+    while (b.size > a.size && b.data[b.size - 1] == 0) b.size--;
+    return a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+  }
+  /* Header, end points of contours and instructions */
+  n = 10 + 2 * ncontours;
+  if (a.size < n + 2 || b.size < n + 2) return false;
+  n += 2 + get2(a.data + n);
+  if (a.size < n || b.size < n || memcmp(a.data, b.data, n) != 0)
+    return false;
+  npoints = ncontours ? get2(a.data + 10 + 2 * ncontours - 2) + 1 : 0;
+  /* Flags, expanded */
+  p = a.data + n; pend = a.data + a.size;
+  q = b.data + n; qend = b.data + b.size;
+  {
+    unsigned long ra = 0, rb = 0;
+    unsigned char fa = 0, fb = 0;
+    for (; npoints > 0; npoints--) {
+      if (ra) ra--;
+      else {
+	if (p == pend) return false;
+	fa = *p++;
+	if (fa & REPEAT) { if (p == pend) return false; ra = *p++; }
+      }
+      if (rb) rb--;
+      else {
+	if (q == qend) return false;
+	fb = *q++;
+	if (fb & REPEAT) { if (q == qend) return false; rb = *q++; }
+      }
+      if ((fa & ~REPEAT) != (fb & ~REPEAT)) return false;
+    }
+    if (ra || rb) return false;
+  }
+  /* Coordinates, ignoring the padding */
+  while (pend > p && pend[-1] == 0 && pend - p > qend - q) pend--;
+  while (qend > q && qend[-1] == 0 && qend - q > pend - p) qend--;
+  return pend - p == qend - q && memcmp(p, q, pend - p) == 0;
+}
+
+
+/* same_glyf -- compare the glyf tables of two fonts, glyph by glyph */
+static bool same_glyf(const font *a, const font *b)
+{
+  span maxp, ga, gb;
+  unsigned i, n;
+
+  if (!table(a, "maxp", &maxp) || maxp.size < 6) return false;
+  n = get2(maxp.data + 4);
+  for (i = 0; i < n; i++) {
+    if (!glyph(a, i, &ga) || !glyph(b, i, &gb)) return false;
+    if (!same_glyph(ga, gb)) {
+      warnx("glyph %u differs", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+
+/* same_head -- compare head tables, except checkSumAdjustment and bit 11 */
+static bool same_head(span a, span b)
+{
+  if (a.size != b.size || a.size < 54) return false;
+  return memcmp(a.data, b.data, 8) == 0 &&
+    memcmp(a.data + 12, b.data + 12, 4) == 0 &&
+    (get2(a.data + 16) & ~0x800) == (get2(b.data + 16) & ~0x800) &&
+    memcmp(a.data + 18, b.data + 18, a.size - 18) == 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+  font a, b;
+  span ta, tb;
+  unsigned i;
+  bool same = true;
+
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s font1 font2\n", argv[0]);
+    return 2;
+  }
+  load(argv[1], &a);
+  load(argv[2], &b);
+  if (a.ntables != b.ntables) {
+    warnx("%s has %u tables, %s has %u", a.path, a.ntables, b.path,
+	  b.ntables);
+    return 1;
+  }
+  for (i = 0; i < a.ntables; i++) {
+    const char *tag = (const char *)a.data + 12 + 16 * i;
+    bool ok;
+
+    if (!table(&b, tag, &tb)) {
+      warnx("%s has no %.4s table", b.path, tag);
+      same = false;
+      continue;
+    }
+    (void) table(&a, tag, &ta);
+    if (memcmp(tag, "head", 4) == 0) ok = same_head(ta, tb);
+    else if (memcmp(tag, "glyf", 4) == 0) ok = same_glyf(&a, &b);
+    else if (memcmp(tag, "loca", 4) == 0) ok = true; /* Checked by glyf */
+    else ok = ta.size == tb.size && memcmp(ta.data, tb.data, ta.size) == 0;
+    if (!ok) {
+      warnx("table %.4s differs", tag);
+      same = false;
+    }
+  }
+  free(a.data);
+  free(b.data);
+  return same ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# template.sh -- check that --from-template gives what a direct run gives
+#
+# The EOT file made from a template must be the same, byte for byte, as
+# the one made directly from the font with the same options and URLs.
+
+font=$srcdir/tests/test.ttf
+tmp=tests/template.tmp
+rm -rf $tmp && mkdir $tmp || exit 99
+trap 'rm -rf $tmp' 0
+
+for opts in "" "--xor" "--subset U+41-42"; do
+  ./mkeot $opts --template $tmp/t.eott $font ||
+    { echo "FAIL: template $opts"; exit 1; }
+  for urls in "" "http://example.org/" \
+    "http://example.org/ https://example.com/fonts/ http://a.example/"; do
+    ./mkeot --from-template $tmp/t.eott $urls >$tmp/a.eot &&
+      ./mkeot $opts $font $urls >$tmp/b.eot ||
+      { echo "FAIL: mkeot $opts $urls"; exit 1; }
+    cmp $tmp/a.eot $tmp/b.eot || { echo "FAIL: $opts $urls"; exit 1; }
+  done
+done
+exit 0
@@ -0,0 +1,29 @@
+#!/bin/sh
+# woff.sh -- check that WOFF and WOFF 2.0 fonts decode to the original
+#
+# test.woff and test.woff2 were made from test.ttf by fontTools (see
+# make-fonts.py). The font extracted from the EOT file must have the
+# same tables as test.ttf, up to what sfntcmp allows a decoder to change.
+# Exits 77 (skipped) for formats mkeot was built without.
+
+tmp=tests/woff.tmp
+rm -rf $tmp && mkdir $tmp || exit 99
+trap 'rm -rf $tmp' 0
+
+skipped=0
+for format in woff woff2; do
+  if ! ./mkeot $srcdir/tests/test.$format http://example.org/ \
+    >$tmp/t.eot 2>$tmp/err; then
+    if grep -q 'built without' $tmp/err; then
+      cat $tmp/err; skipped=`expr $skipped + 1`; continue
+    fi
+    cat $tmp/err; echo "FAIL: mkeot $format"; exit 1
+  fi
+  ./eotinfo --verify $tmp/t.eot || { echo "FAIL: verify $format"; exit 1; }
+  ./eotinfo --extract $tmp/t.ttf $tmp/t.eot >/dev/null ||
+    { echo "FAIL: extract $format"; exit 1; }
+  tests/sfntcmp $srcdir/tests/test.ttf $tmp/t.ttf ||
+    { echo "FAIL: $format"; exit 1; }
+done
+test $skipped = 2 && exit 77
+exit 0
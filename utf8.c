@@ -0,0 +1,139 @@
+/* utf8 -- convert URLs from UTF-8 to the UTF-16LE of a RootString
+ *
+ * URLs are mostly ASCII, so runs of ASCII are handled 16 bytes at a
+ * time with SSE2 (always present on x86-64): a movemask tells if any
+ * byte has its high bit set, and if none has, interleaving with zeros
+ * gives the UTF-16LE. Other characters are decoded one at a time, and
+ * invalid UTF-8 (overlong forms, surrogates, truncated sequences, code
+ * points above U+10FFFF) is rejected.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stddef.h>
+#include <stdbool.h>
+#include "utf8.h"
+
+#if defined(HAVE_IMMINTRIN_H) && defined(__SSE2__)
+# include <immintrin.h>
+# define UTF8_SSE2 1
+#endif
+
+
+/* ascii_run -- the number of ASCII bytes at the start of s */
+static size_t ascii_run(const unsigned char *s, size_t len)
+{
+  size_t i = 0;
+#ifdef UTF8_SSE2
+  int m;
+
+  for (; i + 16 <= len; i += 16)
+    if ((m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(s + i)))))
+      return i + __builtin_ctz(m);
+#endif
+  while (i < len && s[i] < 0x80) i++;
+  return i;
+}
+
+
+/* widen_ascii -- copy the ASCII at the start of s as UTF-16LE to out
+ *
+ * Returns the number of bytes of s that were copied.
+ */
+static size_t widen_ascii(const unsigned char *s, size_t len,
+			  unsigned char *out)
+{
+  size_t i = 0;
+#ifdef UTF8_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  __m128i x;
+
+  for (; i + 16 <= len; i += 16) {
+    x = _mm_loadu_si128((const __m128i*)(s + i));
+    if (_mm_movemask_epi8(x)) break;
+    _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_unpacklo_epi8(x, zero));
+    _mm_storeu_si128((__m128i*)(out + 2 * i + 16), _mm_unpackhi_epi8(x, zero));
+  }
+#endif
+  for (; i < len && s[i] < 0x80; i++) {
+    out[2 * i] = s[i];
+    out[2 * i + 1] = '\0';
+  }
+  return i;
+}
+
+
+/* decode -- decode one non-ASCII character, return its length or 0 */
+static size_t decode(const unsigned char *s, size_t len, unsigned long *c)
+{
+  static const unsigned long min[] = {0, 0, 0x80, 0x800, 0x10000};
+  size_t n, i;
+
+  if (s[0] >= 0xC2 && s[0] <= 0xDF) {n = 2; *c = s[0] & 0x1F;}
+  else if (s[0] >= 0xE0 && s[0] <= 0xEF) {n = 3; *c = s[0] & 0x0F;}
+  else if (s[0] >= 0xF0 && s[0] <= 0xF4) {n = 4; *c = s[0] & 0x07;}
+  else return 0;			/* Continuation byte or not UTF-8 */
+  if (len < n) return 0;
+  for (i = 1; i < n; i++) {
+    if ((s[i] & 0xC0) != 0x80) return 0;
+    *c = (*c << 6) | (s[i] & 0x3F);
+  }
+  if (*c < min[n] || *c > 0x10FFFF || (*c >= 0xD800 && *c <= 0xDFFF))
+    return 0;
+  return n;
+}
+
+
+/* utf16_length -- the size in UTF-16 of len bytes of UTF-8, or false */
+bool utf16_length(const unsigned char *s, size_t len, size_t *n)
+{
+  unsigned long c;
+  size_t i = 0, k;
+
+  *n = 0;
+  for (;;) {
+    k = ascii_run(s + i, len - i);
+    i += k;
+    *n += 2 * k;
+    if (i == len) return true;
+    if (!(k = decode(s + i, len - i, &c))) return false;
+    i += k;
+    *n += c >= 0x10000 ? 4 : 2;
+  }
+}
+
+
+/* put_unit -- store a UTF-16 code unit in little endian order */
+static unsigned char *put_unit(unsigned char *out, unsigned long u)
+{
+  out[0] = u & 0xFF;
+  out[1] = u >> 8;
+  return out + 2;
+}
+
+
+/* utf8_to_utf16le -- convert valid UTF-8, return the end of the output */
+unsigned char *utf8_to_utf16le(const unsigned char *s, size_t len,
+			       unsigned char *out)
+{
+  unsigned long c;
+  size_t i = 0, k;
+
+  for (;;) {
+    k = widen_ascii(s + i, len - i, out);
+    i += k;
+    out += 2 * k;
+    if (i == len) return out;
+    i += decode(s + i, len - i, &c);
+    if (c < 0x10000) {
+      out = put_unit(out, c);
+    } else {			/* A surrogate pair */
+      out = put_unit(out, 0xD800 | ((c - 0x10000) >> 10));
+      out = put_unit(out, 0xDC00 | (c & 0x3FF));
+    }
+  }
+}
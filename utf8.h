@@ -0,0 +1,17 @@
+/* utf8.h -- convert URLs from UTF-8 to UTF-16LE (internal to libeot)
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+extern bool utf16_length(const unsigned char *s, size_t len, size_t *n);
+extern unsigned char *utf8_to_utf16le(const unsigned char *s, size_t len,
+				      unsigned char *out);
+
+#endif /* UTF8_H */
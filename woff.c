@@ -0,0 +1,802 @@
+/* woff -- turn WOFF and WOFF 2.0 files into OpenType fonts
+ *
+ * The font is built in a single buffer. Room for the table directory
+ * is reserved at the start, and each table is decompressed straight
+ * into its place after it, without intermediate copies: WOFF tables
+ * are compressed one by one with zlib, and the single Brotli stream of
+ * a WOFF 2.0 file is decoded incrementally, with the decoder's output
+ * pointed at the next table each time the previous one is full.
+ *
+ * WOFF 2.0 may store the glyf and loca tables (and hmtx) transformed.
+ * Their data is decompressed to a scratch buffer instead and the
+ * tables are rebuilt after the others, at the end of the font. The
+ * glyf transform encodes points with the triplets of MicroType
+ * Express, see glyf.c. A WOFF 2.0 collection becomes a TrueType
+ * Collection.
+ *
+ * The table checksums and head.checkSumAdjustment are computed for
+ * the new font, not copied from the file.
+ *
+ * zlib and Brotli are optional. Without zlib, only WOFF files with
+ * uncompressed tables can be read, without Brotli, no WOFF 2.0 files.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "woff.h"
+#include "glyf.h"
+#include "alloc.h"
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+# include <zlib.h>
+# define WOFF_ZLIB 1
+#endif
+#if defined(HAVE_BROTLI_DECODE_H) && defined(HAVE_LIBBROTLIDEC)
+# include <brotli/decode.h>
+# define WOFF_BROTLI 1
+#endif
+
+#define WOFF_HEADER_SIZE 44
+#define WOFF2_HEADER_SIZE 48
+#define OFFSET_TOTAL_COMPRESSED_SIZE 20	/* In the WOFF 2.0 header */
+#define OFFSET_NUM_H_METRICS 34	/* In the hhea table */
+#define WOFF_MAX_SIZE (1UL << 30)	/* Larger fonts are taken to be corrupt */
+
+/* The tags that a WOFF 2.0 table directory encodes in 6 bits */
+static const char *const known_tags[63] = {
+  "cmap", "head", "hhea", "hmtx", "maxp", "name", "OS/2", "post", "cvt ",
+  "fpgm", "glyf", "loca", "prep", "CFF ", "VORG", "EBDT", "EBLC", "gasp",
+  "hdmx", "kern", "LTSH", "PCLT", "VDMX", "vhea", "vmtx", "BASE", "GDEF",
+  "GPOS", "GSUB", "EBSC", "JSTF", "MATH", "CBDT", "CBLC", "COLR", "CPAL",
+  "SVG ", "sbix", "acnt", "avar", "bdat", "bloc", "bsln", "cvar", "fdsc",
+  "feat", "fmtx", "fvar", "gvar", "hsty", "just", "lcar", "mort", "morx",
+  "opbd", "prop", "trak", "Zapf", "Silf", "Glat", "Gloc", "Feat", "Sill"};
+
+/* The seven streams of a transformed glyf table */
+enum {N_CONTOURS, N_POINTS, FLAGS, GLYPHS, COMPOSITES, BBOXES, INSTRUCTIONS,
+      NSTREAMS};
+
+typedef struct {		/* A table of a WOFF or WOFF 2.0 file */
+  unsigned long tag;
+  unsigned long length;		/* In the font */
+  unsigned long offset;		/* In the font, or 0 until it is placed */
+  unsigned long checkSum;
+  unsigned long stored;		/* Length in the file or Brotli stream */
+  const unsigned char *data;	/* Compressed (WOFF) or transformed data */
+  bool transformed;		/* WOFF 2.0: must be rebuilt */
+  short *xMin;			/* Rebuilt glyf: the xMin of each glyph */
+  unsigned short numGlyphs;	/* Rebuilt glyf: the length of xMin */
+} woff_table;
+
+typedef struct {		/* A font of the file */
+  unsigned long flavor;		/* Its sfnt version */
+  unsigned short numTables;
+  unsigned short *index;	/* Its tables, as indexes in the directory */
+} woff_font;
+
+typedef struct {		/* A WOFF or WOFF 2.0 file being decoded */
+  buffer *out;
+  size_t start;			/* Where the font starts in out */
+  unsigned short numTables;
+  woff_table *tables;
+  bool collection;		/* Make a TrueType Collection */
+  unsigned long ttcVersion;
+  unsigned short numFonts;
+  woff_font *fonts;
+} woff_file;
+
+
+/* get_base128 -- read a number in the UIntBase128 format of WOFF 2.0 */
+static bool get_base128(view *v, unsigned long *x)
+{
+  unsigned char b;
+  int i;
+
+  *x = 0;
+  for (i = 0; i < 5; i++) {
+    if (!get_1(v, &b)) return false;
+    if (i == 0 && b == 0x80) return false; /* Leading zeros */
+    if (*x & 0xFE000000UL) return false;   /* More than 32 bits */
+    *x = (*x << 7) | (b & 0x7F);
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+
+/* alloc_tables -- allocate the table directory of a file */
+static eot_status alloc_tables(woff_file *w, unsigned short n)
+{
+  if (n == 0) return EOT_ERR_WOFF;
+  if (!(w->tables = counted_calloc(n, sizeof(*w->tables))))
+    return EOT_ERR_NOMEM;
+  w->numTables = n;
+  return EOT_OK;
+}
+
+
+/* single_font -- make the file hold one font with all tables */
+static eot_status single_font(woff_file *w, unsigned long flavor)
+{
+  unsigned short i;
+
+  if (!(w->fonts = counted_calloc(1, sizeof(*w->fonts))) ||
+      !(w->fonts[0].index =
+	counted_malloc(w->numTables * sizeof(unsigned short))))
+    return EOT_ERR_NOMEM;
+  w->numFonts = 1;
+  w->fonts[0].flavor = flavor;
+  w->fonts[0].numTables = w->numTables;
+  for (i = 0; i < w->numTables; i++) w->fonts[0].index[i] = i;
+  return EOT_OK;
+}
+
+
+/* free_woff -- free the memory allocated for the directories */
+static void free_woff(woff_file *w)
+{
+  unsigned short i;
+
+  for (i = 0; i < w->numTables; i++) free(w->tables[i].xMin);
+  for (i = 0; i < w->numFonts; i++) free(w->fonts[i].index);
+  free(w->tables);
+  free(w->fonts);
+}
+
+
+/* font_table -- find the table of font f with the given tag, or NULL */
+static woff_table *font_table(const woff_file *w, const woff_font *f,
+			      const char *tag)
+{
+  unsigned short i;
+
+  for (i = 0; i < f->numTables; i++)
+    if (w->tables[f->index[i]].tag == pack_tag(tag))
+      return &w->tables[f->index[i]];
+  return NULL;
+}
+
+
+/* directory_size -- the size of the directories of the font */
+static size_t directory_size(const woff_file *w)
+{
+  size_t n = 0;
+  unsigned short i;
+
+  if (w->collection)
+    n = 12 + 4UL * w->numFonts + (w->ttcVersion >= 0x00020000 ? 12 : 0);
+  for (i = 0; i < w->numFonts; i++) n += 12 + 16UL * w->fonts[i].numTables;
+  return n;
+}
+
+
+/* pad -- append zeros up to a multiple of 4 bytes from the start */
+static void pad(woff_file *w)
+{
+  while ((w->out->length - w->start) % 4) buf_put_1(w->out, 0);
+}
+
+
+/* reserve -- make room for the directories and the untransformed tables
+ *
+ * Those tables get their final places right away, so that they can be
+ * decompressed into them. Only the directories and the padding are
+ * cleared, the tables themselves are about to be overwritten. Room is
+ * also made for the original lengths of the transformed tables, so
+ * that the buffer usually does not move when they are rebuilt. Files
+ * that claim to hold more than WOFF_MAX_SIZE bytes are rejected before
+ * anything is allocated.
+ */
+static eot_status reserve(woff_file *w)
+{
+  size_t pos = directory_size(w), n = pos, more = 0;
+  woff_table *t;
+  unsigned short i;
+
+  for (i = 0; i < w->numTables; i++) {
+    if (w->tables[i].length > WOFF_MAX_SIZE) return EOT_ERR_WOFF;
+    if (w->tables[i].transformed) {
+      more += (w->tables[i].length + 3) & ~3UL;
+    } else {
+      w->tables[i].offset = pos;
+      pos += (w->tables[i].length + 3) & ~3UL;
+    }
+    if (pos + more > WOFF_MAX_SIZE) return EOT_ERR_WOFF;
+  }
+  if (!buf_reserve(w->out, pos + more)) return EOT_ERR_NOMEM;
+  memset(w->out->data + w->start, 0, n);
+  for (i = 0; i < w->numTables; i++) {
+    t = &w->tables[i];
+    if (!t->transformed)
+      memset(w->out->data + w->start + t->offset + t->length, 0,
+	     ((t->length + 3) & ~3UL) - t->length);
+  }
+  w->out->length = w->start + pos;
+  return EOT_OK;
+}
+
+
+/* compare_records -- compare two table records by tag, for qsort */
+static int compare_records(const void *a, const void *b)
+{
+  unsigned long s = ((const sfnt_table_record*)a)->tag;
+  unsigned long t = ((const sfnt_table_record*)b)->tag;
+
+  return (s > t) - (s < t);
+}
+
+
+/* put_directory -- write the offset table of font f, sorted by tag */
+static eot_status put_directory(woff_file *w, const woff_font *f)
+{
+  unsigned short searchRange = 1, entrySelector = 0, i;
+  sfnt_table_record *r;
+  const woff_table *t;
+
+  if (!(r = counted_malloc(f->numTables * sizeof(*r)))) return EOT_ERR_NOMEM;
+  for (i = 0; i < f->numTables; i++) {
+    t = &w->tables[f->index[i]];
+    r[i] = (sfnt_table_record){t->tag, t->checkSum, t->offset, t->length};
+  }
+  qsort(r, f->numTables, sizeof(*r), compare_records);
+  for (i = 1; i < f->numTables; i++)
+    if (r[i].tag == r[i-1].tag) {free(r); return EOT_ERR_WOFF;}
+
+  while (2 * searchRange <= f->numTables) {
+    searchRange *= 2;
+    entrySelector++;
+  }
+  buf_put_4be(w->out, f->flavor);
+  buf_put_2be(w->out, f->numTables);
+  buf_put_2be(w->out, 16 * searchRange);
+  buf_put_2be(w->out, entrySelector);
+  buf_put_2be(w->out, 16 * f->numTables - 16 * searchRange);
+  for (i = 0; i < f->numTables; i++) {
+    buf_put_4be(w->out, r[i].tag);
+    buf_put_4be(w->out, r[i].checkSum);
+    buf_put_4be(w->out, r[i].offset);
+    buf_put_4be(w->out, r[i].length);
+  }
+  free(r);
+  return EOT_OK;
+}
+
+
+/* finish -- compute the checksums and fill in the directories
+ *
+ * The directories are written over the space that reserve() kept for
+ * them, so the buffer does not move. The checkSumAdjustment of a
+ * collection's fonts is left 0, because it depends on which tables
+ * are counted; eot_extract_face sets it.
+ */
+static eot_status finish(woff_file *w)
+{
+  size_t end = w->out->length, pos, head = 0;
+  unsigned char *font;
+  woff_table *t;
+  unsigned short i;
+  eot_status e = EOT_OK;
+
+  if (w->out->failed) return EOT_ERR_NOMEM;
+  font = w->out->data + w->start;
+  for (i = 0; i < w->numTables; i++) {
+    t = &w->tables[i];
+    if (!t->offset) return EOT_ERR_WOFF; /* E.g., a loca without glyf */
+    t->checkSum = table_checksum(font + t->offset, t->length);
+    if (t->tag == pack_tag("head") && t->length >= 12) {
+      t->checkSum = (t->checkSum - table_checksum(font + t->offset + 8, 4))
+	& 0xFFFFFFFF;
+      memset(font + t->offset + 8, 0, 4);
+      head = t->offset;
+    }
+  }
+
+  w->out->length = w->start;
+  if (w->collection) {
+    buf_put_4be(w->out, SFNT_TTCF);
+    buf_put_4be(w->out, w->ttcVersion);
+    buf_put_4be(w->out, w->numFonts);
+    pos = 12 + 4UL * w->numFonts + (w->ttcVersion >= 0x00020000 ? 12 : 0);
+    for (i = 0; i < w->numFonts; i++) {
+      buf_put_4be(w->out, pos);
+      pos += 12 + 16UL * w->fonts[i].numTables;
+    }
+    if (w->ttcVersion >= 0x00020000)
+      for (i = 0; i < 3; i++) buf_put_4be(w->out, 0); /* No DSIG */
+  }
+  for (i = 0; i < w->numFonts && e == EOT_OK; i++)
+    e = put_directory(w, &w->fonts[i]);
+  w->out->length = end;
+
+  if (e == EOT_OK && head && !w->collection)
+    set_4be(font + head + 8,
+	    (0xB1B0AFBA - table_checksum(font, end - w->start)) & 0xFFFFFFFF);
+  return e;
+}
+
+
+/* inflate_table -- decompress a WOFF table into its place */
+static eot_status inflate_table(const woff_table *t, unsigned char *dest)
+{
+#ifdef WOFF_ZLIB
+  uLongf len = t->length;
+
+  if (uncompress(dest, &len, t->data, t->stored) != Z_OK || len != t->length)
+    return EOT_ERR_WOFF;
+  return EOT_OK;
+#else
+  (void) t;
+  (void) dest;
+  return EOT_ERR_WOFF_SUPPORT;
+#endif
+}
+
+
+/* decode_woff -- decompress the tables of a WOFF file
+ *
+ * Tables whose compressed length equals their length are stored as is.
+ */
+static eot_status decode_woff(const unsigned char *font, size_t size,
+			      woff_file *w)
+{
+  unsigned long signature, flavor, length, offset;
+  unsigned short numTables, reserved, i;
+  woff_table *t;
+  eot_status e;
+  view v = {font, size, 0};
+
+  if (!get_4be(&v, &signature) || !get_4be(&v, &flavor) ||
+      !get_4be(&v, &length) || !get_2be(&v, &numTables) ||
+      !get_2be(&v, &reserved) || length > size || reserved != 0 ||
+      flavor == SFNT_TTCF)
+    return EOT_ERR_WOFF;
+  if ((e = alloc_tables(w, numTables)) != EOT_OK ||
+      (e = single_font(w, flavor)) != EOT_OK)
+    return e;
+  v.pos = WOFF_HEADER_SIZE;
+  for (i = 0; i < numTables; i++) {
+    t = &w->tables[i];
+    if (!get_4be(&v, &t->tag) || !get_4be(&v, &offset) ||
+	!get_4be(&v, &t->stored) || !get_4be(&v, &t->length) ||
+	!get_4be(&v, &t->checkSum) || offset > size ||
+	t->stored > size - offset || t->stored > t->length)
+      return EOT_ERR_WOFF;
+    t->data = font + offset;
+  }
+
+  if ((e = reserve(w)) != EOT_OK) return e;
+  for (i = 0; i < numTables && e == EOT_OK; i++) {
+    t = &w->tables[i];
+    if (t->stored == t->length)
+      memcpy(w->out->data + w->start + t->offset, t->data, t->length);
+    else
+      e = inflate_table(t, w->out->data + w->start + t->offset);
+  }
+  return e;
+}
+
+
+/* read_woff2_directory -- read the table directory of a WOFF 2.0 file
+ *
+ * glyf and loca are transformed unless their transformation version
+ * is 3, other tables if it is not 0. Only hmtx has another version
+ * (1) that can be decoded.
+ */
+static eot_status read_woff2_directory(view *v, woff_file *w)
+{
+  unsigned char flags, version;
+  unsigned short i;
+  woff_table *t;
+
+  for (i = 0; i < w->numTables; i++) {
+    t = &w->tables[i];
+    if (!get_1(v, &flags)) return EOT_ERR_WOFF;
+    if ((flags & 0x3F) != 0x3F) t->tag = pack_tag(known_tags[flags & 0x3F]);
+    else if (!get_4be(v, &t->tag)) return EOT_ERR_WOFF;
+    if (!get_base128(v, &t->length)) return EOT_ERR_WOFF;
+    version = flags >> 6;
+    if (t->tag == pack_tag("glyf") || t->tag == pack_tag("loca")) {
+      if (version != 0 && version != 3) return EOT_ERR_WOFF;
+      t->transformed = version == 0;
+    } else {
+      if (version > (t->tag == pack_tag("hmtx") ? 1 : 0)) return EOT_ERR_WOFF;
+      t->transformed = version != 0;
+    }
+    t->stored = t->length;
+    if (t->transformed && !get_base128(v, &t->stored)) return EOT_ERR_WOFF;
+    if (t->transformed && t->tag == pack_tag("loca") && t->stored != 0)
+      return EOT_ERR_WOFF;
+  }
+  return EOT_OK;
+}
+
+
+/* read_collection -- read the collection directory of a WOFF 2.0 file */
+static eot_status read_collection(view *v, woff_file *w)
+{
+  unsigned short n, i, j;
+  woff_font *f;
+
+  if (!get_4be(v, &w->ttcVersion) || !get_255ushort(v, &n) || n == 0)
+    return EOT_ERR_WOFF;
+  if (!(w->fonts = counted_calloc(n, sizeof(*w->fonts)))) return EOT_ERR_NOMEM;
+  w->numFonts = n;
+  w->collection = true;
+  for (i = 0; i < n; i++) {
+    f = &w->fonts[i];
+    if (!get_255ushort(v, &f->numTables) || f->numTables == 0 ||
+	!get_4be(v, &f->flavor))
+      return EOT_ERR_WOFF;
+    if (!(f->index = counted_malloc(f->numTables * sizeof(*f->index))))
+      return EOT_ERR_NOMEM;
+    for (j = 0; j < f->numTables; j++)
+      if (!get_255ushort(v, &f->index[j]) || f->index[j] >= w->numTables)
+	return EOT_ERR_WOFF;
+  }
+  return EOT_OK;
+}
+
+
+/* unbrotli -- decompress the Brotli stream, each table into its place
+ *
+ * The data of transformed tables goes to scratch, one after the other.
+ * The stream must end exactly after the last table.
+ */
+static eot_status unbrotli(woff_file *w, const unsigned char *in,
+			   size_t len, unsigned char *scratch)
+{
+#ifdef WOFF_BROTLI
+  BrotliDecoderResult r = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
+  BrotliDecoderState *s;
+  unsigned char *next, extra;
+  unsigned short i;
+  woff_table *t;
+  size_t avail;
+
+  if (!(s = BrotliDecoderCreateInstance(NULL, NULL, NULL)))
+    return EOT_ERR_NOMEM;
+  for (i = 0; i < w->numTables; i++) {
+    t = &w->tables[i];
+    if (t->transformed) {
+      next = scratch;
+      t->data = scratch;
+      scratch += t->stored;
+    } else {
+      next = w->out->data + w->start + t->offset;
+    }
+    avail = t->stored;
+    while (avail > 0 && r == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT)
+      r = BrotliDecoderDecompressStream(s, &len, &in, &avail, &next, NULL);
+    if (avail > 0) break;
+  }
+  if (i == w->numTables && r == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+    avail = 1;			/* Check that no output is left */
+    next = &extra;
+    r = BrotliDecoderDecompressStream(s, &len, &in, &avail, &next, NULL);
+    if (avail == 0) r = BROTLI_DECODER_RESULT_ERROR;
+  }
+  BrotliDecoderDestroyInstance(s);
+  return i == w->numTables && r == BROTLI_DECODER_RESULT_SUCCESS
+    ? EOT_OK : EOT_ERR_WOFF;
+#else
+  (void) w;
+  (void) in;
+  (void) len;
+  (void) scratch;
+  return EOT_ERR_WOFF_SUPPORT;
+#endif
+}
+
+
+/* decode_simple -- rebuild a simple glyph from the glyf streams */
+static eot_status decode_simple(view s[], short ncontours, bool has_bbox,
+				buffer *out, short *xMin)
+{
+  unsigned short i, n, ninstructions;
+  unsigned long npoints = 0;
+  size_t start = s[N_POINTS].pos;
+  unsigned char flag;
+  simple_glyph g;
+  int x, y, dx, dy;
+  eot_status e;
+
+  /* First count the points, then read them */
+  for (i = 0; i < ncontours; i++) {
+    if (!get_255ushort(&s[N_POINTS], &n) || n == 0) return EOT_ERR_WOFF;
+    npoints += n;
+  }
+  if (npoints > 0xFFFF) return EOT_ERR_WOFF;
+  if ((e = alloc_simple_glyph(&g, ncontours, npoints)) != EOT_OK) return e;
+  s[N_POINTS].pos = start;
+  for (i = 0, npoints = 0; i < ncontours; i++) {
+    (void) get_255ushort(&s[N_POINTS], &n);
+    npoints += n;
+    g.endPtsOfContours[i] = npoints - 1;
+  }
+
+  e = EOT_ERR_WOFF;
+  for (i = 0, x = y = 0; i < g.numPoints; i++) {
+    if (!get_1(&s[FLAGS], &flag) || !get_triplet(flag, &s[GLYPHS], &dx, &dy))
+      goto done;
+    g.points[i].x = x += dx;
+    g.points[i].y = y += dy;
+    g.points[i].on_curve = !(flag & 0x80);
+  }
+  if (!get_255ushort(&s[GLYPHS], &ninstructions) ||
+      s[INSTRUCTIONS].length - s[INSTRUCTIONS].pos < ninstructions)
+    goto done;
+  g.instructionLength = ninstructions;
+  g.instructions = s[INSTRUCTIONS].data + s[INSTRUCTIONS].pos;
+  s[INSTRUCTIONS].pos += ninstructions;
+  if (!has_bbox) compute_bbox(&g);
+  else if (!get_2be_signed(&s[BBOXES], &g.xMin) ||
+	   !get_2be_signed(&s[BBOXES], &g.yMin) ||
+	   !get_2be_signed(&s[BBOXES], &g.xMax) ||
+	   !get_2be_signed(&s[BBOXES], &g.yMax))
+    goto done;
+  write_simple_glyph(out, &g);
+  *xMin = g.xMin;
+  e = EOT_OK;
+
+ done:
+  free_simple_glyph(&g);
+  return e;
+}
+
+
+/* decode_composite -- rebuild a composite glyph from the glyf streams */
+static eot_status decode_composite(view s[], bool has_bbox, buffer *out,
+				   short *xMin)
+{
+  unsigned short flags, glyphIndex, ninstructions;
+  size_t start = s[COMPOSITES].pos;
+  bool has_instructions = false;
+  view *code = &s[INSTRUCTIONS];
+  short bbox[4];
+  int i;
+
+  if (!has_bbox) return EOT_ERR_WOFF;
+  for (i = 0; i < 4; i++)
+    if (!get_2be_signed(&s[BBOXES], &bbox[i])) return EOT_ERR_WOFF;
+  do {
+    if (!next_component(&s[COMPOSITES], &flags, &glyphIndex))
+      return EOT_ERR_WOFF;
+    if (flags & GLYF_WE_HAVE_INSTRUCTIONS) has_instructions = true;
+  } while (flags & GLYF_MORE_COMPONENTS);
+  buf_put_2be(out, 0xFFFF);
+  for (i = 0; i < 4; i++) buf_put_2be(out, bbox[i]);
+  buf_put_bytes(out, s[COMPOSITES].data + start, s[COMPOSITES].pos - start);
+  if (has_instructions) {
+    if (!get_255ushort(&s[GLYPHS], &ninstructions) ||
+	code->length - code->pos < ninstructions) return EOT_ERR_WOFF;
+    buf_put_2be(out, ninstructions);
+    buf_put_bytes(out, code->data + code->pos, ninstructions);
+    code->pos += ninstructions;
+  }
+  *xMin = bbox[0];
+  return EOT_OK;
+}
+
+
+/* decode_glyphs -- rebuild the glyphs, append them and the loca table */
+static eot_status decode_glyphs(view s[], view bitmap, unsigned short nglyphs,
+				bool long_format, short xMin[], buffer *out,
+				buffer *loca)
+{
+  size_t start = out->length;
+  unsigned short i;
+  short ncontours;
+  eot_status e = EOT_OK;
+  bool has_bbox;
+
+  for (i = 0; i < nglyphs && e == EOT_OK; i++) {
+    if (long_format) buf_put_4be(loca, out->length - start);
+    else buf_put_2be(loca, (out->length - start) / 2);
+    has_bbox = bitmap.data[i >> 3] & (0x80 >> (i & 7));
+    xMin[i] = 0;
+    if (!get_2be_signed(&s[N_CONTOURS], &ncontours)) e = EOT_ERR_WOFF;
+    else if (ncontours > 0)
+      e = decode_simple(s, ncontours, has_bbox, out, &xMin[i]);
+    else if (ncontours == -1)
+      e = decode_composite(s, has_bbox, out, &xMin[i]);
+    else if (ncontours != 0 || has_bbox) e = EOT_ERR_WOFF;
+    while ((out->length - start) % (long_format ? 4 : 2)) buf_put_1(out, 0);
+  }
+  if (long_format) buf_put_4be(loca, out->length - start);
+  else buf_put_2be(loca, (out->length - start) / 2);
+  if (e == EOT_OK && !long_format && (out->length - start) / 2 > 0xFFFF)
+    e = EOT_ERR_WOFF;
+  if (e == EOT_OK && (out->failed || loca->failed)) e = EOT_ERR_NOMEM;
+  return e;
+}
+
+
+/* decode_glyf -- rebuild glyf table i and the loca table of font f
+ *
+ * The transformed glyf table starts with the number of glyphs, the
+ * format of loca and the lengths of seven streams, which follow. The
+ * bounding box stream starts with a bitmap of the glyphs whose bbox
+ * is given rather than computed.
+ */
+static eot_status decode_glyf(woff_file *w, const woff_font *f,
+			      unsigned short i)
+{
+  woff_table *glyf = &w->tables[i], *loca = font_table(w, f, "loca");
+  unsigned short reserved, optionFlags, nglyphs, indexFormat;
+  unsigned long len[NSTREAMS], pos;
+  view t = {glyf->data, glyf->stored, 0}, s[NSTREAMS], bitmap;
+  eot_status e;
+  buffer b;
+  int k;
+
+  if (!loca || !loca->transformed || loca->offset)
+    return EOT_ERR_WOFF;
+  if (!get_2be(&t, &reserved) || !get_2be(&t, &optionFlags) ||
+      !get_2be(&t, &nglyphs) || !get_2be(&t, &indexFormat) ||
+      indexFormat > 1)
+    return EOT_ERR_WOFF;
+  for (k = 0; k < NSTREAMS; k++)
+    if (!get_4be(&t, &len[k])) return EOT_ERR_WOFF;
+  for (k = 0, pos = t.pos; k < NSTREAMS; pos += len[k++])
+    if (!make_view(t.data, t.length, pos, len[k], &s[k]))
+      return EOT_ERR_WOFF;
+  if (!make_view(s[BBOXES].data, s[BBOXES].length, 0,
+		 4 * ((nglyphs + 31UL) / 32), &bitmap))
+    return EOT_ERR_WOFF;
+  s[BBOXES].pos = bitmap.length;
+
+  if (!(glyf->xMin = counted_malloc((nglyphs ? nglyphs : 1) * sizeof(short))))
+    return EOT_ERR_NOMEM;
+  glyf->numGlyphs = nglyphs;
+  glyf->offset = w->out->length - w->start;
+  buf_init(&b);
+  e = decode_glyphs(s, bitmap, nglyphs, indexFormat, glyf->xMin, w->out, &b);
+  glyf->length = w->out->length - w->start - glyf->offset;
+  pad(w);
+  loca->offset = w->out->length - w->start;
+  loca->length = b.length;
+  buf_put_bytes(w->out, b.data, b.length);
+  pad(w);
+  free(b.data);
+  return e;
+}
+
+
+/* decode_hmtx -- rebuild hmtx table i of font f
+ *
+ * The transformed table has a byte of flags, then the advance widths
+ * and, unless the flags say they are equal to the xMin of the glyphs,
+ * the left side bearings of the glyphs with and without advance width.
+ */
+static eot_status decode_hmtx(woff_file *w, const woff_font *f,
+			      unsigned short i)
+{
+  woff_table *hmtx = &w->tables[i], *glyf, *hhea;
+  unsigned short nmetrics, advance, j;
+  view t = {hmtx->data, hmtx->stored, 0}, widths, v;
+  unsigned char flags;
+  short lsb;
+
+  if (!(glyf = font_table(w, f, "glyf")) || !glyf->xMin ||
+      !(hhea = font_table(w, f, "hhea")) || hhea->transformed ||
+      !make_view(w->out->data + w->start, w->out->length - w->start,
+		 hhea->offset, hhea->length, &v))
+    return EOT_ERR_WOFF;
+  v.pos = OFFSET_NUM_H_METRICS;
+  if (!get_2be(&v, &nmetrics) || nmetrics == 0 ||
+      nmetrics > glyf->numGlyphs || !get_1(&t, &flags) ||
+      (flags & 0xFC) || !(flags & 0x03))
+    return EOT_ERR_WOFF;
+  widths = t;
+  t.pos += 2UL * nmetrics;
+
+  hmtx->offset = w->out->length - w->start;
+  for (j = 0; j < glyf->numGlyphs; j++) {
+    if (j < nmetrics) {
+      if (!get_2be(&widths, &advance)) return EOT_ERR_WOFF;
+      buf_put_2be(w->out, advance);
+    }
+    if (flags & (j < nmetrics ? 0x01 : 0x02)) lsb = glyf->xMin[j];
+    else if (!get_2be_signed(&t, &lsb)) return EOT_ERR_WOFF;
+    buf_put_2be(w->out, lsb);
+  }
+  hmtx->length = w->out->length - w->start - hmtx->offset;
+  pad(w);
+  return EOT_OK;
+}
+
+
+/* untransform -- rebuild the transformed tables, after all others
+ *
+ * Tables shared by several fonts of a collection are rebuilt once. An
+ * hmtx table needs the glyf table of its font to be rebuilt first.
+ */
+static eot_status untransform(woff_file *w)
+{
+  unsigned short i, j;
+  const woff_font *f;
+  woff_table *t;
+  eot_status e = EOT_OK;
+
+  for (i = 0; i < w->numFonts && e == EOT_OK; i++) {
+    f = &w->fonts[i];
+    for (j = 0; j < f->numTables && e == EOT_OK; j++) {
+      t = &w->tables[f->index[j]];
+      if (t->transformed && !t->offset && t->tag == pack_tag("glyf"))
+	e = decode_glyf(w, f, f->index[j]);
+    }
+    for (j = 0; j < f->numTables && e == EOT_OK; j++) {
+      t = &w->tables[f->index[j]];
+      if (t->transformed && !t->offset && t->tag == pack_tag("hmtx"))
+	e = decode_hmtx(w, f, f->index[j]);
+    }
+  }
+  return e;
+}
+
+
+/* decode_woff2 -- decompress and rebuild the tables of a WOFF 2.0 file */
+static eot_status decode_woff2(const unsigned char *font, size_t size,
+			       woff_file *w)
+{
+  unsigned long signature, flavor, length, compressed;
+  unsigned short numTables, reserved, i;
+  unsigned char *scratch;
+  size_t n = 0;
+  eot_status e;
+  view v = {font, size, 0};
+
+  if (!get_4be(&v, &signature) || !get_4be(&v, &flavor) ||
+      !get_4be(&v, &length) || !get_2be(&v, &numTables) ||
+      !get_2be(&v, &reserved) || length > size || reserved != 0)
+    return EOT_ERR_WOFF;
+  v.pos = OFFSET_TOTAL_COMPRESSED_SIZE;
+  if (!get_4be(&v, &compressed)) return EOT_ERR_WOFF;
+  v.pos = WOFF2_HEADER_SIZE;
+  if ((e = alloc_tables(w, numTables)) != EOT_OK ||
+      (e = read_woff2_directory(&v, w)) != EOT_OK)
+    return e;
+  if (flavor == SFNT_TTCF) e = read_collection(&v, w);
+  else e = single_font(w, flavor);
+  if (e != EOT_OK) return e;
+  if (compressed > size - v.pos) return EOT_ERR_WOFF;
+
+  if ((e = reserve(w)) != EOT_OK) return e;
+  for (i = 0; i < numTables; i++)
+    if (w->tables[i].transformed &&
+	(n += w->tables[i].stored) > WOFF_MAX_SIZE)
+      return EOT_ERR_WOFF;
+  if (!(scratch = counted_malloc(n ? n : 1))) return EOT_ERR_NOMEM;
+  if ((e = unbrotli(w, font + v.pos, compressed, scratch)) == EOT_OK)
+    e = untransform(w);
+  free(scratch);
+  return e;
+}
+
+
+/* woff_decode -- append the OpenType font of a WOFF or WOFF 2.0 file
+ *
+ * Returns EOT_ERR_SFNT if the data is neither.
+ */
+eot_status woff_decode(const unsigned char *font, size_t size, buffer *out)
+{
+  woff_file w = {.out = out, .start = out->length};
+  unsigned long signature;
+  eot_status e;
+  view v = {font, size, 0};
+
+  if (!get_4be(&v, &signature)) return EOT_ERR_SFNT;
+  if (signature == WOFF_SIGNATURE) e = decode_woff(font, size, &w);
+  else if (signature == WOFF2_SIGNATURE) e = decode_woff2(font, size, &w);
+  else return EOT_ERR_SFNT;
+  if (e == EOT_OK) e = finish(&w);
+  free_woff(&w);
+  return e;
+}
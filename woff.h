@@ -0,0 +1,18 @@
+/* woff.h -- turn WOFF and WOFF 2.0 files into OpenType (internal to libeot)
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifndef WOFF_H
+#define WOFF_H
+
+#include "sfnt.h"
+
+#define WOFF_SIGNATURE (('w' << 24) | ('O' << 16) | ('F' << 8) | 'F')
+#define WOFF2_SIGNATURE (('w' << 24) | ('O' << 16) | ('F' << 8) | '2')
+
+extern eot_status woff_decode(const unsigned char *font, size_t size,
+			      buffer *out);
+
+#endif /* WOFF_H */
@@ -0,0 +1,113 @@
+/* xor -- the XOR obfuscation of EOT font data
+ *
+ * An EOT file with TTEMBED_XORENCRYPTDATA in its Flags has every byte
+ * of its FontData XOR'ed with EOT_XOR_KEY. That is done after any
+ * MicroType Express compression and undone before decompression.
+ *
+ * The work is done in vectors: with AVX2 if the processor has it,
+ * otherwise with SSE2 (always present on x86-64), otherwise, on other
+ * processors, with unsigned longs. Either way, it runs at about the
+ * speed of memcpy, so callers can obfuscate while they copy.
+ *
+ * Copyright 2010 W3C (MIT, ERCIM, Keio), see
+ * http://www.w3.org/Consortium/Legal/2002/copyright-software-20021231
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include "eot.h"
+
+#if defined(HAVE_IMMINTRIN_H) && defined(__GNUC__) && \
+  (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define XOR_X86 1
+#endif
+
+
+#ifdef XOR_X86
+/* xor_avx2 -- XOR 32 bytes at a time, return the number of bytes done */
+__attribute__((target("avx2")))
+static size_t xor_avx2(unsigned char *dst, const unsigned char *src,
+		       size_t len)
+{
+  const __m256i key = _mm256_set1_epi8((char)EOT_XOR_KEY);
+  size_t i = 0;
+
+  for (; i + 128 <= len; i += 128) {
+    __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+    __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+    __m256i c = _mm256_loadu_si256((const __m256i*)(src + i + 64));
+    __m256i d = _mm256_loadu_si256((const __m256i*)(src + i + 96));
+    _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a, key));
+    _mm256_storeu_si256((__m256i*)(dst + i + 32), _mm256_xor_si256(b, key));
+    _mm256_storeu_si256((__m256i*)(dst + i + 64), _mm256_xor_si256(c, key));
+    _mm256_storeu_si256((__m256i*)(dst + i + 96), _mm256_xor_si256(d, key));
+  }
+  for (; i + 32 <= len; i += 32)
+    _mm256_storeu_si256((__m256i*)(dst + i),
+      _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(src + i)), key));
+  return i;
+}
+
+
+/* xor_sse2 -- XOR 16 bytes at a time, return the number of bytes done */
+__attribute__((target("sse2")))
+static size_t xor_sse2(unsigned char *dst, const unsigned char *src,
+		       size_t len)
+{
+  const __m128i key = _mm_set1_epi8((char)EOT_XOR_KEY);
+  size_t i = 0;
+
+  for (; i + 64 <= len; i += 64) {
+    __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+    __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+    __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+    __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+    _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, key));
+    _mm_storeu_si128((__m128i*)(dst + i + 16), _mm_xor_si128(b, key));
+    _mm_storeu_si128((__m128i*)(dst + i + 32), _mm_xor_si128(c, key));
+    _mm_storeu_si128((__m128i*)(dst + i + 48), _mm_xor_si128(d, key));
+  }
+  for (; i + 16 <= len; i += 16)
+    _mm_storeu_si128((__m128i*)(dst + i),
+      _mm_xor_si128(_mm_loadu_si128((const __m128i*)(src + i)), key));
+  return i;
+}
+#endif /* XOR_X86 */
+
+
+/* xor_words -- XOR a word at a time, return the number of bytes done */
+static size_t xor_words(unsigned char *dst, const unsigned char *src,
+			size_t len)
+{
+  const unsigned long key = (~0UL / 0xFF) * EOT_XOR_KEY;
+  unsigned long w;
+  size_t i = 0;
+
+  for (; i + sizeof(w) <= len; i += sizeof(w)) {
+    memcpy(&w, src + i, sizeof(w));	/* Compiles to a plain load */
+    w ^= key;
+    memcpy(dst + i, &w, sizeof(w));
+  }
+  return i;
+}
+
+
+/* eot_xor -- obfuscate or deobfuscate len bytes from src into dst */
+void eot_xor(unsigned char *dst, const unsigned char *src, size_t len)
+{
+  size_t i;
+
+#ifdef XOR_X86
+  if (__builtin_cpu_supports("avx2")) i = xor_avx2(dst, src, len);
+  else if (__builtin_cpu_supports("sse2")) i = xor_sse2(dst, src, len);
+  else i = xor_words(dst, src, len);
+#else
+  i = xor_words(dst, src, len);
+#endif
+  for (; i < len; i++) dst[i] = src[i] ^ EOT_XOR_KEY;
+}